@@ -0,0 +1,636 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_GRAPH_SCHEDULER7_H__
+#define __SPA_GRAPH_SCHEDULER7_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <spa/graph/graph.h>
+
+/* A scheduler that executes a precompiled plan of the graph.
+ *
+ * When the topology of the graph changes, the nodes are sorted in
+ * topological order and their ports are collected in flat arrays. A
+ * cycle then walks the plan in order: upstream from the node that
+ * needs input, calling process_output on the nodes whose outputs are
+ * all requested, and downstream, calling process_input on the nodes
+ * whose inputs are all ready. Nodes that need more input after
+ * process_input start a new round.
+ *
+ * The nodes that are requested or receive data are marked in a bitmap
+ * so that a cycle only visits the nodes it touches. Each node keeps
+ * a count of the peers that requested or provided data. The count is
+ * checked against the io areas before the node is scheduled and
+ * updated after it was processed, so data that was produced outside
+ * of the cycle, like the output of async nodes, is not lost.
+ *
+ * The plan is compiled outside of the cycles, usually on the main loop,
+ * into a plan that is not running, with spa_graph_plan_compile(). The
+ * graph should not change while it is compiled. The thread that runs
+ * the cycles then makes it the running plan with spa_graph_plan_swap(),
+ * which does not allocate. A cycle fails with -EAGAIN when the graph
+ * changed after the running plan was compiled. Enabling or disabling
+ * ports is a change, use spa_graph_node_changed() after updating the
+ * port flags.
+ */
+
+#define SPA_GRAPH_PLAN_MAX_ROUNDS	64
+#define SPA_GRAPH_PLAN_NONE		((uint32_t)-1)
+
+struct spa_graph_plan_node {
+	struct spa_graph_node *node;
+	struct spa_graph_port **ports[2];	/**< linked ports in the plan port array */
+	uint32_t *peers[2];			/**< index of the peer node of the ports */
+	uint32_t n_ports[2];
+	uint32_t required[2];			/**< ports needed before scheduling */
+	uint32_t index;				/**< position in the plan */
+#define SPA_GRAPH_PLAN_NODE_PENDING	(1 << 0)
+#define SPA_GRAPH_PLAN_NODE_QUEUED	(1 << 1)	/**< for parallel schedulers */
+#define SPA_GRAPH_PLAN_NODE_OUTPUT	(1 << 2)	/**< output to push, for parallel schedulers */
+	uint32_t flags;
+	uint32_t ready[2];			/**< peers that requested/provided data */
+};
+
+struct spa_graph_plan {
+	struct spa_graph *graph;
+	uint32_t version;		/**< graph version of the plan */
+	bool valid;
+	bool running;
+
+	struct spa_graph_plan_node *nodes;	/**< nodes in topological order */
+	struct spa_graph_node **order;		/**< nodes sorted on address, to find
+						  *  them while compiling */
+	uint32_t n_nodes;
+	uint32_t max_nodes;
+	struct spa_graph_port **ports;
+	uint32_t *peers;
+	uint32_t max_ports;
+
+	uint32_t *pending;		/**< nodes that need input */
+	uint32_t n_pending;
+	uint32_t *queue;		/**< scratch space for sorting */
+
+	uint64_t *marked[2];		/**< nodes to push to (INPUT) and pull from (OUTPUT) */
+	uint32_t n_words;
+};
+
+static inline void spa_graph_plan_init(struct spa_graph_plan *plan, struct spa_graph *graph)
+{
+	spa_zero(*plan);
+	plan->graph = graph;
+}
+
+/* check if the node is in the plan, the scheduler_data of other nodes
+ * can point anywhere */
+static inline struct spa_graph_plan_node *
+spa_graph_plan_find_node(struct spa_graph_plan *plan, struct spa_graph_node *node)
+{
+	struct spa_graph_plan_node *pn = node->scheduler_data;
+
+	if (pn < plan->nodes || pn >= plan->nodes + plan->n_nodes || pn->node != node)
+		return NULL;
+	return pn;
+}
+
+/* free the plan, it should not be running */
+static inline void spa_graph_plan_clear(struct spa_graph_plan *plan)
+{
+	free(plan->nodes);
+	free(plan->order);
+	free(plan->ports);
+	free(plan->peers);
+	free(plan->pending);
+	free(plan->queue);
+	free(plan->marked[0]);
+	spa_graph_plan_init(plan, plan->graph);
+}
+
+static inline int spa_graph_plan_compare_node(const void *a, const void *b)
+{
+	const struct spa_graph_node *na = *(struct spa_graph_node * const *) a;
+	const struct spa_graph_node *nb = *(struct spa_graph_node * const *) b;
+
+	return na < nb ? -1 : na > nb ? 1 : 0;
+}
+
+/* the position of the peer node of the port in the sorted order while
+ * compiling, SPA_GRAPH_PLAN_NONE when the port is not linked in the
+ * graph */
+static inline uint32_t spa_graph_plan_lookup_peer(struct spa_graph_plan *plan,
+						  struct spa_graph_port *p)
+{
+	struct spa_graph_node **n;
+
+	if (p->peer == NULL || p->peer->node == NULL)
+		return SPA_GRAPH_PLAN_NONE;
+
+	n = bsearch(&p->peer->node, plan->order, plan->n_nodes,
+		    sizeof(struct spa_graph_node *), spa_graph_plan_compare_node);
+	return n ? (uint32_t)(n - plan->order) : SPA_GRAPH_PLAN_NONE;
+}
+
+/* count the ports with the given status, or the ports that are needed
+ * before the node can be scheduled when status is -1 */
+static inline uint32_t spa_graph_plan_count(struct spa_graph_plan_node *pn,
+					    enum spa_direction direction, int status)
+{
+	uint32_t i, count = 0;
+
+	for (i = 0; i < pn->n_ports[direction]; i++) {
+		struct spa_graph_port *p = pn->ports[direction][i];
+
+		if ((p->flags & SPA_PORT_INFO_FLAG_OPTIONAL) ||
+		    (p->peer->flags & SPA_GRAPH_PORT_FLAG_DISABLED))
+			continue;
+		if (status == -1 || p->io->status == status)
+			count++;
+	}
+	return count;
+}
+
+/* compile the graph into the plan. This allocates and only reads the
+ * graph, the plan should not be running. The nodes are sorted with
+ * Kahn's algorithm, nodes in a cycle are added in address order. */
+static inline int spa_graph_plan_compile(struct spa_graph_plan *plan)
+{
+	struct spa_graph *graph = plan->graph;
+	struct spa_graph_node *n, **order;
+	struct spa_graph_port *p, **pp;
+	struct spa_graph_plan_node *nodes;
+	uint32_t i, d, n_nodes = 0, n_ports = 0, head = 0, tail = 0, *queue, *rank, *pi;
+
+	spa_list_for_each(n, &graph->nodes, link) {
+		n_nodes++;
+		for (d = 0; d < 2; d++)
+			spa_list_for_each(p, &n->ports[d], link)
+				n_ports++;
+	}
+
+	if (n_nodes > plan->max_nodes) {
+		uint32_t n_words = (n_nodes + 63) / 64;
+
+		free(plan->nodes);
+		free(plan->order);
+		free(plan->pending);
+		free(plan->queue);
+		free(plan->marked[0]);
+		plan->nodes = calloc(n_nodes, sizeof(struct spa_graph_plan_node));
+		plan->order = calloc(n_nodes, sizeof(struct spa_graph_node *));
+		plan->pending = calloc(n_nodes, sizeof(uint32_t));
+		plan->queue = calloc(n_nodes * 2, sizeof(uint32_t));
+		plan->marked[0] = calloc(n_words * 2, sizeof(uint64_t));
+		if (plan->nodes == NULL || plan->order == NULL ||
+		    plan->pending == NULL || plan->queue == NULL ||
+		    plan->marked[0] == NULL)
+			goto no_mem;
+		plan->marked[1] = &plan->marked[0][n_words];
+		plan->max_nodes = n_nodes;
+	}
+	if (n_ports > plan->max_ports) {
+		free(plan->ports);
+		free(plan->peers);
+		plan->ports = calloc(n_ports, sizeof(struct spa_graph_port *));
+		plan->peers = calloc(n_ports, sizeof(uint32_t));
+		if (plan->ports == NULL || plan->peers == NULL)
+			goto no_mem;
+		plan->max_ports = n_ports;
+	}
+
+	/* the position in the address order is the temporary id of a node.
+	 * The queue holds the sorted ids and rank the number of unsorted
+	 * upstream nodes, and later the position in the plan */
+	nodes = plan->nodes;
+	order = plan->order;
+	queue = plan->queue;
+	rank = &plan->queue[n_nodes];
+	plan->n_nodes = n_nodes;
+
+	i = 0;
+	spa_list_for_each(n, &graph->nodes, link)
+		order[i++] = n;
+	qsort(order, n_nodes, sizeof(struct spa_graph_node *), spa_graph_plan_compare_node);
+
+	for (i = 0; i < n_nodes; i++) {
+		rank[i] = 0;
+		spa_list_for_each(p, &order[i]->ports[SPA_DIRECTION_INPUT], link) {
+			if (spa_graph_plan_lookup_peer(plan, p) != SPA_GRAPH_PLAN_NONE)
+				rank[i]++;
+		}
+		if (rank[i] == 0)
+			queue[tail++] = i;
+	}
+	while (tail < n_nodes) {
+		while (head < tail) {
+			n = order[queue[head++]];
+
+			spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
+				uint32_t peer = spa_graph_plan_lookup_peer(plan, p);
+
+				if (peer != SPA_GRAPH_PLAN_NONE && rank[peer] > 0 &&
+				    --rank[peer] == 0)
+					queue[tail++] = peer;
+			}
+		}
+		if (tail < n_nodes) {
+			/* a cycle, break it at the first unsorted node */
+			for (i = 0; i < n_nodes; i++) {
+				if (rank[i] > 0) {
+					rank[i] = 0;
+					queue[tail++] = i;
+					break;
+				}
+			}
+		}
+	}
+	for (i = 0; i < n_nodes; i++)
+		rank[queue[i]] = i;
+
+	/* lay out the nodes in sorted order with their linked ports */
+	pp = plan->ports;
+	pi = plan->peers;
+	for (i = 0; i < n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &nodes[i];
+
+		pn->node = order[queue[i]];
+		pn->index = i;
+		pn->flags = 0;
+		for (d = 0; d < 2; d++) {
+			pn->ports[d] = pp;
+			pn->peers[d] = pi;
+			pn->n_ports[d] = 0;
+			spa_list_for_each(p, &pn->node->ports[d], link) {
+				uint32_t peer = spa_graph_plan_lookup_peer(plan, p);
+
+				if (peer == SPA_GRAPH_PLAN_NONE)
+					continue;
+				*pp++ = p;
+				*pi++ = rank[peer];
+				pn->n_ports[d]++;
+			}
+			pn->required[d] = spa_graph_plan_count(pn, d, -1);
+			pn->ready[d] = 0;
+		}
+	}
+
+	plan->n_words = (n_nodes + 63) / 64;
+	plan->n_pending = 0;
+	plan->version = graph->version;
+	plan->valid = true;
+
+	spa_debug("plan %p: compiled %d nodes %d ports", plan, n_nodes, n_ports);
+	return 0;
+
+      no_mem:
+	plan->max_nodes = plan->max_ports = plan->n_nodes = 0;
+	plan->valid = false;
+	return -ENOMEM;
+}
+
+/* bind the nodes to the plan and start the counters from the io areas.
+ * Called from the thread that runs the cycles when no cycle runs, also
+ * when the plan was not used for a while. */
+static inline void spa_graph_plan_reset(struct spa_graph_plan *plan)
+{
+	uint32_t i;
+
+	for (i = 0; i < plan->n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &plan->nodes[i];
+
+		pn->node->scheduler_data = pn;
+		pn->flags = 0;
+		pn->ready[SPA_DIRECTION_INPUT] =
+			spa_graph_plan_count(pn, SPA_DIRECTION_INPUT, SPA_STATUS_HAVE_BUFFER);
+		pn->ready[SPA_DIRECTION_OUTPUT] =
+			spa_graph_plan_count(pn, SPA_DIRECTION_OUTPUT, SPA_STATUS_NEED_BUFFER);
+	}
+	plan->n_pending = 0;
+	plan->running = false;
+}
+
+/* make the plan compiled in next the running plan, without allocating.
+ * Called from the thread that runs the cycles when no cycle runs. next
+ * gets the previous plan, which the next compile reuses. Fails with
+ * -EAGAIN when the graph changed after next was compiled. */
+static inline int spa_graph_plan_swap(struct spa_graph_plan *plan, struct spa_graph_plan *next)
+{
+	struct spa_graph_plan tmp;
+
+	if (!next->valid || next->version != next->graph->version)
+		return -EAGAIN;
+
+	tmp = *plan;
+	*plan = *next;
+	*next = tmp;
+	spa_graph_plan_reset(plan);
+	return 0;
+}
+
+static inline void spa_graph_plan_mark(struct spa_graph_plan *plan,
+				       enum spa_direction direction, uint32_t index)
+{
+	plan->marked[direction][index >> 6] |= 1ULL << (index & 63);
+}
+
+static inline void spa_graph_plan_unmark_all(struct spa_graph_plan *plan)
+{
+	memset(plan->marked[0], 0, plan->n_words * 2 * sizeof(uint64_t));
+}
+
+/* take the first marked node from index on */
+static inline uint32_t spa_graph_plan_take_next(struct spa_graph_plan *plan,
+						enum spa_direction direction, uint32_t index)
+{
+	uint64_t *marked = plan->marked[direction];
+	uint32_t w;
+
+	for (w = index >> 6; w < plan->n_words; w++) {
+		uint64_t bits = marked[w];
+
+		if (w == index >> 6)
+			bits &= ~0ULL << (index & 63);
+		if (bits) {
+			bits &= -bits;
+			marked[w] &= ~bits;
+			return (w << 6) + __builtin_ctzll(bits);
+		}
+	}
+	return SPA_GRAPH_PLAN_NONE;
+}
+
+/* take the last marked node up to index */
+static inline uint32_t spa_graph_plan_take_prev(struct spa_graph_plan *plan,
+						enum spa_direction direction, uint32_t index)
+{
+	uint64_t *marked = plan->marked[direction];
+	int32_t w;
+
+	for (w = index >> 6; w >= 0; w--) {
+		uint64_t bits = marked[w];
+
+		if (w == (int32_t)(index >> 6) && (index & 63) != 63)
+			bits &= (2ULL << (index & 63)) - 1;
+		if (bits) {
+			uint32_t bit = 63 - __builtin_clzll(bits);
+			marked[w] &= ~(1ULL << bit);
+			return (w << 6) + bit;
+		}
+	}
+	return SPA_GRAPH_PLAN_NONE;
+}
+
+/* check the counter of the node against the io areas before it is
+ * scheduled, the counter also includes peers that were seen before
+ * the data was consumed */
+static inline bool spa_graph_plan_ready(struct spa_graph_plan_node *pn,
+					enum spa_direction direction, int status)
+{
+	uint32_t required = pn->required[direction];
+
+	if (required == 0 || pn->ready[direction] < required)
+		return false;
+	pn->ready[direction] = spa_graph_plan_count(pn, direction, status);
+	return pn->ready[direction] >= required;
+}
+
+/* tell the upstream peers that the node needs input */
+static inline void spa_graph_plan_pull_peers(struct spa_graph_plan *plan,
+					     struct spa_graph_plan_node *pn)
+{
+	uint32_t i;
+
+	for (i = 0; i < pn->n_ports[SPA_DIRECTION_INPUT]; i++) {
+		struct spa_graph_port *pport = pn->ports[SPA_DIRECTION_INPUT][i]->peer;
+		struct spa_graph_plan_node *peer;
+
+		if (pport->flags & SPA_GRAPH_PORT_FLAG_DISABLED)
+			continue;
+
+		peer = &plan->nodes[pn->peers[SPA_DIRECTION_INPUT][i]];
+		if (pport->io->status == SPA_STATUS_NEED_BUFFER)
+			peer->ready[SPA_DIRECTION_OUTPUT]++;
+		spa_graph_plan_mark(plan, SPA_DIRECTION_OUTPUT, peer->index);
+	}
+}
+
+/* tell the downstream peers that the node has output */
+static inline void spa_graph_plan_push_peers(struct spa_graph_plan *plan,
+					     struct spa_graph_plan_node *pn)
+{
+	uint32_t i;
+
+	for (i = 0; i < pn->n_ports[SPA_DIRECTION_OUTPUT]; i++) {
+		struct spa_graph_port *pport = pn->ports[SPA_DIRECTION_OUTPUT][i]->peer;
+		struct spa_graph_plan_node *peer;
+
+		if (pport->flags & SPA_GRAPH_PORT_FLAG_DISABLED)
+			continue;
+
+		peer = &plan->nodes[pn->peers[SPA_DIRECTION_OUTPUT][i]];
+		if (pport->io->status == SPA_STATUS_HAVE_BUFFER)
+			peer->ready[SPA_DIRECTION_INPUT]++;
+		spa_graph_plan_mark(plan, SPA_DIRECTION_INPUT, peer->index);
+	}
+}
+
+static inline void spa_graph_plan_add_pending(struct spa_graph_plan *plan,
+					      struct spa_graph_plan_node *pn)
+{
+	if (pn->flags & SPA_GRAPH_PLAN_NODE_PENDING)
+		return;
+	pn->flags |= SPA_GRAPH_PLAN_NODE_PENDING;
+	plan->pending[plan->n_pending++] = pn->index;
+}
+
+/* pull from the pending nodes and return the first node that can be
+ * pushed to */
+static inline uint32_t spa_graph_plan_pull(struct spa_graph_plan *plan, uint32_t first_push)
+{
+	struct spa_graph_plan_node *nodes = plan->nodes;
+	uint32_t i, last_pull = SPA_GRAPH_PLAN_NONE;
+
+	for (i = 0; i < plan->n_pending; i++) {
+		struct spa_graph_plan_node *pn = &nodes[plan->pending[i]];
+
+		pn->flags &= ~SPA_GRAPH_PLAN_NODE_PENDING;
+		spa_graph_plan_pull_peers(plan, pn);
+		if (last_pull == SPA_GRAPH_PLAN_NONE || pn->index > last_pull)
+			last_pull = pn->index;
+	}
+	plan->n_pending = 0;
+
+	if (last_pull == SPA_GRAPH_PLAN_NONE)
+		return first_push;
+
+	while ((i = spa_graph_plan_take_prev(plan, SPA_DIRECTION_OUTPUT, last_pull)) !=
+	       SPA_GRAPH_PLAN_NONE) {
+		struct spa_graph_plan_node *pn = &nodes[i];
+
+		if (spa_graph_plan_ready(pn, SPA_DIRECTION_OUTPUT, SPA_STATUS_NEED_BUFFER)) {
+			pn->node->state = spa_node_process_output(pn->node->implementation);
+			pn->ready[SPA_DIRECTION_OUTPUT] =
+				spa_graph_plan_count(pn, SPA_DIRECTION_OUTPUT, SPA_STATUS_NEED_BUFFER);
+
+			spa_debug("plan %p: node %p processed out %d", plan, pn->node, pn->node->state);
+			if (pn->node->state == SPA_STATUS_HAVE_BUFFER) {
+				spa_graph_plan_push_peers(plan, pn);
+				first_push = SPA_MIN(first_push, pn->index + 1);
+			}
+			else if (pn->node->state == SPA_STATUS_NEED_BUFFER)
+				spa_graph_plan_pull_peers(plan, pn);
+		}
+		if (i == 0)
+			break;
+		last_pull = i - 1;
+	}
+	return first_push;
+}
+
+/* push downstream from the first node that produced output */
+static inline void spa_graph_plan_push(struct spa_graph_plan *plan, uint32_t first_push)
+{
+	struct spa_graph_plan_node *nodes = plan->nodes;
+	uint32_t i;
+
+	while (first_push < plan->n_nodes &&
+	       (i = spa_graph_plan_take_next(plan, SPA_DIRECTION_INPUT, first_push)) !=
+	       SPA_GRAPH_PLAN_NONE) {
+		struct spa_graph_plan_node *pn = &nodes[i];
+
+		if (spa_graph_plan_ready(pn, SPA_DIRECTION_INPUT, SPA_STATUS_HAVE_BUFFER)) {
+			pn->node->state = spa_node_process_input(pn->node->implementation);
+			pn->ready[SPA_DIRECTION_INPUT] =
+				spa_graph_plan_count(pn, SPA_DIRECTION_INPUT, SPA_STATUS_HAVE_BUFFER);
+
+			spa_debug("plan %p: node %p processed in %d", plan, pn->node, pn->node->state);
+			if (pn->node->state == SPA_STATUS_HAVE_BUFFER)
+				spa_graph_plan_push_peers(plan, pn);
+			else if (pn->node->state == SPA_STATUS_NEED_BUFFER)
+				spa_graph_plan_add_pending(plan, pn);
+		}
+		first_push = i + 1;
+	}
+}
+
+/* handle a call from a node while the plan is running, it is handled
+ * in the current or next round */
+static inline int spa_graph_plan_queue(struct spa_graph_plan *plan,
+				       struct spa_graph_node *node,
+				       enum spa_direction direction)
+{
+	struct spa_graph_plan_node *pn;
+
+	if ((pn = spa_graph_plan_find_node(plan, node)) == NULL)
+		return -EINVAL;
+	if (direction == SPA_DIRECTION_INPUT)
+		spa_graph_plan_add_pending(plan, pn);
+	else
+		spa_graph_plan_push_peers(plan, pn);
+	return 0;
+}
+
+/* start a cycle from the node, fails with -EAGAIN when the plan must be
+ * compiled again */
+static inline int spa_graph_plan_begin(struct spa_graph_plan *plan,
+				       struct spa_graph_node *node,
+				       enum spa_direction direction,
+				       uint32_t *first_push)
+{
+	struct spa_graph_plan_node *pn;
+
+	if (!plan->valid || plan->version != plan->graph->version)
+		return -EAGAIN;
+	if ((pn = spa_graph_plan_find_node(plan, node)) == NULL)
+		return -EINVAL;
+
+	plan->running = true;
+	spa_graph_plan_unmark_all(plan);
+
+	if (direction == SPA_DIRECTION_INPUT) {
+		spa_graph_plan_add_pending(plan, pn);
+		*first_push = plan->n_nodes;
+	} else {
+		spa_graph_plan_push_peers(plan, pn);
+		*first_push = pn->index + 1;
+	}
+	return 0;
+}
+
+/* check if another round is needed and prepare it */
+static inline bool spa_graph_plan_next_round(struct spa_graph_plan *plan,
+					     uint32_t round, uint32_t *first_push)
+{
+	if (plan->n_pending == 0 || round + 1 >= SPA_GRAPH_PLAN_MAX_ROUNDS) {
+		plan->running = false;
+		return false;
+	}
+	/* forget the nodes that were marked behind the walk */
+	spa_graph_plan_unmark_all(plan);
+	*first_push = plan->n_nodes;
+	return true;
+}
+
+static inline int spa_graph_plan_run(struct spa_graph_plan *plan,
+				     struct spa_graph_node *node,
+				     enum spa_direction direction)
+{
+	uint32_t round = 0, first_push;
+	int res;
+
+	if (plan->running)
+		return spa_graph_plan_queue(plan, node, direction);
+
+	if ((res = spa_graph_plan_begin(plan, node, direction, &first_push)) < 0)
+		return res;
+
+	do {
+		first_push = spa_graph_plan_pull(plan, first_push);
+		spa_graph_plan_push(plan, first_push);
+	} while (spa_graph_plan_next_round(plan, round++, &first_push));
+
+	return 0;
+}
+
+static inline int spa_graph_plan_need_input(void *data, struct spa_graph_node *node)
+{
+	return spa_graph_plan_run(data, node, SPA_DIRECTION_INPUT);
+}
+
+static inline int spa_graph_plan_have_output(void *data, struct spa_graph_node *node)
+{
+	return spa_graph_plan_run(data, node, SPA_DIRECTION_OUTPUT);
+}
+
+static const struct spa_graph_callbacks spa_graph_plan_impl_default = {
+	SPA_VERSION_GRAPH_CALLBACKS,
+	.need_input = spa_graph_plan_need_input,
+	.have_output = spa_graph_plan_have_output,
+};
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_GRAPH_SCHEDULER7_H__ */
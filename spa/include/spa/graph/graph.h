@@ -49,6 +49,7 @@ struct spa_graph {
 	struct spa_list nodes;
 	const struct spa_graph_callbacks *callbacks;
 	void *callbacks_data;
+	uint32_t version;		/**< incremented when the topology changes */
 };
 
 #define spa_graph_need_input(g,n)	((g)->callbacks->need_input((g)->callbacks_data, (n)))
@@ -84,6 +85,13 @@ struct spa_graph_port {
 static inline void spa_graph_init(struct spa_graph *graph)
 {
 	spa_list_init(&graph->nodes);
+	graph->version = 0;
+}
+
+static inline void spa_graph_node_changed(struct spa_graph_node *node)
+{
+	if (node && node->graph)
+		node->graph->version++;
 }
 
 static inline void
@@ -100,6 +108,7 @@ spa_graph_node_init(struct spa_graph_node *node)
 {
 	spa_list_init(&node->ports[SPA_DIRECTION_INPUT]);
 	spa_list_init(&node->ports[SPA_DIRECTION_OUTPUT]);
+	node->graph = NULL;
 	node->flags = 0;
 	node->required[SPA_DIRECTION_INPUT] = node->ready[SPA_DIRECTION_INPUT] = 0;
 	node->required[SPA_DIRECTION_OUTPUT] = node->ready[SPA_DIRECTION_OUTPUT] = 0;
@@ -121,6 +130,7 @@ spa_graph_node_add(struct spa_graph *graph,
 	node->state = SPA_STATUS_OK;
 	node->ready_link.next = NULL;
 	spa_list_append(&graph->nodes, &node->link);
+	graph->version++;
 	spa_debug("node %p add", node);
 }
 
@@ -136,6 +146,7 @@ spa_graph_port_init(struct spa_graph_port *port,
 	port->port_id = port_id;
 	port->flags = flags;
 	port->io = io;
+	port->node = NULL;
 }
 
 static inline void
@@ -147,6 +158,7 @@ spa_graph_port_add(struct spa_graph_node *node,
 	spa_list_append(&node->ports[port->direction], &port->link);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
 		node->required[port->direction]++;
+	spa_graph_node_changed(node);
 }
 
 static inline void spa_graph_node_remove(struct spa_graph_node *node)
@@ -155,6 +167,7 @@ static inline void spa_graph_node_remove(struct spa_graph_node *node)
 	spa_list_remove(&node->link);
 	if (node->ready_link.next)
 		spa_list_remove(&node->ready_link);
+	spa_graph_node_changed(node);
 }
 
 static inline void spa_graph_port_remove(struct spa_graph_port *port)
@@ -165,6 +178,7 @@ static inline void spa_graph_port_remove(struct spa_graph_port *port)
 	    port->node->required[port->direction] > 0) {
 		port->node->required[port->direction]--;
 	}
+	spa_graph_node_changed(port->node);
 }
 
 static inline void
@@ -173,6 +187,9 @@ spa_graph_port_link(struct spa_graph_port *out, struct spa_graph_port *in)
 	spa_debug("port %p link to %p", out, in);
 	out->peer = in;
 	in->peer = out;
+	spa_graph_node_changed(out->node);
+	if (in->node && in->node->graph != out->node->graph)
+		spa_graph_node_changed(in->node);
 }
 
 static inline void
@@ -182,6 +199,7 @@ spa_graph_port_unlink(struct spa_graph_port *port)
 	if (port->peer) {
 		port->peer->peer = NULL;
 		port->peer = NULL;
+		spa_graph_node_changed(port->node);
 	}
 }
 
@@ -44,6 +44,7 @@ extern "C" {
 #define SPA_TYPE_PROPS__periods		SPA_TYPE_PROPS_BASE "periods"
 #define SPA_TYPE_PROPS__periodSize	SPA_TYPE_PROPS_BASE "periodSize"
 #define SPA_TYPE_PROPS__periodEvent	SPA_TYPE_PROPS_BASE "periodEvent"
+#define SPA_TYPE_PROPS__quantum		SPA_TYPE_PROPS_BASE "quantum"
 
 #define SPA_TYPE_PROPS__live		SPA_TYPE_PROPS_BASE "live"
 #define SPA_TYPE_PROPS__waveType	SPA_TYPE_PROPS_BASE "waveType"
@@ -0,0 +1,64 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_CPU_H__
+#define __SPA_CPU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/utils/defs.h>
+
+#if defined (__arm__) && !defined (__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/** SIMD features of the CPU, plugins use this to select optimized
+ * functions at runtime */
+#define SPA_CPU_FLAG_SSE2	(1 << 0)
+#define SPA_CPU_FLAG_AVX2	(1 << 1)
+#define SPA_CPU_FLAG_NEON	(1 << 2)
+
+/** get the SIMD features of the running CPU */
+static inline uint32_t spa_cpu_get_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined (__GNUC__) && (defined (__i386__) || defined (__x86_64__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= SPA_CPU_FLAG_SSE2;
+	if (__builtin_cpu_supports("avx2"))
+		flags |= SPA_CPU_FLAG_AVX2;
+#elif defined (__aarch64__)
+	flags |= SPA_CPU_FLAG_NEON;
+#elif defined (__arm__)
+	if (getauxval(AT_HWCAP) & HWCAP_NEON)
+		flags |= SPA_CPU_FLAG_NEON;
+#endif
+	return flags;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_CPU_H__ */
@@ -136,6 +136,8 @@ struct spa_loop_control {
 	void (*enter) (struct spa_loop_control *ctrl);
 	void (*leave) (struct spa_loop_control *ctrl);
 
+	/** Wait at most \a timeout milliseconds for events and dispatch them,
+	 * -1 waits forever. Returns the number of events or a negative errno */
 	int (*iterate) (struct spa_loop_control *ctrl, int timeout);
 };
 
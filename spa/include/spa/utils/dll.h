@@ -0,0 +1,97 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_DLL_H__
+#define __SPA_DLL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#define SPA_DLL_BW_MAX		0.128	/**< bandwidth to lock quickly */
+#define SPA_DLL_BW_MIN		0.016	/**< bandwidth when locked */
+
+/**
+ * A delay-locked loop.
+ *
+ * The loop is fed with the error between the expected and the measured
+ * position of a clock, in samples, once per period. It filters the
+ * measurement noise and returns the rate correction to apply to the
+ * period so that the error goes to 0.
+ */
+struct spa_dll {
+	double bw;		/*< the current bandwidth */
+	double z1, z2, z3;	/*< filter state */
+	double w0, w1, w2;	/*< filter coefficients */
+};
+
+/**
+ * Reset the state of \a dll, the bandwidth must be configured with
+ * spa_dll_set_bw() before use.
+ *
+ * \param dll a spa_dll
+ */
+static inline void spa_dll_init(struct spa_dll *dll)
+{
+	dll->bw = 0.0;
+	dll->z1 = dll->z2 = dll->z3 = 0.0;
+}
+
+/**
+ * Configure the bandwidth of \a dll. The filter state is kept so that
+ * the bandwidth can be lowered once the loop is locked.
+ *
+ * \param dll a spa_dll
+ * \param bw the bandwidth relative to the update rate
+ * \param period the number of samples between updates
+ * \param rate the sample rate
+ */
+static inline void spa_dll_set_bw(struct spa_dll *dll, double bw, uint32_t period, uint32_t rate)
+{
+	double w = 2 * M_PI * bw * period / rate;
+	dll->w0 = 1.0 - exp(-20.0 * w);
+	dll->w1 = w * 1.5 / period;
+	dll->w2 = w / 1.5;
+	dll->bw = bw;
+}
+
+/**
+ * Update \a dll with a new error measurement.
+ *
+ * \param dll a spa_dll
+ * \param err the measured position minus the expected position
+ * \return the rate correction, 1.0 when the clocks run at the same rate
+ */
+static inline double spa_dll_update(struct spa_dll *dll, double err)
+{
+	dll->z1 += dll->w0 * (dll->w1 * err - dll->z1);
+	dll->z2 += dll->w0 * (dll->z1 - dll->z2);
+	dll->z3 += dll->w2 * dll->z2;
+	return 1.0 - (dll->z2 + dll->z3);
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_DLL_H__ */
@@ -34,11 +34,14 @@
 
 static const char default_device[] = "hw:0";
 static const uint32_t default_min_latency = 1024;
+static const uint32_t default_max_latency = 1024;
 
 static void reset_props(struct props *props)
 {
 	strncpy(props->device, default_device, 64);
 	props->min_latency = default_min_latency;
+	props->max_latency = default_max_latency;
+	props->quantum = 0;
 }
 
 static int impl_node_enum_params(struct spa_node *node,
@@ -107,6 +110,22 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->param.propType, "ir", p->min_latency,
 					SPA_POD_PROP_MIN_MAX(1, INT32_MAX));
 			break;
+		case 4:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId, "I", t->prop_max_latency,
+				":", t->param.propName, "s", "The maximum latency",
+				":", t->param.propType, "ir", p->max_latency,
+					SPA_POD_PROP_MIN_MAX(1, INT32_MAX));
+			break;
+		case 5:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId, "I", t->prop_quantum,
+				":", t->param.propName, "s", "The frames per cycle, 0 for the minimum latency",
+				":", t->param.propType, "ir", p->quantum,
+					SPA_POD_PROP_MIN_MAX(0, INT32_MAX));
+			break;
 		default:
 			return 0;
 		}
@@ -119,7 +138,9 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->prop_device,      "S",   p->device, sizeof(p->device),
 				":", t->prop_device_name, "S-r", p->device_name, sizeof(p->device_name),
 				":", t->prop_card_name,   "S-r", p->card_name, sizeof(p->card_name),
-				":", t->prop_min_latency, "i",   p->min_latency);
+				":", t->prop_min_latency, "i",   p->min_latency,
+				":", t->prop_max_latency, "i",   p->max_latency,
+				":", t->prop_quantum,     "i",   p->quantum);
 			break;
 		default:
 			return 0;
@@ -152,11 +173,16 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 
 		if (param == NULL) {
 			reset_props(p);
-			return 0;
+			return spa_alsa_update_quantum(this);
 		}
 		spa_pod_object_parse(param,
 			":", t->prop_device,      "?S", p->device, sizeof(p->device),
-			":", t->prop_min_latency, "?i", &p->min_latency, NULL);
+			":", t->prop_min_latency, "?i", &p->min_latency,
+			":", t->prop_max_latency, "?i", &p->max_latency,
+			":", t->prop_quantum,     "?i", &p->quantum, NULL);
+
+		/* the quantum can change while running */
+		return spa_alsa_update_quantum(this);
 	}
 	else
 		return -ENOENT;
@@ -284,6 +310,8 @@ static void recycle_buffer(struct state *this, uint32_t buffer_id)
 
 	b->outstanding = false;
 	spa_list_append(&this->free, &b->link);
+
+	spa_alsa_release_buffer(this, b);
 }
 
 static int port_get_format(struct spa_node *node,
@@ -306,7 +334,8 @@ static int port_get_format(struct spa_node *node,
 		"I", t->media_subtype.raw,
 		":", t->format_audio.format,   "I", this->current_format.info.raw.format,
 		":", t->format_audio.rate,     "i", this->current_format.info.raw.rate,
-		":", t->format_audio.channels, "i", this->current_format.info.raw.channels);
+		":", t->format_audio.channels, "i", this->current_format.info.raw.channels,
+		":", t->format_audio.layout,   "i", this->current_format.info.raw.layout);
 
 	return 1;
 }
@@ -365,7 +394,7 @@ impl_node_port_enum_params(struct spa_node *node,
 
 		param = spa_pod_builder_object(&b,
 			id, t->param_buffers.Buffers,
-			":", t->param_buffers.size,    "i", this->props.min_latency * this->frame_size,
+			":", t->param_buffers.size,    "i", this->props.max_latency * this->frame_size,
 			":", t->param_buffers.stride,  "i", 0,
 			":", t->param_buffers.buffers, "ir", 2,
 				SPA_POD_PROP_MIN_MAX(1, MAX_BUFFERS),
@@ -502,6 +531,10 @@ impl_node_port_use_buffers(struct spa_node *node,
 
 		b->h = spa_buffer_find_meta(b->outbuf, this->type.meta.Header);
 
+		if (buffers[i]->n_datas < this->blocks) {
+			spa_log_error(this->log, NAME " %p: need %u data blocks", this, this->blocks);
+			return -EINVAL;
+		}
 		if (!((d[0].type == this->type.data.MemFd ||
 		       d[0].type == this->type.data.DmaBuf ||
 		       d[0].type == this->type.data.MemPtr) && d[0].data != NULL)) {
@@ -511,6 +544,7 @@ impl_node_port_use_buffers(struct spa_node *node,
 		spa_list_append(&this->free, &b->link);
 	}
 	this->n_buffers = n_buffers;
+	this->zero_copy = false;
 
 	return 0;
 }
@@ -526,6 +560,8 @@ impl_node_port_alloc_buffers(struct spa_node *node,
 			     uint32_t *n_buffers)
 {
 	struct state *this;
+	uint32_t i, j;
+	int res;
 
 	spa_return_val_if_fail(node != NULL, -EINVAL);
 	spa_return_val_if_fail(buffers != NULL, -EINVAL);
@@ -534,10 +570,46 @@ impl_node_port_alloc_buffers(struct spa_node *node,
 
 	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
 
-	if (this->n_buffers == 0)
+	if (!(this->info.flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS))
+		return -ENOTSUP;
+
+	if (!this->have_format)
 		return -EIO;
 
-	return -ENOTSUP;
+	if (this->n_buffers > 0) {
+		spa_alsa_pause(this, false);
+		if ((res = clear_buffers(this)) < 0)
+			return res;
+	}
+	/* the data is pointed to the mmap area of the device when capturing */
+	for (i = 0; i < *n_buffers; i++) {
+		struct buffer *b = &this->buffers[i];
+		struct spa_data *d = buffers[i]->datas;
+
+		if (buffers[i]->n_datas < this->blocks) {
+			spa_log_error(this->log, NAME " %p: need %u data blocks", this, this->blocks);
+			return -EINVAL;
+		}
+
+		b->outbuf = buffers[i];
+		b->outstanding = false;
+
+		b->h = spa_buffer_find_meta(b->outbuf, this->type.meta.Header);
+
+		for (j = 0; j < buffers[i]->n_datas; j++) {
+			d[j].type = this->type.data.MemPtr;
+			d[j].flags = 0;
+			d[j].fd = -1;
+			d[j].mapoffset = 0;
+			d[j].maxsize = this->props.max_latency * this->frame_size;
+			d[j].data = NULL;
+		}
+		spa_list_append(&this->free, &b->link);
+	}
+	this->n_buffers = *n_buffers;
+	this->zero_copy = true;
+
+	return 0;
 }
 
 static int
@@ -678,7 +750,7 @@ static int impl_clock_get_time(struct spa_clock *clock,
 	this = SPA_CONTAINER_OF(clock, struct state, clock);
 
 	if (rate)
-		*rate = SPA_USEC_PER_SEC;
+		*rate = this->rate;
 	if (ticks)
 		*ticks = this->last_ticks;
 	if (monotonic_time)
@@ -779,6 +851,12 @@ impl_init(const struct spa_handle_factory *factory,
 		if (!strcmp(info->items[i].key, "alsa.card")) {
 			snprintf(this->props.device, 63, "%s", info->items[i].value);
 		}
+		else if (!strcmp(info->items[i].key, "alsa.zero-copy")) {
+			/* only for consumers in this process that are done with the
+			 * data before the device wraps around */
+			if (atoi(info->items[i].value))
+				this->info.flags |= SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS;
+		}
 	}
 	return 0;
 }
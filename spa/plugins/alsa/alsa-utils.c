@@ -193,6 +193,24 @@ spa_alsa_enum_format(struct state *state, uint32_t *index,
 	}
 	spa_pod_builder_pop(&b);
 
+	prop = spa_pod_builder_deref(&b,
+		spa_pod_builder_push_prop(&b, state->type.format_audio.layout, SPA_POD_PROP_RANGE_NONE));
+
+	j = 0;
+	if (snd_pcm_hw_params_test_access(hndl, params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0) {
+		spa_pod_builder_int(&b, SPA_AUDIO_LAYOUT_INTERLEAVED);
+		spa_pod_builder_int(&b, SPA_AUDIO_LAYOUT_INTERLEAVED);
+		j++;
+	}
+	if (snd_pcm_hw_params_test_access(hndl, params, SND_PCM_ACCESS_MMAP_NONINTERLEAVED) == 0) {
+		if (j++ == 0)
+			spa_pod_builder_int(&b, SPA_AUDIO_LAYOUT_NON_INTERLEAVED);
+		spa_pod_builder_int(&b, SPA_AUDIO_LAYOUT_NON_INTERLEAVED);
+	}
+	if (j > 1)
+		prop->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
+	spa_pod_builder_pop(&b);
+
 	fmt = spa_pod_builder_pop(&b);
 
 	(*index)++;
@@ -218,6 +236,7 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	struct spa_audio_info_raw *info = &fmt->info.raw;
 	snd_pcm_t *hndl;
 	unsigned int periods;
+	bool planar;
 
 	if ((err = spa_alsa_open(state)) < 0)
 		return err;
@@ -229,8 +248,11 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	CHECK(snd_pcm_hw_params_any(hndl, params), "Broken configuration for playback: no configurations available");
 	/* set hardware resampling */
 	CHECK(snd_pcm_hw_params_set_rate_resample(hndl, params, 0), "set_rate_resample");
-	/* set the interleaved read/write format */
-	CHECK(snd_pcm_hw_params_set_access(hndl, params, SND_PCM_ACCESS_MMAP_INTERLEAVED), "set_access");
+	/* set the interleaved or planar read/write format */
+	planar = info->layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED;
+	CHECK(snd_pcm_hw_params_set_access(hndl, params, planar ?
+				SND_PCM_ACCESS_MMAP_NONINTERLEAVED :
+				SND_PCM_ACCESS_MMAP_INTERLEAVED), "set_access");
 
 	/* disable ALSA wakeups, we use a timer */
 	if (snd_pcm_hw_params_can_disable_period_wakeup(params))
@@ -270,7 +292,9 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *fmt, uint32_
 	state->format = format;
 	state->channels = info->channels;
 	state->rate = info->rate;
-	state->frame_size = info->channels * (snd_pcm_format_physical_width(format) / 8);
+	state->planar = planar;
+	state->blocks = planar ? info->channels : 1;
+	state->frame_size = (planar ? 1 : info->channels) * (snd_pcm_format_physical_width(format) / 8);
 
 	CHECK(snd_pcm_hw_params_get_buffer_size_max(params, &state->buffer_frames), "get_buffer_size_max");
 
@@ -304,6 +328,8 @@ static int set_swparams(struct state *state)
 	CHECK(snd_pcm_sw_params_current(hndl, params), "sw_params_current");
 
 	CHECK(snd_pcm_sw_params_set_tstamp_mode(hndl, params, SND_PCM_TSTAMP_ENABLE), "sw_params_set_tstamp_mode");
+	/* our timer runs on the monotonic clock, make the timestamps match */
+	CHECK(snd_pcm_sw_params_set_tstamp_type(hndl, params, SND_PCM_TSTAMP_TYPE_MONOTONIC), "sw_params_set_tstamp_type");
 
 	/* start the transfer */
 	CHECK(snd_pcm_sw_params_set_start_threshold(hndl, params, LONG_MAX), "set_start_threshold");
@@ -319,19 +345,83 @@ static int set_swparams(struct state *state)
 	return 0;
 }
 
-static inline void calc_timeout(size_t target, size_t current,
-				size_t rate, snd_htimestamp_t *now,
-				struct timespec *ts)
+static inline uint64_t timespec_to_nsec(const struct timespec *ts)
+{
+	return (uint64_t) ts->tv_sec * SPA_NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static inline void nsec_to_timespec(uint64_t nsec, struct timespec *ts)
+{
+	ts->tv_sec = nsec / SPA_NSEC_PER_SEC;
+	ts->tv_nsec = nsec % SPA_NSEC_PER_SEC;
+}
+
+static void reset_dll(struct state *state, uint64_t now)
+{
+	spa_dll_init(&state->dll);
+	spa_dll_set_bw(&state->dll, SPA_DLL_BW_MAX, state->threshold, state->rate);
+	state->rate_corr = 1.0;
+	state->dll_start = now;
+}
+
+/* Calculate the time of the next wakeup.
+ *
+ * \a err is the number of frames the device is behind (positive) or
+ * ahead (negative) of where we expected it to be at this wakeup and
+ * \a frames the number of frames we expect the device to process before
+ * the next wakeup.
+ *
+ * The error is filtered with the dll so that the wakeups follow the
+ * rate of the device without the jitter of the measurements. When the
+ * error is too big to be jitter, or we can't predict the next wakeup,
+ * we resync to \a deadline, the wakeup time calculated from the raw
+ * measurement at \a now.
+ */
+static uint64_t update_time(struct state *state, uint64_t now, int64_t err,
+			    snd_pcm_uframes_t frames, uint64_t deadline)
 {
-	ts->tv_sec = now->tv_sec;
-	ts->tv_nsec = now->tv_nsec;
-	if (target > current)
-		ts->tv_nsec += ((target - current) * SPA_NSEC_PER_SEC) / rate;
+	uint64_t next_time;
+	int64_t diff, max_diff;
+
+	if (state->next_time == 0 || frames == 0 || llabs(err) > state->threshold) {
+		spa_log_trace(state->log, "alsa %p: resync err:%ld", state, err);
+		reset_dll(state, now);
+		return deadline;
+	}
 
-	while (ts->tv_nsec >= SPA_NSEC_PER_SEC) {
-		ts->tv_sec++;
-		ts->tv_nsec -= SPA_NSEC_PER_SEC;
+	state->rate_corr = spa_dll_update(&state->dll, err);
+
+	/* lower the bandwidth after the loop had time to lock */
+	if (state->dll.bw > SPA_DLL_BW_MIN && now - state->dll_start > SPA_NSEC_PER_SEC)
+		spa_dll_set_bw(&state->dll, SPA_DLL_BW_MIN, state->threshold, state->rate);
+
+	next_time = state->next_time +
+		(uint64_t) (frames / state->rate_corr * SPA_NSEC_PER_SEC / state->rate);
+
+	/* never drift too far from the device, we would underrun */
+	diff = (int64_t) (next_time - deadline);
+	max_diff = (int64_t) state->threshold * SPA_NSEC_PER_SEC / state->rate / 2;
+	if (llabs(diff) > max_diff) {
+		spa_log_trace(state->log, "alsa %p: resync diff:%ld", state, diff);
+		reset_dll(state, now);
+		return deadline;
 	}
+
+	spa_log_trace(state->log, "alsa %p: err:%ld corr:%f diff:%ld", state,
+		      err, state->rate_corr, diff);
+
+	return next_time;
+}
+
+static void set_timeout(struct state *state, uint64_t time)
+{
+	struct itimerspec ts;
+
+	state->next_time = time;
+	nsec_to_timespec(time, &ts.it_value);
+	ts.it_interval.tv_sec = 0;
+	ts.it_interval.tv_nsec = 0;
+	timerfd_settime(state->timerfd, TFD_TIMER_ABSTIME, &ts, NULL);
 }
 
 static inline void try_pull(struct state *state, snd_pcm_uframes_t frames,
@@ -352,6 +442,11 @@ static inline void try_pull(struct state *state, snd_pcm_uframes_t frames,
 	}
 }
 
+static inline void *area_ptr(const snd_pcm_channel_area_t *area, snd_pcm_uframes_t offset)
+{
+	return SPA_MEMBER(area->addr, (area->first + offset * area->step) / 8, void);
+}
+
 static inline snd_pcm_uframes_t
 pull_frames(struct state *state,
 	    const snd_pcm_channel_area_t *my_areas,
@@ -361,6 +456,7 @@ pull_frames(struct state *state,
 {
 	snd_pcm_uframes_t total_frames = 0, to_write = SPA_MIN(frames, state->props.max_latency);
 	bool underrun = false;
+	uint32_t i;
 
 	try_pull(state, frames, 0, do_pull);
 
@@ -374,9 +470,6 @@ pull_frames(struct state *state,
 		b = spa_list_first(&state->ready, struct buffer, link);
 		d = b->outbuf->datas;
 
-		dst = SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, uint8_t);
-		src = d[0].data;
-
 		index = d[0].chunk->offset + state->ready_offset;
 		avail = d[0].chunk->size - state->ready_offset;
 		avail /= state->frame_size;
@@ -384,13 +477,19 @@ pull_frames(struct state *state,
 		n_frames = SPA_MIN(avail, to_write);
 		n_bytes = n_frames * state->frame_size;
 
-		offs = index % d[0].maxsize;
-		l0 = SPA_MIN(n_bytes, d[0].maxsize - offs);
-		l1 = n_bytes - l0;
+		/* one block for interleaved, one block per channel otherwise */
+		for (i = 0; i < state->blocks; i++) {
+			dst = area_ptr(&my_areas[i], offset);
+			src = d[i].data;
 
-		memcpy(dst, src + offs, l0);
-		if (l1 > 0)
-			memcpy(dst + l0, src, l1);
+			offs = index % d[i].maxsize;
+			l0 = SPA_MIN(n_bytes, d[i].maxsize - offs);
+			l1 = n_bytes - l0;
+
+			memcpy(dst, src + offs, l0);
+			if (l1 > 0)
+				memcpy(dst + l0, src, l1);
+		}
 
 		state->ready_offset += n_bytes;
 
@@ -428,62 +527,121 @@ pull_frames(struct state *state,
 	return total_frames;
 }
 
-static snd_pcm_uframes_t
-push_frames(struct state *state,
-	    const snd_pcm_channel_area_t *my_areas,
-	    snd_pcm_uframes_t offset,
-	    snd_pcm_uframes_t frames)
+static inline int mmap_commit(struct state *state, snd_pcm_uframes_t offset,
+			      snd_pcm_uframes_t frames)
+{
+	int res;
+
+	if ((res = snd_pcm_mmap_commit(state->hndl, offset, frames)) < 0) {
+		spa_log_error(state->log, "snd_pcm_mmap_commit error: %s", snd_strerror(res));
+		if (res != -EPIPE && res != -ESTRPIPE)
+			return res;
+	}
+	return 0;
+}
+
+/* Capture \a frames into one buffer and push it out.
+ *
+ * The frames are copied from as many mmap areas as needed to fill the
+ * buffer, so that a wraparound of the device buffer doesn't split the
+ * data over two buffers. In zero-copy mode the buffer data points
+ * into the mmap area and the area is only committed when the buffer is
+ * recycled. Until then ALSA does not give out a new area and nothing
+ * is captured.
+ */
+static snd_pcm_sframes_t
+push_frames(struct state *state, snd_pcm_uframes_t frames)
 {
 	snd_pcm_uframes_t total_frames = 0;
 	struct spa_io_buffers *io = state->io;
+	const snd_pcm_channel_area_t *my_areas;
+	snd_pcm_uframes_t offset, n_frames;
+	struct buffer *b;
+	struct spa_data *d;
+	uint32_t i, maxframes;
+	int res;
 
+	if (state->mmap_buffer) {
+		spa_log_trace(state->log, "mmap area still in use");
+		return 0;
+	}
 	if (spa_list_is_empty(&state->free)) {
 		spa_log_trace(state->log, "no more buffers");
-	} else {
-		uint8_t *src;
-		size_t n_bytes;
-		struct buffer *b;
-		struct spa_data *d;
-		uint32_t index, offs, avail, l0, l1;
+		return 0;
+	}
 
-		b = spa_list_first(&state->free, struct buffer, link);
-		spa_list_remove(&b->link);
+	b = spa_list_first(&state->free, struct buffer, link);
+	spa_list_remove(&b->link);
 
-		if (b->h) {
-			b->h->seq = state->sample_count;
-			b->h->pts = state->last_monotonic;
-			b->h->dts_offset = 0;
-		}
+	if (b->h) {
+		b->h->seq = state->sample_count;
+		b->h->pts = state->last_monotonic;
+		b->h->dts_offset = 0;
+	}
 
-		d = b->outbuf->datas;
+	d = b->outbuf->datas;
 
-		src = SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, uint8_t);
+	maxframes = d[0].maxsize / state->frame_size;
+	frames = SPA_MIN(frames, maxframes);
 
-		avail = d[0].maxsize / state->frame_size;
-		index = 0;
-		total_frames = SPA_MIN(avail, frames);
-		n_bytes = total_frames * state->frame_size;
+	while (total_frames < frames) {
+		n_frames = frames - total_frames;
+		if ((res = snd_pcm_mmap_begin(state->hndl, &my_areas, &offset, &n_frames)) < 0) {
+			spa_log_error(state->log, "snd_pcm_mmap_begin error: %s", snd_strerror(res));
+			break;
+		}
+		if (state->zero_copy) {
+			/* only the contiguous part of the mmap area */
+			for (i = 0; i < state->blocks; i++)
+				d[i].data = area_ptr(&my_areas[i], offset);
+			total_frames = n_frames;
+			break;
+		}
+		for (i = 0; i < state->blocks; i++)
+			memcpy(SPA_MEMBER(d[i].data, total_frames * state->frame_size, void),
+			       area_ptr(&my_areas[i], offset),
+			       n_frames * state->frame_size);
 
-		offs = index % d[0].maxsize;
-		l0 = SPA_MIN(n_bytes, d[0].maxsize - offs);
-		l1 = n_bytes - l0;
+		if ((res = mmap_commit(state, offset, n_frames)) < 0)
+			break;
+
+		total_frames += n_frames;
+	}
 
-		memcpy(src, d[0].data + offs, l0);
-		if (l1 > 0)
-			memcpy(src + l0, d[0].data, l1);
+	if (total_frames == 0) {
+		spa_list_prepend(&state->free, &b->link);
+		return 0;
+	}
 
-		d[0].chunk->offset = index;
-		d[0].chunk->size = n_bytes;
-		d[0].chunk->stride = state->frame_size;
+	for (i = 0; i < state->blocks; i++) {
+		d[i].chunk->offset = 0;
+		d[i].chunk->size = total_frames * state->frame_size;
+		d[i].chunk->stride = state->frame_size;
+	}
 
-		b->outstanding = true;
-		io->buffer_id = b->outbuf->id;
-		io->status = SPA_STATUS_HAVE_BUFFER;
-		state->callbacks->have_output(state->callbacks_data);
+	b->outstanding = true;
+	if (state->zero_copy) {
+		state->mmap_buffer = b;
+		state->mmap_offset = offset;
+		state->mmap_frames = total_frames;
 	}
+	io->buffer_id = b->outbuf->id;
+	io->status = SPA_STATUS_HAVE_BUFFER;
+	state->callbacks->have_output(state->callbacks_data);
+
 	return total_frames;
 }
 
+/* the buffer is recycled, a zero-copy buffer gives its area back to ALSA */
+void spa_alsa_release_buffer(struct state *state, struct buffer *b)
+{
+	if (state->mmap_buffer != b)
+		return;
+
+	state->mmap_buffer = NULL;
+	mmap_commit(state, state->mmap_offset, state->mmap_frames);
+}
+
 static int alsa_try_resume(struct state *state)
 {
 	int res;
@@ -506,10 +664,12 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 	struct state *state = source->data;
 	snd_pcm_t *hndl = state->hndl;
 	snd_pcm_sframes_t avail;
-	struct itimerspec ts;
 	snd_pcm_uframes_t total_written = 0;
 	const snd_pcm_channel_area_t *my_areas;
 	snd_pcm_status_t *status;
+	uint64_t now, deadline;
+	int64_t delay;
+	bool was_started = state->alsa_started;
 
 	if (state->started && read(state->timerfd, &exp, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(state->log, "error reading timerfd: %s", strerror(errno));
@@ -528,14 +688,25 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 		avail = state->buffer_frames;
 
 	state->filled = state->buffer_frames - avail;
-
-	state->last_ticks = state->sample_count - state->filled;
-	state->last_monotonic = (int64_t) state->now.tv_sec * SPA_NSEC_PER_SEC + (int64_t) state->now.tv_nsec;
+	delay = state->filled;
+	now = timespec_to_nsec(&state->now);
+
+	/* the clock is where the device should be at the planned wakeup,
+	 * this doesn't have the jitter of the measurement */
+	if (state->next_time != 0 && was_started) {
+		state->last_ticks = state->sample_count - state->threshold;
+		state->last_monotonic = state->next_time;
+	} else {
+		state->last_ticks = state->sample_count - state->filled;
+		state->last_monotonic = now;
+	}
 
 	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", state->filled, state->threshold,
 		      state->sample_count, state->now.tv_sec, state->now.tv_nsec);
 
-	if (state->filled > state->threshold) {
+	/* we are woken up around the threshold, only when we are much too
+	 * early there is nothing to do */
+	if (state->filled > state->threshold + state->threshold / 2) {
 		if (snd_pcm_state(hndl) == SND_PCM_STATE_SUSPENDED) {
 			spa_log_error(state->log, "suspended: try resume");
 			if ((res = alsa_try_resume(state)) < 0)
@@ -560,11 +731,8 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 				to_write = 0;
 
 			spa_log_trace(state->log, "commit %ld %ld", offset, written);
-			if ((res = snd_pcm_mmap_commit(hndl, offset, written)) < 0) {
-				spa_log_error(state->log, "snd_pcm_mmap_commit error: %s", snd_strerror(res));
-				if (res != -EPIPE && res != -ESTRPIPE)
-					return;
-			}
+			if ((res = mmap_commit(state, offset, written)) < 0)
+				return;
 			total_written += written;
 			state->sample_count += written;
 			state->filled += written;
@@ -580,11 +748,14 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 		state->alsa_started = true;
 	}
 
-	calc_timeout(state->filled, state->threshold, state->rate, &state->now, &ts.it_value);
+	/* wake up when the device has played until the threshold */
+	deadline = now;
+	if (state->filled > state->threshold)
+		deadline += (state->filled - state->threshold) * SPA_NSEC_PER_SEC / state->rate;
 
-	ts.it_interval.tv_sec = 0;
-	ts.it_interval.tv_nsec = 0;
-	timerfd_settime(state->timerfd, TFD_TIMER_ABSTIME, &ts, NULL);
+	/* before the device is started we can't predict anything */
+	set_timeout(state, update_time(state, now, delay - state->threshold,
+				       was_started ? total_written : 0, deadline));
 }
 
 
@@ -596,10 +767,9 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 	snd_pcm_t *hndl = state->hndl;
 	snd_pcm_sframes_t avail;
 	snd_pcm_uframes_t total_read = 0;
-	struct itimerspec ts;
-	const snd_pcm_channel_area_t *my_areas;
 	snd_pcm_status_t *status;
 	snd_htimestamp_t htstamp;
+	uint64_t now, deadline;
 
 	if (state->started && read(state->timerfd, &exp, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(state->log, "error reading timerfd: %s", strerror(errno));
@@ -614,8 +784,15 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 	avail = snd_pcm_status_get_avail(status);
 	snd_pcm_status_get_htstamp(status, &htstamp);
 
-	state->last_ticks = state->sample_count + avail;
-	state->last_monotonic = (int64_t) htstamp.tv_sec * SPA_NSEC_PER_SEC + (int64_t) htstamp.tv_nsec;
+	now = timespec_to_nsec(&htstamp);
+
+	if (state->next_time != 0) {
+		state->last_ticks = state->sample_count + state->threshold;
+		state->last_monotonic = state->next_time;
+	} else {
+		state->last_ticks = state->sample_count + avail;
+		state->last_monotonic = now;
+	}
 
 	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", avail, state->threshold,
 		      state->sample_count, htstamp.tv_sec, htstamp.tv_nsec);
@@ -627,35 +804,68 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 				return;
 		}
 	} else {
-		snd_pcm_uframes_t to_read = avail;
+		snd_pcm_sframes_t n_read;
 
-		while (total_read < to_read) {
-			snd_pcm_uframes_t read, frames, offset;
+		if ((n_read = push_frames(state, SPA_MIN(avail, state->threshold))) < 0)
+			return;
+		total_read = n_read;
+		state->sample_count += total_read;
+	}
+	/* wake up when the device has captured the threshold again */
+	deadline = now;
+	if (state->threshold > avail - total_read)
+		deadline += (state->threshold - (avail - total_read)) * SPA_NSEC_PER_SEC / state->rate;
 
-			frames = to_read - total_read;
-			if ((res = snd_pcm_mmap_begin(hndl, &my_areas, &offset, &frames)) < 0) {
-				spa_log_error(state->log, "snd_pcm_mmap_begin error: %s", snd_strerror(res));
-				return;
-			}
+	set_timeout(state, update_time(state, now, state->threshold - avail,
+				       total_read, deadline));
+}
 
-			read = push_frames(state, my_areas, offset, frames);
-			if (read < frames)
-				to_read = 0;
+static uint32_t get_quantum(struct state *state)
+{
+	uint32_t quantum = state->props.quantum;
 
-			if ((res = snd_pcm_mmap_commit(hndl, offset, read)) < 0) {
-				spa_log_error(state->log, "snd_pcm_mmap_commit error: %s", snd_strerror(res));
-				if (res != -EPIPE && res != -ESTRPIPE)
-					return;
-			}
-			total_read += read;
-		}
-		state->sample_count += total_read;
-	}
-	calc_timeout(state->threshold, avail - total_read, state->rate, &htstamp, &ts.it_value);
+	if (quantum == 0)
+		quantum = state->props.min_latency;
+	if (state->props.max_latency > 0)
+		quantum = SPA_MIN(quantum, state->props.max_latency);
+	/* leave room in the device buffer for the next cycle */
+	if (state->buffer_frames > 0)
+		quantum = SPA_MIN(quantum, state->buffer_frames / 2);
 
-	ts.it_interval.tv_sec = 0;
-	ts.it_interval.tv_nsec = 0;
-	timerfd_settime(state->timerfd, TFD_TIMER_ABSTIME, &ts, NULL);
+	return SPA_MAX(quantum, 1u);
+}
+
+static int do_update_quantum(struct spa_loop *loop,
+			     bool async,
+			     uint32_t seq,
+			     const void *data,
+			     size_t size,
+			     void *user_data)
+{
+	struct state *state = user_data;
+	uint32_t quantum = *(const uint32_t *) data;
+
+	if (state->threshold == quantum)
+		return 0;
+
+	spa_log_info(state->log, "alsa %p: quantum %d -> %u", state, state->threshold, quantum);
+	state->threshold = quantum;
+	/* the dll was locked on the old quantum, resync on the next wakeup */
+	state->next_time = 0;
+
+	return 0;
+}
+
+int spa_alsa_update_quantum(struct state *state)
+{
+	uint32_t quantum = get_quantum(state);
+
+	if (!state->started) {
+		state->threshold = quantum;
+		return 0;
+	}
+	return spa_loop_invoke(state->data_loop, do_update_quantum, 0,
+			       &quantum, sizeof(quantum), true, state);
 }
 
 int spa_alsa_start(struct state *state, bool xrun_recover)
@@ -688,7 +898,10 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	state->source.rmask = 0;
 	spa_loop_add_source(state->data_loop, &state->source);
 
-	state->threshold = state->props.min_latency;
+	state->threshold = get_quantum(state);
+	state->next_time = 0;
+	state->mmap_buffer = NULL;
+	reset_dll(state, 0);
 
 	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
 		state->alsa_started = false;
@@ -745,6 +958,8 @@ int spa_alsa_pause(struct state *state, bool xrun_recover)
 	if ((err = snd_pcm_drop(state->hndl)) < 0)
 		spa_log_error(state->log, "snd_pcm_drop %s", snd_strerror(err));
 
+	/* the area of an outstanding zero-copy buffer is gone with the drop */
+	state->mmap_buffer = NULL;
 	state->started = false;
 
 	return 0;
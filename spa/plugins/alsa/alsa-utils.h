@@ -32,6 +32,7 @@ extern "C" {
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/utils/list.h>
+#include <spa/utils/dll.h>
 
 #include <spa/clock/clock.h>
 #include <spa/node/node.h>
@@ -46,6 +47,7 @@ struct props {
 	char card_name[128];
 	uint32_t min_latency;
 	uint32_t max_latency;
+	uint32_t quantum;	/* frames per cycle, 0 to use min_latency */
 };
 
 #define MAX_BUFFERS 32
@@ -67,6 +69,7 @@ struct type {
 	uint32_t prop_card_name;
 	uint32_t prop_min_latency;
 	uint32_t prop_max_latency;
+	uint32_t prop_quantum;
 	struct spa_type_io io;
 	struct spa_type_param param;
 	struct spa_type_meta meta;
@@ -93,6 +96,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_card_name = spa_type_map_get_id(map, SPA_TYPE_PROPS__cardName);
 	type->prop_min_latency = spa_type_map_get_id(map, SPA_TYPE_PROPS__minLatency);
 	type->prop_max_latency = spa_type_map_get_id(map, SPA_TYPE_PROPS__maxLatency);
+	type->prop_quantum = spa_type_map_get_id(map, SPA_TYPE_PROPS__quantum);
 
 	spa_type_io_map(map, &type->io);
 	spa_type_param_map(map, &type->param);
@@ -141,7 +145,9 @@ struct state {
 	snd_pcm_format_t format;
 	int rate;
 	int channels;
-	size_t frame_size;
+	bool planar;
+	uint32_t blocks;	/* data blocks per buffer, 1 or channels when planar */
+	size_t frame_size;	/* bytes per frame in one block */
 
 	struct spa_port_info info;
 	struct spa_io_buffers *io;
@@ -155,6 +161,11 @@ struct state {
 
 	size_t ready_offset;
 
+	bool zero_copy;		/* capture directly into the mmap area */
+	struct buffer *mmap_buffer;	/* zero-copy buffer with the uncommitted area */
+	snd_pcm_uframes_t mmap_offset;
+	snd_pcm_uframes_t mmap_frames;
+
 	bool started;
 	struct spa_source source;
 	int timerfd;
@@ -167,6 +178,11 @@ struct state {
 	int64_t last_ticks;
 	int64_t last_monotonic;
 
+	struct spa_dll dll;
+	double rate_corr;	/* rate of the device relative to the monotonic clock */
+	uint64_t next_time;	/* the time of the next wakeup */
+	uint64_t dll_start;	/* the time the dll was reset */
+
 	uint64_t underrun;
 };
 
@@ -179,8 +195,11 @@ spa_alsa_enum_format(struct state *state,
 
 int spa_alsa_set_format(struct state *state, struct spa_audio_info *info, uint32_t flags);
 
+int spa_alsa_update_quantum(struct state *state);
+
 int spa_alsa_start(struct state *state, bool xrun_recover);
 int spa_alsa_pause(struct state *state, bool xrun_recover);
+void spa_alsa_release_buffer(struct state *state, struct buffer *b);
 int spa_alsa_close(struct state *state);
 
 #ifdef __cplusplus
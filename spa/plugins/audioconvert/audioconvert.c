@@ -0,0 +1,1091 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <spa/support/log.h>
+#include <spa/support/type-map.h>
+#include <spa/utils/list.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/buffers.h>
+#include <spa/param/meta.h>
+#include <spa/param/io.h>
+#include <spa/pod/filter.h>
+
+#include "fmt-ops.h"
+#include "channelmix-ops.h"
+
+/* converts the raw audio of the input port to the format, layout and
+ * channels of the output port. The node is not inserted in links
+ * automatically, ports with different formats still fail to negotiate
+ * unless they are linked through this node explicitly. */
+#define NAME "audioconvert"
+
+#define MAX_BUFFERS	32
+#define MAX_CHANNELS	CHANNELMIX_MAX_CHANNELS
+#define BLOCK_SIZE	256
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_list link;
+};
+
+struct port {
+	bool have_format;
+	struct spa_audio_info format;
+
+	uint32_t conv;		/* one of CONV_* */
+	uint32_t order;		/* CONV_NATIVE or CONV_SWAP */
+	uint32_t stride;	/* bytes between frames in one data plane */
+	uint32_t n_planes;	/* number of data planes */
+	bool is_f32d;		/* native float planes, no conversion needed */
+
+	struct spa_port_info info;
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_io_buffers *io;
+	struct spa_io_control_range *range;
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	struct spa_type_io io;
+	struct spa_type_param param;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_buffers param_buffers;
+	struct spa_type_param_meta param_meta;
+	struct spa_type_param_io param_io;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_io_map(map, &type->io);
+	spa_type_param_map(map, &type->param);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_buffers_map(map, &type->param_buffers);
+	spa_type_param_meta_map(map, &type->param_meta);
+	spa_type_param_io_map(map, &type->param_io);
+}
+
+struct format_info {
+	off_t format_offset;
+	uint32_t conv;
+	uint32_t order;
+};
+
+#define _FORMAT(fmt,conv)	{ offsetof(struct type, audio_format. fmt), conv, CONV_NATIVE }
+#define _FORMAT_OE(fmt,conv)	{ offsetof(struct type, audio_format. fmt ## _OE), conv, CONV_SWAP }
+
+/* the first format is the default */
+static const struct format_info format_info[] = {
+	_FORMAT(S16, CONV_S16),
+	_FORMAT(F32, CONV_F32),
+	_FORMAT(S32, CONV_S32),
+	_FORMAT(S24_32, CONV_S24_32),
+	_FORMAT(S24, CONV_S24),
+	_FORMAT(U8, CONV_U8),
+	_FORMAT(S8, CONV_S8),
+	_FORMAT(U16, CONV_U16),
+	_FORMAT(U24_32, CONV_U24_32),
+	_FORMAT(U24, CONV_U24),
+	_FORMAT(U32, CONV_U32),
+	_FORMAT(F64, CONV_F64),
+	_FORMAT_OE(S16, CONV_S16),
+	_FORMAT_OE(F32, CONV_F32),
+	_FORMAT_OE(S32, CONV_S32),
+	_FORMAT_OE(S24_32, CONV_S24_32),
+	_FORMAT_OE(S24, CONV_S24),
+	_FORMAT_OE(U16, CONV_U16),
+	_FORMAT_OE(U24_32, CONV_U24_32),
+	_FORMAT_OE(U24, CONV_U24),
+	_FORMAT_OE(U32, CONV_U32),
+	_FORMAT_OE(F64, CONV_F64),
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct spa_audioconvert_ops ops;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	struct port in_ports[1];
+	struct port out_ports[1];
+
+	bool passthrough;
+	convert_to_f32d_func_t to_f32d;
+	convert_from_f32d_func_t from_f32d;
+	struct channelmix mix;
+
+	float tmp[2][MAX_CHANNELS * BLOCK_SIZE] SPA_ALIGNED(16);
+
+	bool started;
+};
+
+#define CHECK_IN_PORT(this,d,p)  ((d) == SPA_DIRECTION_INPUT && (p) == 0)
+#define CHECK_OUT_PORT(this,d,p) ((d) == SPA_DIRECTION_OUTPUT && (p) == 0)
+#define CHECK_PORT(this,d,p)     ((p) == 0)
+#define GET_IN_PORT(this,p)	 (&this->in_ports[p])
+#define GET_OUT_PORT(this,p)	 (&this->out_ports[p])
+#define GET_PORT(this,d,p)	 (d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+#define OTHER_DIRECTION(d)	 (d == SPA_DIRECTION_INPUT ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT)
+
+static const struct format_info *find_format_info(struct impl *this, uint32_t format)
+{
+	int i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(format_info); i++) {
+		if (*SPA_MEMBER(&this->type, format_info[i].format_offset, uint32_t) == format)
+			return &format_info[i];
+	}
+	return NULL;
+}
+
+static int setup_convert(struct impl *this)
+{
+	struct port *in_port = GET_IN_PORT(this, 0);
+	struct port *out_port = GET_OUT_PORT(this, 0);
+	struct spa_audio_info_raw *in = &in_port->format.info.raw;
+	struct spa_audio_info_raw *out = &out_port->format.info.raw;
+	int res;
+
+	if (!in_port->have_format || !out_port->have_format)
+		return 0;
+
+	if ((res = channelmix_init(&this->mix, in->channels, in->channel_mask,
+				   out->channels, out->channel_mask)) < 0)
+		return res;
+
+	this->to_f32d = this->ops.to_f32d[in_port->conv][in_port->order];
+	this->from_f32d = this->ops.from_f32d[out_port->conv][out_port->order];
+	this->passthrough = in->format == out->format &&
+			    in->layout == out->layout &&
+			    this->mix.identity;
+
+	spa_log_info(this->log, NAME " %p: %d/%d/%d -> %d/%d/%d passthrough:%d identity:%d", this,
+		     in->format, in->channels, in->layout,
+		     out->format, out->channels, out->layout,
+		     this->passthrough, this->mix.identity);
+
+	return 0;
+}
+
+static int impl_node_enum_params(struct spa_node *node,
+				 uint32_t id, uint32_t *index,
+				 const struct spa_pod *filter,
+				 struct spa_pod **result,
+				 struct spa_pod_builder *builder)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start) {
+		this->started = true;
+	} else if (SPA_COMMAND_TYPE(command) == this->type.command_node.Pause) {
+		this->started = false;
+	} else
+		return -ENOTSUP;
+
+	return 0;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return 0;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return 0;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t *input_ids,
+		       uint32_t n_input_ids,
+		       uint32_t *output_ids,
+		       uint32_t n_output_ids)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ids > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ids > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return 0;
+}
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+	*info = &port->info;
+
+	return 0;
+}
+
+static int port_enum_formats(struct spa_node *node,
+			     enum spa_direction direction, uint32_t port_id,
+			     uint32_t *index,
+			     struct spa_pod **param,
+			     struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct type *t = &this->type;
+	struct port *other;
+	int i;
+
+	other = GET_PORT(this, OTHER_DIRECTION(direction), 0);
+
+	switch (*index) {
+	case 0:
+		spa_pod_builder_push_object(builder, t->param.idEnumFormat, t->format);
+		spa_pod_builder_add(builder,
+				"I", t->media_type.audio,
+				"I", t->media_subtype.raw, 0);
+
+		spa_pod_builder_push_prop(builder, t->format_audio.format,
+			SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+		for (i = 0; i < SPA_N_ELEMENTS(format_info); i++) {
+			uint32_t f = *SPA_MEMBER(t, format_info[i].format_offset, uint32_t);
+			if (i == 0)
+				spa_pod_builder_id(builder, f);
+			spa_pod_builder_id(builder, f);
+		}
+		spa_pod_builder_pop(builder);
+
+		/* we don't resample, the rate must match the other port */
+		if (other->have_format) {
+			spa_pod_builder_add(builder,
+				":", t->format_audio.rate, "i", other->format.info.raw.rate, 0);
+		} else {
+			spa_pod_builder_add(builder,
+				":", t->format_audio.rate, "iru", 44100,
+					SPA_POD_PROP_MIN_MAX(1, INT32_MAX), 0);
+		}
+		spa_pod_builder_add(builder,
+			":", t->format_audio.channels, "iru",
+				other->have_format ? other->format.info.raw.channels : 2,
+				SPA_POD_PROP_MIN_MAX(1, MAX_CHANNELS), 0);
+
+		*param = spa_pod_builder_pop(builder);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+static int port_get_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t *index,
+			   struct spa_pod **param,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port = GET_PORT(this, direction, port_id);
+	struct type *t = &this->type;
+
+	if (!port->have_format)
+		return -EIO;
+	if (*index > 0)
+		return 0;
+
+	*param = spa_pod_builder_object(builder,
+			t->param.idFormat, t->format,
+			"I", t->media_type.audio,
+			"I", t->media_subtype.raw,
+			":", t->format_audio.format,   "I", port->format.info.raw.format,
+			":", t->format_audio.layout,   "i", port->format.info.raw.layout,
+			":", t->format_audio.rate,     "i", port->format.info.raw.rate,
+			":", t->format_audio.channels, "i", port->format.info.raw.channels);
+
+	return 1;
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t id, uint32_t *index,
+			   const struct spa_pod *filter,
+			   struct spa_pod **result,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this;
+	struct type *t;
+	struct port *port;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[2048];
+	struct spa_pod *param;
+	int res;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+	spa_return_val_if_fail(builder != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	if (id == t->param.idList) {
+		uint32_t list[] = { t->param.idEnumFormat,
+				    t->param.idFormat,
+				    t->param.idBuffers,
+				    t->param.idMeta,
+				    t->param_io.idBuffers,
+				    t->param_io.idControl };
+
+		if (*index < SPA_N_ELEMENTS(list))
+			param = spa_pod_builder_object(&b, id, t->param.List,
+				":", t->param.listId, "I", list[*index]);
+		else
+			return 0;
+	}
+	else if (id == t->param.idEnumFormat) {
+		if ((res = port_enum_formats(node, direction, port_id, index, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idFormat) {
+		if ((res = port_get_format(node, direction, port_id, index, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idBuffers) {
+		if (!port->have_format)
+			return -EIO;
+		if (*index > 0)
+			return 0;
+
+		param = spa_pod_builder_object(&b,
+			id, t->param_buffers.Buffers,
+			":", t->param_buffers.size,    "iru", 1024 * port->stride,
+				SPA_POD_PROP_MIN_MAX(16 * port->stride, INT32_MAX / port->stride),
+			":", t->param_buffers.stride,  "i", port->stride,
+			":", t->param_buffers.buffers, "iru", 2,
+				SPA_POD_PROP_MIN_MAX(1, MAX_BUFFERS),
+			":", t->param_buffers.align,   "i", 16);
+	}
+	else if (id == t->param.idMeta) {
+		if (!port->have_format)
+			return -EIO;
+
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_meta.Meta,
+				":", t->param_meta.type, "I", t->meta.Header,
+				":", t->param_meta.size, "i", sizeof(struct spa_meta_header));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idBuffers) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Buffers,
+				":", t->param_io.id, "I", t->io.Buffers,
+				":", t->param_io.size, "i", sizeof(struct spa_io_buffers));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idControl) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Control,
+				":", t->param_io.id, "I", t->io.ControlRange,
+				":", t->param_io.size, "i", sizeof(struct spa_io_control_range));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else
+		return -ENOENT;
+
+	(*index)++;
+
+	if (spa_pod_filter(builder, result, param, filter) < 0)
+		goto next;
+
+	return 1;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers %p", this, port);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return 0;
+}
+
+static int port_set_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t flags,
+			   const struct spa_pod *format)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port, *other;
+	struct type *t = &this->type;
+
+	port = GET_PORT(this, direction, port_id);
+	other = GET_PORT(this, OTHER_DIRECTION(direction), 0);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+	} else {
+		struct spa_audio_info info = { 0 };
+		const struct format_info *fi;
+		uint32_t size;
+
+		spa_pod_object_parse(format,
+			"I", &info.media_type,
+			"I", &info.media_subtype);
+
+		if (info.media_type != t->media_type.audio ||
+		    info.media_subtype != t->media_subtype.raw)
+			return -EINVAL;
+
+		if (spa_format_audio_raw_parse(format, &info.info.raw, &t->format_audio) < 0)
+			return -EINVAL;
+
+		if ((fi = find_format_info(this, info.info.raw.format)) == NULL)
+			return -EINVAL;
+
+		if (info.info.raw.channels == 0 || info.info.raw.channels > MAX_CHANNELS)
+			return -EINVAL;
+
+		if (other->have_format && info.info.raw.rate != other->format.info.raw.rate)
+			return -EINVAL;
+
+		size = spa_audioconvert_sample_size[fi->conv];
+
+		port->conv = fi->conv;
+		port->order = fi->order;
+		if (info.info.raw.layout == SPA_AUDIO_LAYOUT_INTERLEAVED) {
+			port->stride = size * info.info.raw.channels;
+			port->n_planes = 1;
+		} else {
+			port->stride = size;
+			port->n_planes = info.info.raw.channels;
+		}
+		port->is_f32d = fi->conv == CONV_F32 && fi->order == CONV_NATIVE &&
+				port->n_planes == info.info.raw.channels;
+		port->format = info;
+		port->have_format = true;
+
+		spa_log_info(this->log, NAME " %p: set format on port %d:%d", this,
+			     direction, port_id);
+
+		return setup_convert(this);
+	}
+
+	return 0;
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction, uint32_t port_id,
+			 uint32_t id, uint32_t flags,
+			 const struct spa_pod *param)
+{
+	struct impl *this;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	if (id == t->param.idFormat) {
+		return port_set_format(node, direction, port_id, flags, param);
+	}
+	else
+		return -ENOENT;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	struct type *t;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], t->meta.Header);
+
+		/* non-interleaved audio has one data block per channel */
+		if (buffers[i]->n_datas < port->n_planes) {
+			spa_log_error(this->log, NAME " %p: need %d datas on buffer %p", this,
+				      port->n_planes, buffers[i]);
+			return -EINVAL;
+		}
+		for (j = 0; j < port->n_planes; j++) {
+			if (!((d[j].type == t->data.MemPtr ||
+			       d[j].type == t->data.MemFd ||
+			       d[j].type == t->data.DmaBuf) && d[j].data != NULL)) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+					      buffers[i]);
+				return -EINVAL;
+			}
+		}
+		if (!b->outstanding)
+			spa_list_append(&port->empty, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return 0;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_pod **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      uint32_t id,
+		      void *data, size_t size)
+{
+	struct impl *this;
+	struct port *port;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (id == t->io.Buffers)
+		port->io = data;
+	else if (id == t->io.ControlRange)
+		port->range = data;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_append(&port->empty, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id), -EINVAL);
+
+	port = GET_OUT_PORT(this, port_id);
+
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	recycle_buffer(this, buffer_id);
+
+	return 0;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return -ENOTSUP;
+}
+
+static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b->outbuf;
+}
+
+static void convert(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	struct port *in_port = GET_IN_PORT(this, 0);
+	struct port *out_port = GET_OUT_PORT(this, 0);
+	uint32_t in_channels = in_port->format.info.raw.channels;
+	uint32_t out_channels = out_port->format.info.raw.channels;
+	uint32_t in_size = in_port->stride / (in_port->n_planes == 1 ? in_channels : 1);
+	uint32_t out_size = out_port->stride / (out_port->n_planes == 1 ? out_channels : 1);
+	struct spa_data *sd = sbuf->datas, *dd = dbuf->datas;
+	const uint8_t *src[MAX_CHANNELS];
+	uint8_t *dst[MAX_CHANNELS];
+	float *in_f32[MAX_CHANNELS], *out_f32[MAX_CHANNELS];
+	const float *p1[MAX_CHANNELS];
+	float *p2[MAX_CHANNELS];
+	uint32_t i, n_frames, done, len;
+
+	n_frames = UINT32_MAX;
+	for (i = 0; i < in_port->n_planes; i++) {
+		uint32_t offset = sd[i].chunk->offset % sd[i].maxsize;
+		uint32_t size = SPA_MIN(sd[i].chunk->size, sd[i].maxsize - offset);
+
+		src[i] = SPA_MEMBER(sd[i].data, offset, uint8_t);
+		n_frames = SPA_MIN(n_frames, size / in_port->stride);
+	}
+	for (i = 0; i < out_port->n_planes; i++) {
+		dst[i] = dd[i].data;
+		n_frames = SPA_MIN(n_frames, dd[i].maxsize / out_port->stride);
+	}
+
+	spa_log_trace(this->log, NAME " %p: convert %d frames", this, n_frames);
+
+	for (done = 0; done < n_frames; done += len) {
+		len = SPA_MIN(n_frames - done, BLOCK_SIZE);
+
+		if (this->passthrough) {
+			for (i = 0; i < in_port->n_planes; i++)
+				memcpy(dst[i] + done * out_port->stride,
+				       src[i] + done * in_port->stride,
+				       len * in_port->stride);
+			continue;
+		}
+
+		/* convert the input to float planes, unless it already is */
+		for (i = 0; i < in_channels; i++) {
+			in_f32[i] = in_port->is_f32d ?
+				(float *) (src[i] + done * sizeof(float)) :
+				&this->tmp[0][i * BLOCK_SIZE];
+			p1[i] = in_f32[i];
+		}
+		if (!in_port->is_f32d) {
+			if (in_port->n_planes == 1)
+				this->to_f32d(in_f32, src[0] + done * in_port->stride,
+					      in_channels, len);
+			else
+				for (i = 0; i < in_channels; i++)
+					this->to_f32d(&in_f32[i], src[i] + done * in_size, 1, len);
+		}
+
+		/* remix the channels, directly into the output when possible */
+		for (i = 0; i < out_channels; i++) {
+			out_f32[i] = out_port->is_f32d ?
+				(float *) (dst[i] + done * sizeof(float)) :
+				&this->tmp[1][i * BLOCK_SIZE];
+			p2[i] = this->mix.identity ? (float *) p1[i] : out_f32[i];
+		}
+		if (!this->mix.identity)
+			channelmix_process(&this->mix, p2, p1, len);
+
+		/* and convert to the output format */
+		if (out_port->is_f32d) {
+			for (i = 0; i < out_channels; i++)
+				if (p2[i] != out_f32[i])
+					memcpy(out_f32[i], p2[i], len * sizeof(float));
+		}
+		else if (out_port->n_planes == 1) {
+			this->from_f32d(dst[0] + done * out_port->stride,
+					(const float **) p2, out_channels, len);
+		}
+		else {
+			for (i = 0; i < out_channels; i++)
+				this->from_f32d(dst[i] + done * out_size,
+						(const float **) &p2[i], 1, len);
+		}
+	}
+
+	for (i = 0; i < out_port->n_planes; i++) {
+		dd[i].chunk->offset = 0;
+		dd[i].chunk->size = n_frames * out_port->stride;
+		dd[i].chunk->stride = out_port->stride;
+	}
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_io_buffers *input, *output;
+	struct port *in_port, *out_port;
+	struct spa_buffer *dbuf, *sbuf;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	if (input->buffer_id >= in_port->n_buffers) {
+		input->status = -EINVAL;
+		return -EINVAL;
+	}
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL) {
+		spa_log_error(this->log, NAME " %p: out of buffers", this);
+		return -EPIPE;
+	}
+
+	sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+	input->status = SPA_STATUS_OK;
+
+	spa_log_trace(this->log, NAME " %p: convert %d -> %d", this, sbuf->id, dbuf->id);
+	convert(this, dbuf, sbuf);
+
+	output->buffer_id = dbuf->id;
+	output->status = SPA_STATUS_HAVE_BUFFER;
+
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_io_buffers *input, *output;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	if (in_port->range && out_port->range)
+		*in_port->range = *out_port->range;
+	input->status = SPA_STATUS_NEED_BUFFER;
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	impl_node_enum_params,
+	impl_node_set_param,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	return 0;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i, cpu_flags;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return -EINVAL;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
+
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].empty);
+
+	cpu_flags = spa_audioconvert_get_cpu_flags();
+	spa_audioconvert_get_ops_for_cpu(&this->ops, cpu_flags);
+	spa_log_info(this->log, NAME " %p: using cpu flags %08x", this, cpu_flags);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+const struct spa_handle_factory spa_audioconvert_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
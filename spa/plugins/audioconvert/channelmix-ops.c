@@ -0,0 +1,126 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <errno.h>
+
+#include "channelmix-ops.h"
+
+/* index of the n-th set bit in mask or -1 */
+static int mask_to_position(uint32_t mask, uint32_t n)
+{
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		if ((mask & (1u << i)) && n-- == 0)
+			return i;
+	}
+	return -1;
+}
+
+int channelmix_init(struct channelmix *mix,
+		    uint32_t n_src, uint32_t src_mask,
+		    uint32_t n_dst, uint32_t dst_mask)
+{
+	uint32_t i, j;
+
+	if (n_src == 0 || n_src > CHANNELMIX_MAX_CHANNELS ||
+	    n_dst == 0 || n_dst > CHANNELMIX_MAX_CHANNELS)
+		return -EINVAL;
+
+	mix->n_src = n_src;
+	mix->n_dst = n_dst;
+	memset(mix->matrix, 0, sizeof(mix->matrix));
+
+	if (src_mask != 0 && dst_mask != 0 && src_mask != dst_mask) {
+		for (i = 0; i < n_dst; i++) {
+			int pos = mask_to_position(dst_mask, i);
+
+			for (j = 0; j < n_src; j++) {
+				if (pos >= 0 && pos == mask_to_position(src_mask, j))
+					mix->matrix[i][j] = 1.0f;
+			}
+			if (n_src == 1)
+				mix->matrix[i][0] = 1.0f;
+		}
+	}
+	else if (n_src == 1) {
+		for (i = 0; i < n_dst; i++)
+			mix->matrix[i][0] = 1.0f;
+	}
+	else if (n_dst == 1) {
+		for (j = 0; j < n_src; j++)
+			mix->matrix[0][j] = 1.0f / n_src;
+	}
+	else {
+		for (i = 0; i < SPA_MIN(n_src, n_dst); i++)
+			mix->matrix[i][i] = 1.0f;
+	}
+
+	mix->identity = n_src == n_dst;
+	for (i = 0; i < n_dst && mix->identity; i++) {
+		for (j = 0; j < n_src; j++) {
+			if (mix->matrix[i][j] != (i == j ? 1.0f : 0.0f)) {
+				mix->identity = false;
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+void channelmix_process(struct channelmix *mix, float **dst, const float **src,
+			uint32_t n_samples)
+{
+	uint32_t i, j, n, n_gains, first;
+	float *d;
+
+	for (i = 0; i < mix->n_dst; i++) {
+		d = dst[i];
+
+		for (n_gains = 0, first = 0, j = 0; j < mix->n_src; j++) {
+			if (mix->matrix[i][j] != 0.0f && n_gains++ == 0)
+				first = j;
+		}
+
+		if (n_gains == 0) {
+			memset(d, 0, n_samples * sizeof(float));
+		}
+		else if (n_gains == 1 && mix->matrix[i][first] == 1.0f) {
+			if (d != src[first])
+				memcpy(d, src[first], n_samples * sizeof(float));
+		}
+		else {
+			float v = mix->matrix[i][first];
+			const float *s = src[first];
+
+			for (n = 0; n < n_samples; n++)
+				d[n] = s[n] * v;
+
+			for (j = first + 1; j < mix->n_src; j++) {
+				v = mix->matrix[i][j];
+				s = src[j];
+				if (v == 0.0f)
+					continue;
+				for (n = 0; n < n_samples; n++)
+					d[n] += s[n] * v;
+			}
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+
+#define CHANNELMIX_MAX_CHANNELS	64
+
+/* remix planar float samples from n_src to n_dst channels with a matrix
+ * of gains */
+struct channelmix {
+	uint32_t n_src;
+	uint32_t n_dst;
+	bool identity;
+	float matrix[CHANNELMIX_MAX_CHANNELS][CHANNELMIX_MAX_CHANNELS];
+};
+
+/** make a default matrix for the given channels. When both channel masks
+ * are set, channels are matched on position. Mono is copied to all
+ * outputs, all inputs are averaged for mono output, otherwise channels
+ * are copied in order and extra outputs are silent */
+int channelmix_init(struct channelmix *mix,
+		    uint32_t n_src, uint32_t src_mask,
+		    uint32_t n_dst, uint32_t dst_mask);
+
+void channelmix_process(struct channelmix *mix, float **dst, const float **src,
+			uint32_t n_samples);
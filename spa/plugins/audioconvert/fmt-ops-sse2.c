@@ -0,0 +1,177 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+
+#include "fmt-ops.h"
+
+#include <emmintrin.h>
+
+#define S16_SCALE	32768.0f
+#define S16_MIN		-32768.0f
+#define S16_MAX		32767.0f
+
+static inline int16_t f32_to_s16(float v)
+{
+	v *= S16_SCALE;
+	if (v <= S16_MIN)
+		return S16_MIN;
+	if (v >= S16_MAX)
+		return S16_MAX;
+	return lrintf(v);
+}
+
+static inline __m128i f32_to_s16_sse2(__m128 lo, __m128 hi)
+{
+	const __m128 scale = _mm_set1_ps(S16_SCALE);
+	const __m128 min = _mm_set1_ps(S16_MIN);
+	const __m128 max = _mm_set1_ps(S16_MAX);
+
+	lo = _mm_max_ps(_mm_min_ps(_mm_mul_ps(lo, scale), max), min);
+	hi = _mm_max_ps(_mm_min_ps(_mm_mul_ps(hi, scale), max), min);
+	return _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+}
+
+static void
+conv_s16_to_f32d_sse2(float **dst, const void *src, uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	const __m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+	uint32_t n = 0, i, unrolled;
+
+	if (n_channels == 1) {
+		float *d = dst[0];
+
+		unrolled = n_samples & ~7;
+		for (; n < unrolled; n += 8) {
+			__m128i in = _mm_loadu_si128((const __m128i *)&s[n]);
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+			_mm_storeu_ps(&d[n + 0], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(&d[n + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	} else if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		unrolled = n_samples & ~3;
+		for (; n < unrolled; n += 4) {
+			__m128i in = _mm_loadu_si128((const __m128i *)&s[n * 2]);
+			__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+			__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+
+			/* lo is L0 R0 L1 R1, hi is L2 R2 L3 R3 */
+			_mm_storeu_ps(&l[n], _mm_mul_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), scale));
+			_mm_storeu_ps(&r[n], _mm_mul_ps(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)), scale));
+		}
+	}
+	for (s += n * n_channels; n < n_samples; n++)
+		for (i = 0; i < n_channels; i++)
+			dst[i][n] = *s++ * (1.0f / S16_SCALE);
+}
+
+static void
+conv_f32d_to_s16_sse2(void *dst, const float **src, uint32_t n_channels, uint32_t n_samples)
+{
+	int16_t *d = dst;
+	uint32_t n = 0, i, unrolled;
+
+	if (n_channels == 1) {
+		const float *s = src[0];
+
+		unrolled = n_samples & ~7;
+		for (; n < unrolled; n += 8) {
+			__m128i out = f32_to_s16_sse2(_mm_loadu_ps(&s[n + 0]),
+						      _mm_loadu_ps(&s[n + 4]));
+			_mm_storeu_si128((__m128i *)&d[n], out);
+		}
+	} else if (n_channels == 2) {
+		const float *l = src[0], *r = src[1];
+
+		unrolled = n_samples & ~3;
+		for (; n < unrolled; n += 4) {
+			__m128 in_l = _mm_loadu_ps(&l[n]);
+			__m128 in_r = _mm_loadu_ps(&r[n]);
+			__m128i out = f32_to_s16_sse2(_mm_unpacklo_ps(in_l, in_r),
+						      _mm_unpackhi_ps(in_l, in_r));
+			_mm_storeu_si128((__m128i *)&d[n * 2], out);
+		}
+	}
+	for (d += n * n_channels; n < n_samples; n++)
+		for (i = 0; i < n_channels; i++)
+			*d++ = f32_to_s16(src[i][n]);
+}
+
+static void
+conv_f32_to_f32d_sse2(float **dst, const void *src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	uint32_t n = 0, i, unrolled;
+
+	if (n_channels == 1) {
+		memcpy(dst[0], s, n_samples * sizeof(float));
+		return;
+	} else if (n_channels == 2) {
+		float *l = dst[0], *r = dst[1];
+
+		unrolled = n_samples & ~3;
+		for (; n < unrolled; n += 4) {
+			__m128 lo = _mm_loadu_ps(&s[n * 2 + 0]);
+			__m128 hi = _mm_loadu_ps(&s[n * 2 + 4]);
+			_mm_storeu_ps(&l[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&r[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	for (s += n * n_channels; n < n_samples; n++)
+		for (i = 0; i < n_channels; i++)
+			dst[i][n] = *s++;
+}
+
+static void
+conv_f32d_to_f32_sse2(void *dst, const float **src, uint32_t n_channels, uint32_t n_samples)
+{
+	float *d = dst;
+	uint32_t n = 0, i, unrolled;
+
+	if (n_channels == 1) {
+		memcpy(d, src[0], n_samples * sizeof(float));
+		return;
+	} else if (n_channels == 2) {
+		const float *l = src[0], *r = src[1];
+
+		unrolled = n_samples & ~3;
+		for (; n < unrolled; n += 4) {
+			__m128 in_l = _mm_loadu_ps(&l[n]);
+			__m128 in_r = _mm_loadu_ps(&r[n]);
+			_mm_storeu_ps(&d[n * 2 + 0], _mm_unpacklo_ps(in_l, in_r));
+			_mm_storeu_ps(&d[n * 2 + 4], _mm_unpackhi_ps(in_l, in_r));
+		}
+	}
+	for (d += n * n_channels; n < n_samples; n++)
+		for (i = 0; i < n_channels; i++)
+			*d++ = src[i][n];
+}
+
+void spa_audioconvert_get_ops_sse2(struct spa_audioconvert_ops *ops)
+{
+	ops->to_f32d[CONV_S16][CONV_NATIVE] = conv_s16_to_f32d_sse2;
+	ops->from_f32d[CONV_S16][CONV_NATIVE] = conv_f32d_to_s16_sse2;
+	ops->to_f32d[CONV_F32][CONV_NATIVE] = conv_f32_to_f32d_sse2;
+	ops->from_f32d[CONV_F32][CONV_NATIVE] = conv_f32d_to_f32_sse2;
+}
@@ -0,0 +1,298 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+#include <byteswap.h>
+
+#include "fmt-ops.h"
+
+const uint32_t spa_audioconvert_sample_size[CONV_MAX] = {
+	[CONV_U8] = 1,
+	[CONV_S8] = 1,
+	[CONV_U16] = 2,
+	[CONV_S16] = 2,
+	[CONV_U24] = 3,
+	[CONV_S24] = 3,
+	[CONV_U24_32] = 4,
+	[CONV_S24_32] = 4,
+	[CONV_U32] = 4,
+	[CONV_S32] = 4,
+	[CONV_F32] = 4,
+	[CONV_F64] = 8,
+};
+
+/* raw access to the sample bits in native and swapped byte order */
+static inline uint32_t rd8(const uint8_t *s) { return s[0]; }
+static inline void wr8(uint8_t *d, uint32_t v) { d[0] = v; }
+static inline uint32_t rd16(const uint8_t *s) { return *(const uint16_t *) s; }
+static inline void wr16(uint8_t *d, uint32_t v) { *(uint16_t *) d = v; }
+static inline uint32_t rd16s(const uint8_t *s) { return bswap_16(*(const uint16_t *) s); }
+static inline void wr16s(uint8_t *d, uint32_t v) { *(uint16_t *) d = bswap_16(v); }
+static inline uint32_t rd32(const uint8_t *s) { return *(const uint32_t *) s; }
+static inline void wr32(uint8_t *d, uint32_t v) { *(uint32_t *) d = v; }
+static inline uint32_t rd32s(const uint8_t *s) { return bswap_32(*(const uint32_t *) s); }
+static inline void wr32s(uint8_t *d, uint32_t v) { *(uint32_t *) d = bswap_32(v); }
+
+static inline uint32_t rd24le(const uint8_t *s) { return s[0] | (s[1] << 8) | (s[2] << 16); }
+static inline void wr24le(uint8_t *d, uint32_t v) { d[0] = v; d[1] = v >> 8; d[2] = v >> 16; }
+static inline uint32_t rd24be(const uint8_t *s) { return (s[0] << 16) | (s[1] << 8) | s[2]; }
+static inline void wr24be(uint8_t *d, uint32_t v) { d[0] = v >> 16; d[1] = v >> 8; d[2] = v; }
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+#define rd24	rd24be
+#define wr24	wr24be
+#define rd24s	rd24le
+#define wr24s	wr24le
+#else
+#define rd24	rd24le
+#define wr24	wr24le
+#define rd24s	rd24be
+#define wr24s	wr24be
+#endif
+
+/* sign extend the lower bits of a sample */
+#define SEXT(v,bits)	(((int32_t)((uint32_t)(v) << (32 - (bits)))) >> (32 - (bits)))
+#define SIGN_BIT(bits)	(1u << ((bits) - 1))
+
+static inline int32_t float_to_int(float v, float scale, int32_t min, int32_t max)
+{
+	v *= scale;
+	if (v <= (float) min)
+		return min;
+	if (v >= (float) max)
+		return max;
+	return lrintf(v);
+}
+
+/* integer formats are converted to signed by flipping the sign bit of the
+ * unsigned formats and scaled to [-1.0, 1.0) */
+#define MAKE_INT_CONVERT(name,size,bits,uns,rd,wr)					\
+static void										\
+conv_##name##_to_f32d(float **dst, const void *src,					\
+		      uint32_t n_channels, uint32_t n_samples)				\
+{											\
+	const uint8_t *s = src;								\
+	const float scale = 1.0f / SIGN_BIT(bits);					\
+	uint32_t i, j;									\
+											\
+	for (i = 0; i < n_samples; i++) {						\
+		for (j = 0; j < n_channels; j++) {					\
+			dst[j][i] = SEXT(rd(s) ^ (uns ? SIGN_BIT(bits) : 0), bits) * scale;	\
+			s += size;							\
+		}									\
+	}										\
+}											\
+static void										\
+conv_f32d_to_##name(void *dst, const float **src,					\
+		    uint32_t n_channels, uint32_t n_samples)				\
+{											\
+	uint8_t *d = dst;								\
+	const float scale = SIGN_BIT(bits);						\
+	const int32_t min = -(int64_t) SIGN_BIT(bits);					\
+	const int32_t max = SIGN_BIT(bits) - 1;						\
+	uint32_t i, j;									\
+											\
+	for (i = 0; i < n_samples; i++) {						\
+		for (j = 0; j < n_channels; j++) {					\
+			uint32_t v = float_to_int(src[j][i], scale, min, max);		\
+			wr(d, uns ? (v ^ SIGN_BIT(bits)) & (~0u >> (32 - (bits))) : v);	\
+			d += size;							\
+		}									\
+	}										\
+}
+
+MAKE_INT_CONVERT(u8, 1, 8, true, rd8, wr8)
+MAKE_INT_CONVERT(s8, 1, 8, false, rd8, wr8)
+MAKE_INT_CONVERT(u16, 2, 16, true, rd16, wr16)
+MAKE_INT_CONVERT(u16s, 2, 16, true, rd16s, wr16s)
+MAKE_INT_CONVERT(s16, 2, 16, false, rd16, wr16)
+MAKE_INT_CONVERT(s16s, 2, 16, false, rd16s, wr16s)
+MAKE_INT_CONVERT(u24, 3, 24, true, rd24, wr24)
+MAKE_INT_CONVERT(u24s, 3, 24, true, rd24s, wr24s)
+MAKE_INT_CONVERT(s24, 3, 24, false, rd24, wr24)
+MAKE_INT_CONVERT(s24s, 3, 24, false, rd24s, wr24s)
+MAKE_INT_CONVERT(u24_32, 4, 24, true, rd32, wr32)
+MAKE_INT_CONVERT(u24_32s, 4, 24, true, rd32s, wr32s)
+MAKE_INT_CONVERT(s24_32, 4, 24, false, rd32, wr32)
+MAKE_INT_CONVERT(s24_32s, 4, 24, false, rd32s, wr32s)
+MAKE_INT_CONVERT(u32, 4, 32, true, rd32, wr32)
+MAKE_INT_CONVERT(u32s, 4, 32, true, rd32s, wr32s)
+MAKE_INT_CONVERT(s32, 4, 32, false, rd32, wr32)
+MAKE_INT_CONVERT(s32s, 4, 32, false, rd32s, wr32s)
+
+static void
+conv_f32_to_f32d(float **dst, const void *src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	uint32_t i, j;
+
+	if (n_channels == 1) {
+		memcpy(dst[0], s, n_samples * sizeof(float));
+		return;
+	}
+	for (i = 0; i < n_samples; i++)
+		for (j = 0; j < n_channels; j++)
+			dst[j][i] = *s++;
+}
+
+static void
+conv_f32d_to_f32(void *dst, const float **src, uint32_t n_channels, uint32_t n_samples)
+{
+	float *d = dst;
+	uint32_t i, j;
+
+	if (n_channels == 1) {
+		memcpy(d, src[0], n_samples * sizeof(float));
+		return;
+	}
+	for (i = 0; i < n_samples; i++)
+		for (j = 0; j < n_channels; j++)
+			*d++ = src[j][i];
+}
+
+static void
+conv_f32s_to_f32d(float **dst, const void *src, uint32_t n_channels, uint32_t n_samples)
+{
+	const uint32_t *s = src;
+	uint32_t i, j;
+	union { uint32_t i; float f; } v;
+
+	for (i = 0; i < n_samples; i++) {
+		for (j = 0; j < n_channels; j++) {
+			v.i = bswap_32(*s++);
+			dst[j][i] = v.f;
+		}
+	}
+}
+
+static void
+conv_f32d_to_f32s(void *dst, const float **src, uint32_t n_channels, uint32_t n_samples)
+{
+	uint32_t *d = dst;
+	uint32_t i, j;
+	union { uint32_t i; float f; } v;
+
+	for (i = 0; i < n_samples; i++) {
+		for (j = 0; j < n_channels; j++) {
+			v.f = src[j][i];
+			*d++ = bswap_32(v.i);
+		}
+	}
+}
+
+static void
+conv_f64_to_f32d(float **dst, const void *src, uint32_t n_channels, uint32_t n_samples)
+{
+	const double *s = src;
+	uint32_t i, j;
+
+	for (i = 0; i < n_samples; i++)
+		for (j = 0; j < n_channels; j++)
+			dst[j][i] = *s++;
+}
+
+static void
+conv_f32d_to_f64(void *dst, const float **src, uint32_t n_channels, uint32_t n_samples)
+{
+	double *d = dst;
+	uint32_t i, j;
+
+	for (i = 0; i < n_samples; i++)
+		for (j = 0; j < n_channels; j++)
+			*d++ = src[j][i];
+}
+
+static void
+conv_f64s_to_f32d(float **dst, const void *src, uint32_t n_channels, uint32_t n_samples)
+{
+	const uint64_t *s = src;
+	uint32_t i, j;
+	union { uint64_t i; double f; } v;
+
+	for (i = 0; i < n_samples; i++) {
+		for (j = 0; j < n_channels; j++) {
+			v.i = bswap_64(*s++);
+			dst[j][i] = v.f;
+		}
+	}
+}
+
+static void
+conv_f32d_to_f64s(void *dst, const float **src, uint32_t n_channels, uint32_t n_samples)
+{
+	uint64_t *d = dst;
+	uint32_t i, j;
+	union { uint64_t i; double f; } v;
+
+	for (i = 0; i < n_samples; i++) {
+		for (j = 0; j < n_channels; j++) {
+			v.f = src[j][i];
+			*d++ = bswap_64(v.i);
+		}
+	}
+}
+
+#define SET_CONVERT(ops,fmt,name)						\
+	ops->to_f32d[fmt][CONV_NATIVE] = conv_##name##_to_f32d;			\
+	ops->to_f32d[fmt][CONV_SWAP] = conv_##name##s_to_f32d;			\
+	ops->from_f32d[fmt][CONV_NATIVE] = conv_f32d_to_##name;			\
+	ops->from_f32d[fmt][CONV_SWAP] = conv_f32d_to_##name##s;
+
+static void get_ops_c(struct spa_audioconvert_ops *ops)
+{
+	/* byte order does not matter for 8 bit samples */
+	ops->to_f32d[CONV_U8][CONV_NATIVE] = ops->to_f32d[CONV_U8][CONV_SWAP] = conv_u8_to_f32d;
+	ops->from_f32d[CONV_U8][CONV_NATIVE] = ops->from_f32d[CONV_U8][CONV_SWAP] = conv_f32d_to_u8;
+	ops->to_f32d[CONV_S8][CONV_NATIVE] = ops->to_f32d[CONV_S8][CONV_SWAP] = conv_s8_to_f32d;
+	ops->from_f32d[CONV_S8][CONV_NATIVE] = ops->from_f32d[CONV_S8][CONV_SWAP] = conv_f32d_to_s8;
+	SET_CONVERT(ops, CONV_U16, u16);
+	SET_CONVERT(ops, CONV_S16, s16);
+	SET_CONVERT(ops, CONV_U24, u24);
+	SET_CONVERT(ops, CONV_S24, s24);
+	SET_CONVERT(ops, CONV_U24_32, u24_32);
+	SET_CONVERT(ops, CONV_S24_32, s24_32);
+	SET_CONVERT(ops, CONV_U32, u32);
+	SET_CONVERT(ops, CONV_S32, s32);
+	SET_CONVERT(ops, CONV_F32, f32);
+	SET_CONVERT(ops, CONV_F64, f64);
+}
+
+uint32_t spa_audioconvert_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+#if defined (HAVE_SSE2)
+	flags |= SPA_CPU_FLAG_SSE2;
+#endif
+	return spa_cpu_get_flags() & flags;
+}
+
+void spa_audioconvert_get_ops_for_cpu(struct spa_audioconvert_ops *ops, uint32_t cpu_flags)
+{
+	get_ops_c(ops);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_audioconvert_get_ops_sse2(ops);
+#endif
+}
+
+void spa_audioconvert_get_ops(struct spa_audioconvert_ops *ops)
+{
+	spa_audioconvert_get_ops_for_cpu(ops, spa_audioconvert_get_cpu_flags());
+}
@@ -0,0 +1,77 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/support/cpu.h>
+
+/* convert interleaved samples with n_channels to one array of float
+ * samples per channel */
+typedef void (*convert_to_f32d_func_t) (float **dst, const void *src,
+					uint32_t n_channels, uint32_t n_samples);
+/* convert one array of float samples per channel to interleaved samples */
+typedef void (*convert_from_f32d_func_t) (void *dst, const float **src,
+					  uint32_t n_channels, uint32_t n_samples);
+
+/* sample formats, the converters exist in native and swapped byte order */
+enum {
+	CONV_U8,
+	CONV_S8,
+	CONV_U16,
+	CONV_S16,
+	CONV_U24,
+	CONV_S24,
+	CONV_U24_32,
+	CONV_S24_32,
+	CONV_U32,
+	CONV_S32,
+	CONV_F32,
+	CONV_F64,
+	CONV_MAX,
+};
+
+enum {
+	CONV_NATIVE,
+	CONV_SWAP,
+	CONV_ORDER_MAX,
+};
+
+extern const uint32_t spa_audioconvert_sample_size[CONV_MAX];
+
+struct spa_audioconvert_ops {
+	convert_to_f32d_func_t to_f32d[CONV_MAX][CONV_ORDER_MAX];
+	convert_from_f32d_func_t from_f32d[CONV_MAX][CONV_ORDER_MAX];
+};
+
+/** get the SIMD features of the running CPU that have an optimized
+ * implementation compiled in, a mask of SPA_CPU_FLAG_* */
+uint32_t spa_audioconvert_get_cpu_flags(void);
+
+/** fill \a ops with the best functions for the given cpu flags */
+void spa_audioconvert_get_ops_for_cpu(struct spa_audioconvert_ops *ops, uint32_t cpu_flags);
+
+/** fill \a ops with the best functions for the running CPU */
+void spa_audioconvert_get_ops(struct spa_audioconvert_ops *ops);
+
+#if defined (HAVE_SSE2)
+void spa_audioconvert_get_ops_sse2(struct spa_audioconvert_ops *ops);
+#endif
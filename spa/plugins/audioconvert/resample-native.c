@@ -0,0 +1,389 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "resample.h"
+
+#define HISTORY_BLOCK	1024	/* input samples copied into the history at once */
+#define MAX_EXACT_PHASES	1024	/* max phases for a filter without interpolation */
+#define PHASE_BITS	24	/* precision of the phase when the rate is adjusted */
+
+struct quality {
+	uint32_t n_taps;	/* filter length, a multiple of 8 */
+	double cutoff;		/* relative to the nyquist frequency of the lowest rate */
+	uint32_t n_phases;	/* phases when interpolating between them */
+};
+
+static const struct quality quality_presets[] = {
+	{   8, 0.60,  64 },
+	{  16, 0.75, 128 },
+	{  24, 0.82, 128 },
+	{  32, 0.86, 128 },
+	{  48, 0.90, 256 },
+	{  64, 0.92, 256 },
+	{  96, 0.94, 256 },
+	{ 128, 0.95, 256 },
+};
+
+struct native_data {
+	uint32_t n_taps;
+	uint32_t n_phases;
+	uint32_t filter_stride;	/* floats between phases in the filter */
+	uint32_t exact_mult;	/* filter phases per output phase, 0 when not exact */
+	bool interpolate;	/* interpolate between filter phases */
+
+	uint32_t in_rate;	/* rates reduced by their gcd */
+	uint32_t out_rate;
+
+	uint32_t den;		/* phase increments with num / den input samples */
+	uint32_t inc;
+	uint32_t frac;
+	uint32_t phase;		/* 0 .. den - 1 */
+
+	uint32_t index;		/* start of the filter window in the history */
+	uint32_t hist_len;
+	uint32_t hist_size;
+
+	inner_product_func_t inner_product;
+	inner_product_ip_func_t inner_product_ip;
+
+	float *filter;
+	float *history[];
+};
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static inline double sinc(double x)
+{
+	if (x < 1e-9 && x > -1e-9)
+		return 1.0;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+/* blackman-harris window for x in -1 .. 1 */
+static inline double window(double x)
+{
+	x *= M_PI;
+	return 0.35875 + 0.48829 * cos(x) + 0.14128 * cos(2 * x) + 0.01168 * cos(3 * x);
+}
+
+static void build_filter(float *filter, uint32_t stride, uint32_t n_taps,
+			 uint32_t n_phases, double cutoff)
+{
+	uint32_t i, j, half = n_taps / 2;
+
+	for (i = 0; i <= n_phases; i++) {
+		float *taps = &filter[i * stride];
+		double frac = (double) i / n_phases, sum = 0.0;
+
+		for (j = 0; j < n_taps; j++) {
+			double x = (double) j - (half - 1) - frac;
+			taps[j] = cutoff * sinc(x * cutoff) * window(x / half);
+			sum += taps[j];
+		}
+		/* unity gain for DC in all phases */
+		for (j = 0; j < n_taps; j++)
+			taps[j] /= sum;
+	}
+}
+
+static void inner_product_c(float *d, const float *s, const float *taps, uint32_t n_taps)
+{
+	float sum = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++)
+		sum += s[i] * taps[i];
+	*d = sum;
+}
+
+static void inner_product_ip_c(float *d, const float *s,
+			       const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	float sum0 = 0.0f, sum1 = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++) {
+		sum0 += s[i] * t0[i];
+		sum1 += s[i] * t1[i];
+	}
+	*d = sum0 + (sum1 - sum0) * x;
+}
+
+static void impl_native_update_rate(struct resample *r, double rate)
+{
+	struct native_data *data = r->data;
+	uint64_t num;
+	uint32_t scale;
+
+	rate = SPA_CLAMP(rate, RESAMPLE_MIN_RATE, RESAMPLE_MAX_RATE);
+
+	data->interpolate = data->exact_mult == 0 || rate != 1.0;
+	if (!data->interpolate) {
+		scale = 1;
+	} else {
+		/* scale the phase so that small adjustments are still precise */
+		for (scale = 1; (uint64_t) data->out_rate * scale * 2 <= (1u << PHASE_BITS); scale *= 2);
+	}
+	num = llrint((double) data->in_rate * scale * rate);
+
+	/* keep the position in the current sample */
+	if (data->den != 0)
+		data->phase = (uint64_t) data->phase * data->out_rate * scale / data->den;
+
+	r->rate = rate;
+	data->den = data->out_rate * scale;
+	data->inc = num / data->den;
+	data->frac = num % data->den;
+}
+
+static void impl_native_reset(struct resample *r)
+{
+	struct native_data *data = r->data;
+	uint32_t c, pad = data->n_taps / 2 - 1;
+
+	/* start with silence so that the first output is the first input */
+	for (c = 0; c < r->channels; c++)
+		memset(data->history[c], 0, pad * sizeof(float));
+	data->hist_len = pad;
+	data->index = 0;
+	data->phase = 0;
+}
+
+static uint32_t impl_native_delay(struct resample *r)
+{
+	struct native_data *data = r->data;
+	return data->n_taps / 2;
+}
+
+/* make room in the history and fill it with new input samples,
+ * returns the number of samples consumed from the input */
+static uint32_t refill(struct resample *r, const float *src[], uint32_t offset, uint32_t in_len)
+{
+	struct native_data *data = r->data;
+	uint32_t c, skip, n;
+
+	if (data->index >= data->hist_len) {
+		/* the filter moved past the history, skip input */
+		skip = SPA_MIN(data->index - data->hist_len, in_len);
+		data->index -= data->hist_len + skip;
+		data->hist_len = 0;
+		if (data->index > 0)
+			return skip;
+	} else {
+		data->hist_len -= data->index;
+		for (c = 0; c < r->channels; c++)
+			memmove(data->history[c], data->history[c] + data->index,
+				data->hist_len * sizeof(float));
+		data->index = 0;
+		skip = 0;
+	}
+
+	n = SPA_MIN(data->hist_size - data->hist_len, in_len - skip);
+	for (c = 0; c < r->channels; c++)
+		memcpy(data->history[c] + data->hist_len, src[c] + offset + skip,
+		       n * sizeof(float));
+	data->hist_len += n;
+
+	return skip + n;
+}
+
+static void impl_native_process(struct resample *r,
+				const float *src[], uint32_t *in_len,
+				float *dst[], uint32_t *out_len)
+{
+	struct native_data *data = r->data;
+	uint32_t c, o = 0, consumed = 0, n_taps = data->n_taps;
+	uint32_t index = data->index, phase = data->phase;
+	uint32_t den = data->den, inc = data->inc, frac = data->frac;
+
+	while (o < *out_len) {
+		if (index + n_taps > data->hist_len) {
+			uint32_t n;
+
+			data->index = index;
+			n = refill(r, src, consumed, *in_len - consumed);
+			index = data->index;
+			consumed += n;
+			if (index + n_taps > data->hist_len)
+				break;
+		}
+
+		if (!data->interpolate) {
+			/* every phase has its own filter */
+			for (; o < *out_len && index + n_taps <= data->hist_len; o++) {
+				const float *taps = &data->filter[phase * data->exact_mult *
+								  data->filter_stride];
+
+				for (c = 0; c < r->channels; c++)
+					data->inner_product(&dst[c][o], &data->history[c][index],
+							    taps, n_taps);
+
+				index += inc;
+				phase += frac;
+				if (phase >= den) {
+					phase -= den;
+					index++;
+				}
+			}
+		} else {
+			for (; o < *out_len && index + n_taps <= data->hist_len; o++) {
+				uint64_t ph = (uint64_t) phase * data->n_phases;
+				uint32_t offset = ph / den;
+				float x = (float) (ph - (uint64_t) offset * den) / den;
+				const float *t0 = &data->filter[offset * data->filter_stride];
+				const float *t1 = t0 + data->filter_stride;
+
+				for (c = 0; c < r->channels; c++)
+					data->inner_product_ip(&dst[c][o], &data->history[c][index],
+							       t0, t1, x, n_taps);
+
+				index += inc;
+				phase += frac;
+				if (phase >= den) {
+					phase -= den;
+					index++;
+				}
+			}
+		}
+	}
+	data->index = index;
+	data->phase = phase;
+
+	*in_len = consumed;
+	*out_len = o;
+}
+
+static void impl_native_free(struct resample *r)
+{
+	struct native_data *data = r->data;
+
+	if (data) {
+		free(data->filter);
+		free(data);
+	}
+	r->data = NULL;
+}
+
+uint32_t resample_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+#if defined (HAVE_SSE2)
+	flags |= SPA_CPU_FLAG_SSE2;
+#endif
+	return spa_cpu_get_flags() & flags;
+}
+
+int resample_native_init(struct resample *r)
+{
+	struct native_data *data;
+	const struct quality *q;
+	uint32_t c, in_rate, out_rate, g, n_phases, stride, hist_size, exact_mult;
+	double cutoff;
+	float *history;
+
+	if (r->channels == 0 || r->i_rate == 0 || r->o_rate == 0)
+		return -EINVAL;
+
+	r->quality = SPA_CLAMP(r->quality, RESAMPLE_MIN_QUALITY, RESAMPLE_MAX_QUALITY);
+	q = &quality_presets[r->quality];
+
+	g = gcd(r->i_rate, r->o_rate);
+	in_rate = r->i_rate / g;
+	out_rate = r->o_rate / g;
+
+	/* with a small output rate we can make a filter for each possible
+	 * phase, else we always interpolate between filter phases. When
+	 * the rate is adjusted we also interpolate so make enough phases
+	 * for that as well. */
+	if (out_rate <= MAX_EXACT_PHASES) {
+		exact_mult = (q->n_phases + out_rate - 1) / out_rate;
+		n_phases = out_rate * exact_mult;
+	} else {
+		exact_mult = 0;
+		n_phases = q->n_phases;
+	}
+
+	/* filter the frequencies above the lowest nyquist frequency */
+	cutoff = q->cutoff * SPA_MIN(1.0, (double) r->o_rate / r->i_rate);
+
+	stride = SPA_ROUND_UP_N(q->n_taps, 4);
+	hist_size = q->n_taps + HISTORY_BLOCK;
+
+	data = calloc(1, sizeof(struct native_data) +
+			 r->channels * sizeof(float *) +
+			 r->channels * hist_size * sizeof(float));
+	if (data == NULL)
+		return -ENOMEM;
+
+	/* one extra phase to interpolate with, aligned for SIMD */
+	if (posix_memalign((void **) &data->filter, 16,
+			   (n_phases + 1) * stride * sizeof(float)) != 0) {
+		free(data);
+		return -ENOMEM;
+	}
+
+	r->data = data;
+	r->free = impl_native_free;
+	r->update_rate = impl_native_update_rate;
+	r->process = impl_native_process;
+	r->reset = impl_native_reset;
+	r->delay = impl_native_delay;
+
+	data->n_taps = q->n_taps;
+	data->n_phases = n_phases;
+	data->filter_stride = stride;
+	data->exact_mult = exact_mult;
+	data->in_rate = in_rate;
+	data->out_rate = out_rate;
+	data->hist_size = hist_size;
+
+	history = SPA_MEMBER(data->history, r->channels * sizeof(float *), float);
+	for (c = 0; c < r->channels; c++)
+		data->history[c] = &history[c * hist_size];
+
+	build_filter(data->filter, stride, q->n_taps, n_phases, cutoff);
+
+	data->inner_product = inner_product_c;
+	data->inner_product_ip = inner_product_ip_c;
+#if defined (HAVE_SSE2)
+	if (r->cpu_flags & SPA_CPU_FLAG_SSE2) {
+		data->inner_product = inner_product_sse2;
+		data->inner_product_ip = inner_product_ip_sse2;
+	}
+#endif
+
+	impl_native_update_rate(r, r->rate == 0.0 ? 1.0 : r->rate);
+	impl_native_reset(r);
+
+	return 0;
+}
@@ -0,0 +1,1207 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <spa/support/log.h>
+#include <spa/support/type-map.h>
+#include <spa/utils/list.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/buffers.h>
+#include <spa/param/meta.h>
+#include <spa/param/io.h>
+#include <spa/pod/filter.h>
+
+#include "resample.h"
+#include "fmt-ops.h"
+
+#define NAME "resample"
+
+#define DEFAULT_QUALITY		RESAMPLE_DEFAULT_QUALITY
+#define DEFAULT_RATE		1.0
+
+struct props {
+	int32_t quality;
+	double rate;
+};
+
+static void reset_props(struct props *props)
+{
+	props->quality = DEFAULT_QUALITY;
+	props->rate = DEFAULT_RATE;
+}
+
+#define MAX_BUFFERS	32
+#define MAX_CHANNELS	64
+#define BLOCK_SIZE	256
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_list link;
+};
+
+struct port {
+	bool have_format;
+	struct spa_audio_info format;
+	uint32_t stride;
+	uint32_t n_planes;
+
+	struct spa_port_info info;
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_io_buffers *io;
+	struct spa_io_control_range *range;
+	double *io_rate;
+
+	uint32_t offset;	/* frames of the input buffer that are done */
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	uint32_t prop_quality;
+	uint32_t prop_rate;
+	uint32_t io_prop_rate;
+	struct spa_type_io io;
+	struct spa_type_param param;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_buffers param_buffers;
+	struct spa_type_param_meta param_meta;
+	struct spa_type_param_io param_io;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_quality = spa_type_map_get_id(map, SPA_TYPE_PROPS_BASE "quality");
+	type->prop_rate = spa_type_map_get_id(map, SPA_TYPE_PROPS_BASE "rate");
+	type->io_prop_rate = spa_type_map_get_id(map, SPA_TYPE_IO_PROP_BASE "rate");
+	spa_type_io_map(map, &type->io);
+	spa_type_param_map(map, &type->param);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_buffers_map(map, &type->param_buffers);
+	spa_type_param_meta_map(map, &type->param_meta);
+	spa_type_param_io_map(map, &type->param_io);
+}
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	struct props props;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	struct port in_port;
+	struct port out_port;
+
+	struct spa_audioconvert_ops ops;
+	uint32_t cpu_flags;
+	struct resample resample;
+
+	float tmp[2][MAX_CHANNELS * BLOCK_SIZE] SPA_ALIGNED(16);
+
+	bool started;
+};
+
+#define CHECK_PORT(this,d,p)	((p) == 0)
+#define GET_IN_PORT(this,p)	(&this->in_port)
+#define GET_OUT_PORT(this,p)	(&this->out_port)
+#define GET_PORT(this,d,p)	(d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+#define OTHER_DIRECTION(d)	(d == SPA_DIRECTION_INPUT ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT)
+
+static int setup_resample(struct impl *this)
+{
+	struct port *in_port = GET_IN_PORT(this, 0);
+	struct port *out_port = GET_OUT_PORT(this, 0);
+	int res;
+
+	if (this->resample.free)
+		resample_free(&this->resample);
+	spa_zero(this->resample);
+
+	if (!in_port->have_format || !out_port->have_format)
+		return 0;
+
+	this->resample.channels = in_port->format.info.raw.channels;
+	this->resample.i_rate = in_port->format.info.raw.rate;
+	this->resample.o_rate = out_port->format.info.raw.rate;
+	this->resample.quality = this->props.quality;
+	this->resample.rate = this->props.rate;
+	this->resample.cpu_flags = this->cpu_flags;
+
+	if ((res = resample_native_init(&this->resample)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't create resampler: %d", this, res);
+		return res;
+	}
+	in_port->offset = 0;
+
+	spa_log_info(this->log, NAME " %p: %d -> %d quality:%d delay:%d", this,
+		     this->resample.i_rate, this->resample.o_rate,
+		     this->resample.quality, resample_delay(&this->resample));
+
+	return 0;
+}
+
+static int impl_node_enum_params(struct spa_node *node,
+				 uint32_t id, uint32_t *index,
+				 const struct spa_pod *filter,
+				 struct spa_pod **result,
+				 struct spa_pod_builder *builder)
+{
+	struct impl *this;
+	struct type *t;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct props *p;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+	spa_return_val_if_fail(builder != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+	p = &this->props;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	if (id == t->param.idList) {
+		uint32_t list[] = { t->param.idPropInfo,
+				    t->param.idProps };
+
+		if (*index < SPA_N_ELEMENTS(list))
+			param = spa_pod_builder_object(&b, id, t->param.List,
+				":", t->param.listId, "I", list[*index]);
+		else
+			return 0;
+	}
+	else if (id == t->param.idPropInfo) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_quality,
+				":", t->param.propName, "s", "The resample quality",
+				":", t->param.propType, "ir", p->quality,
+					SPA_POD_PROP_MIN_MAX(RESAMPLE_MIN_QUALITY, RESAMPLE_MAX_QUALITY));
+			break;
+		case 1:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_rate,
+				":", t->param.propName, "s", "Adjust the input rate",
+				":", t->param.propType, "dr", p->rate,
+					SPA_POD_PROP_MIN_MAX(RESAMPLE_MIN_RATE, RESAMPLE_MAX_RATE));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param.idProps) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->props,
+				":", t->prop_quality, "i", p->quality,
+				":", t->prop_rate,    "d", p->rate);
+			break;
+		default:
+			return 0;
+		}
+	}
+	else
+		return -ENOENT;
+
+	(*index)++;
+
+	if (spa_pod_filter(builder, result, param, filter) < 0)
+		goto next;
+
+	return 1;
+}
+
+static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	struct impl *this;
+	struct type *t;
+	struct props *p;
+	int32_t quality;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+	p = &this->props;
+
+	if (id == t->param.idProps) {
+		quality = p->quality;
+
+		if (param == NULL) {
+			reset_props(p);
+		} else {
+			spa_pod_object_parse(param,
+				":", t->prop_quality, "?i", &p->quality,
+				":", t->prop_rate,    "?d", &p->rate, NULL);
+		}
+		/* a new quality needs a new filter */
+		if (quality != p->quality)
+			return setup_resample(this);
+		if (this->resample.update_rate)
+			resample_update_rate(&this->resample, p->rate);
+	}
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start) {
+		this->started = true;
+	} else if (SPA_COMMAND_TYPE(command) == this->type.command_node.Pause) {
+		this->started = false;
+	} else
+		return -ENOTSUP;
+
+	return 0;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return 0;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return 0;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t *input_ids,
+		       uint32_t n_input_ids,
+		       uint32_t *output_ids,
+		       uint32_t n_output_ids)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ids > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ids > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return 0;
+}
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+	*info = &port->info;
+
+	return 0;
+}
+
+static int port_enum_formats(struct spa_node *node,
+			     enum spa_direction direction, uint32_t port_id,
+			     uint32_t *index,
+			     struct spa_pod **param,
+			     struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct type *t = &this->type;
+	struct port *other;
+
+	other = GET_PORT(this, OTHER_DIRECTION(direction), 0);
+
+	switch (*index) {
+	case 0:
+		/* we only change the rate, the other port decides the rest */
+		if (other->have_format) {
+			*param = spa_pod_builder_object(builder,
+				t->param.idEnumFormat, t->format,
+				"I", t->media_type.audio,
+				"I", t->media_subtype.raw,
+				":", t->format_audio.format,   "I", other->format.info.raw.format,
+				":", t->format_audio.layout,   "i", other->format.info.raw.layout,
+				":", t->format_audio.rate,     "iru", other->format.info.raw.rate,
+					SPA_POD_PROP_MIN_MAX(1, INT32_MAX),
+				":", t->format_audio.channels, "i", other->format.info.raw.channels);
+		} else {
+			*param = spa_pod_builder_object(builder,
+				t->param.idEnumFormat, t->format,
+				"I", t->media_type.audio,
+				"I", t->media_subtype.raw,
+				":", t->format_audio.format,   "I", t->audio_format.F32,
+				":", t->format_audio.layout,   "ieu", SPA_AUDIO_LAYOUT_INTERLEAVED,
+					SPA_POD_PROP_ENUM(2, SPA_AUDIO_LAYOUT_INTERLEAVED,
+							     SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
+				":", t->format_audio.rate,     "iru", 44100,
+					SPA_POD_PROP_MIN_MAX(1, INT32_MAX),
+				":", t->format_audio.channels, "iru", 2,
+					SPA_POD_PROP_MIN_MAX(1, MAX_CHANNELS));
+		}
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+static int port_get_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t *index,
+			   struct spa_pod **param,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port = GET_PORT(this, direction, port_id);
+	struct type *t = &this->type;
+
+	if (!port->have_format)
+		return -EIO;
+	if (*index > 0)
+		return 0;
+
+	*param = spa_pod_builder_object(builder,
+			t->param.idFormat, t->format,
+			"I", t->media_type.audio,
+			"I", t->media_subtype.raw,
+			":", t->format_audio.format,   "I", port->format.info.raw.format,
+			":", t->format_audio.layout,   "i", port->format.info.raw.layout,
+			":", t->format_audio.rate,     "i", port->format.info.raw.rate,
+			":", t->format_audio.channels, "i", port->format.info.raw.channels);
+
+	return 1;
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t id, uint32_t *index,
+			   const struct spa_pod *filter,
+			   struct spa_pod **result,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this;
+	struct type *t;
+	struct port *port, *other;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[2048];
+	struct spa_pod *param;
+	int res;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+	spa_return_val_if_fail(builder != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+	other = GET_PORT(this, OTHER_DIRECTION(direction), port_id);
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	if (id == t->param.idList) {
+		uint32_t list[] = { t->param.idEnumFormat,
+				    t->param.idFormat,
+				    t->param.idBuffers,
+				    t->param.idMeta,
+				    t->param_io.idBuffers,
+				    t->param_io.idControl,
+				    t->param_io.idPropsIn };
+
+		if (*index < SPA_N_ELEMENTS(list))
+			param = spa_pod_builder_object(&b, id, t->param.List,
+				":", t->param.listId, "I", list[*index]);
+		else
+			return 0;
+	}
+	else if (id == t->param.idEnumFormat) {
+		if ((res = port_enum_formats(node, direction, port_id, index, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idFormat) {
+		if ((res = port_get_format(node, direction, port_id, index, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idBuffers) {
+		uint32_t size = 1024;
+
+		if (!port->have_format)
+			return -EIO;
+		if (*index > 0)
+			return 0;
+
+		/* room for the output of one input buffer */
+		if (other->have_format)
+			size = SPA_MAX(size, size * port->format.info.raw.rate /
+					     other->format.info.raw.rate);
+
+		param = spa_pod_builder_object(&b,
+			id, t->param_buffers.Buffers,
+			":", t->param_buffers.size,    "iru", size * port->stride,
+				SPA_POD_PROP_MIN_MAX(16 * port->stride, INT32_MAX / port->stride),
+			":", t->param_buffers.stride,  "i", port->stride,
+			":", t->param_buffers.buffers, "iru", 2,
+				SPA_POD_PROP_MIN_MAX(1, MAX_BUFFERS),
+			":", t->param_buffers.align,   "i", 16);
+	}
+	else if (id == t->param.idMeta) {
+		if (!port->have_format)
+			return -EIO;
+
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_meta.Meta,
+				":", t->param_meta.type, "I", t->meta.Header,
+				":", t->param_meta.size, "i", sizeof(struct spa_meta_header));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idBuffers) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Buffers,
+				":", t->param_io.id, "I", t->io.Buffers,
+				":", t->param_io.size, "i", sizeof(struct spa_io_buffers));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idControl) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Control,
+				":", t->param_io.id, "I", t->io.ControlRange,
+				":", t->param_io.size, "i", sizeof(struct spa_io_control_range));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idPropsIn) {
+		if (direction == SPA_DIRECTION_OUTPUT)
+			return 0;
+
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Prop,
+				":", t->param_io.id,    "I", t->io_prop_rate,
+				":", t->param_io.size,  "i", sizeof(struct spa_pod_double),
+				":", t->param.propId,   "I", t->prop_rate,
+				":", t->param.propType, "dru", this->props.rate,
+					SPA_POD_PROP_MIN_MAX(RESAMPLE_MIN_RATE, RESAMPLE_MAX_RATE));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else
+		return -ENOENT;
+
+	(*index)++;
+
+	if (spa_pod_filter(builder, result, param, filter) < 0)
+		goto next;
+
+	return 1;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers %p", this, port);
+		port->n_buffers = 0;
+		port->offset = 0;
+		spa_list_init(&port->empty);
+	}
+	return 0;
+}
+
+static int port_set_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t flags,
+			   const struct spa_pod *format)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port, *other;
+	struct type *t = &this->type;
+
+	port = GET_PORT(this, direction, port_id);
+	other = GET_PORT(this, OTHER_DIRECTION(direction), 0);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+	} else {
+		struct spa_audio_info info = { 0 };
+
+		spa_pod_object_parse(format,
+			"I", &info.media_type,
+			"I", &info.media_subtype);
+
+		if (info.media_type != t->media_type.audio ||
+		    info.media_subtype != t->media_subtype.raw)
+			return -EINVAL;
+
+		if (spa_format_audio_raw_parse(format, &info.info.raw, &t->format_audio) < 0)
+			return -EINVAL;
+
+		if (info.info.raw.format != t->audio_format.F32)
+			return -EINVAL;
+		if (info.info.raw.channels == 0 || info.info.raw.channels > MAX_CHANNELS)
+			return -EINVAL;
+		if (info.info.raw.rate == 0)
+			return -EINVAL;
+
+		if (other->have_format &&
+		    (info.info.raw.channels != other->format.info.raw.channels ||
+		     info.info.raw.layout != other->format.info.raw.layout))
+			return -EINVAL;
+
+		if (info.info.raw.layout == SPA_AUDIO_LAYOUT_INTERLEAVED) {
+			port->stride = sizeof(float) * info.info.raw.channels;
+			port->n_planes = 1;
+		} else {
+			port->stride = sizeof(float);
+			port->n_planes = info.info.raw.channels;
+		}
+		port->format = info;
+		port->have_format = true;
+
+		spa_log_info(this->log, NAME " %p: set format on port %d:%d", this,
+			     direction, port_id);
+	}
+	return setup_resample(this);
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction, uint32_t port_id,
+			 uint32_t id, uint32_t flags,
+			 const struct spa_pod *param)
+{
+	struct impl *this;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	if (id == t->param.idFormat) {
+		return port_set_format(node, direction, port_id, flags, param);
+	}
+	else
+		return -ENOENT;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	struct type *t;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], t->meta.Header);
+
+		/* non-interleaved audio has one data block per channel */
+		if (buffers[i]->n_datas < port->n_planes) {
+			spa_log_error(this->log, NAME " %p: need %d datas on buffer %p", this,
+				      port->n_planes, buffers[i]);
+			return -EINVAL;
+		}
+		for (j = 0; j < port->n_planes; j++) {
+			if (!((d[j].type == t->data.MemPtr ||
+			       d[j].type == t->data.MemFd ||
+			       d[j].type == t->data.DmaBuf) && d[j].data != NULL)) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+					      buffers[i]);
+				return -EINVAL;
+			}
+		}
+		if (!b->outstanding)
+			spa_list_append(&port->empty, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return 0;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_pod **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      uint32_t id,
+		      void *data, size_t size)
+{
+	struct impl *this;
+	struct port *port;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (id == t->io.Buffers)
+		port->io = data;
+	else if (id == t->io.ControlRange)
+		port->range = data;
+	else if (id == t->io_prop_rate && direction == SPA_DIRECTION_INPUT)
+		if (data && size >= sizeof(struct spa_pod_double))
+			port->io_rate = &SPA_POD_VALUE(struct spa_pod_double, data);
+		else
+			port->io_rate = &this->props.rate;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_append(&port->empty, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id), -EINVAL);
+
+	port = GET_OUT_PORT(this, port_id);
+
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	recycle_buffer(this, buffer_id);
+
+	return 0;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return -ENOTSUP;
+}
+
+static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b->outbuf;
+}
+
+/* resample the input buffer from the current offset into dbuf, returns
+ * true when all of the input was consumed */
+static bool resample(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	struct port *in_port = GET_IN_PORT(this, 0);
+	struct port *out_port = GET_OUT_PORT(this, 0);
+	uint32_t channels = in_port->format.info.raw.channels;
+	struct spa_data *sd = sbuf->datas, *dd = dbuf->datas;
+	const float *src[MAX_CHANNELS];
+	float *dst[MAX_CHANNELS];
+	const float *in[MAX_CHANNELS];
+	float *out[MAX_CHANNELS];
+	uint32_t i, n_in, n_out, in_done, out_done, in_len, out_len;
+	double rate;
+
+	n_in = UINT32_MAX;
+	for (i = 0; i < in_port->n_planes; i++) {
+		uint32_t offset = sd[i].chunk->offset % sd[i].maxsize;
+		uint32_t size = SPA_MIN(sd[i].chunk->size, sd[i].maxsize - offset);
+
+		src[i] = SPA_MEMBER(sd[i].data, offset, float);
+		n_in = SPA_MIN(n_in, size / in_port->stride);
+	}
+	n_out = UINT32_MAX;
+	for (i = 0; i < out_port->n_planes; i++) {
+		dst[i] = dd[i].data;
+		n_out = SPA_MIN(n_out, dd[i].maxsize / out_port->stride);
+	}
+
+	/* the rate can be adjusted in realtime with the io area */
+	rate = *in_port->io_rate;
+	if (rate != this->resample.rate)
+		resample_update_rate(&this->resample, rate);
+
+	in_done = in_port->offset;
+	out_done = 0;
+
+	/* the resampler keeps some input in its history, continue until it
+	 * can't make more output */
+	if (in_port->n_planes == channels) {
+		/* planar, we can work directly on the buffers */
+		while (out_done < n_out) {
+			for (i = 0; i < channels; i++) {
+				in[i] = src[i] + in_done;
+				out[i] = dst[i] + out_done;
+			}
+			in_len = n_in - in_done;
+			out_len = n_out - out_done;
+			resample_process(&this->resample, in, &in_len, out, &out_len);
+			in_done += in_len;
+			out_done += out_len;
+			if (in_len == 0 && out_len == 0)
+				break;
+		}
+	} else {
+		/* interleaved, deinterleave blocks into planes */
+		convert_to_f32d_func_t to_f32d = this->ops.to_f32d[CONV_F32][CONV_NATIVE];
+		convert_from_f32d_func_t from_f32d = this->ops.from_f32d[CONV_F32][CONV_NATIVE];
+
+		for (i = 0; i < channels; i++) {
+			in[i] = &this->tmp[0][i * BLOCK_SIZE];
+			out[i] = &this->tmp[1][i * BLOCK_SIZE];
+		}
+		while (out_done < n_out) {
+			in_len = SPA_MIN(n_in - in_done, BLOCK_SIZE);
+			out_len = SPA_MIN(n_out - out_done, BLOCK_SIZE);
+
+			to_f32d((float **) in, src[0] + in_done * channels, channels, in_len);
+			resample_process(&this->resample, in, &in_len, out, &out_len);
+			from_f32d(dst[0] + out_done * channels, (const float **) out, channels, out_len);
+
+			in_done += in_len;
+			out_done += out_len;
+			if (in_len == 0 && out_len == 0)
+				break;
+		}
+	}
+
+	spa_log_trace(this->log, NAME " %p: %d/%d -> %d/%d", this,
+		      in_done - in_port->offset, n_in, out_done, n_out);
+
+	for (i = 0; i < out_port->n_planes; i++) {
+		dd[i].chunk->offset = 0;
+		dd[i].chunk->size = out_done * out_port->stride;
+		dd[i].chunk->stride = out_port->stride;
+	}
+
+	in_port->offset = in_done;
+	if (in_done < n_in)
+		return false;
+
+	in_port->offset = 0;
+	return true;
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_io_buffers *input, *output;
+	struct port *in_port, *out_port;
+	struct spa_buffer *dbuf, *sbuf;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	if (input->buffer_id >= in_port->n_buffers) {
+		input->status = -EINVAL;
+		return -EINVAL;
+	}
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL) {
+		spa_log_error(this->log, NAME " %p: out of buffers", this);
+		return -EPIPE;
+	}
+
+	sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+	/* when the output buffer was too small we keep the input buffer
+	 * and continue with it in process_output */
+	if (resample(this, dbuf, sbuf))
+		input->status = SPA_STATUS_OK;
+
+	output->buffer_id = dbuf->id;
+	output->status = SPA_STATUS_HAVE_BUFFER;
+
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_io_buffers *input, *output;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	/* finish the remainder of the last input buffer first */
+	if (in_port->offset > 0 && input->buffer_id < in_port->n_buffers)
+		return impl_node_process_input(node);
+
+	if (in_port->range && out_port->range) {
+		*in_port->range = *out_port->range;
+		/* ask for the amount of input that makes the requested output */
+		if (this->resample.i_rate != 0) {
+			in_port->range->min_size = (uint64_t) out_port->range->min_size *
+				this->resample.i_rate / this->resample.o_rate;
+			in_port->range->max_size = (uint64_t) out_port->range->max_size *
+				this->resample.i_rate / this->resample.o_rate;
+		}
+	}
+	input->status = SPA_STATUS_NEED_BUFFER;
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	impl_node_enum_params,
+	impl_node_set_param,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (this->resample.free)
+		resample_free(&this->resample);
+
+	return 0;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return -EINVAL;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+	reset_props(&this->props);
+
+	this->in_port.info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	this->in_port.io_rate = &this->props.rate;
+	spa_list_init(&this->in_port.empty);
+
+	this->out_port.info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_port.empty);
+
+	this->cpu_flags = resample_get_cpu_flags() | spa_audioconvert_get_cpu_flags();
+	spa_audioconvert_get_ops_for_cpu(&this->ops, this->cpu_flags);
+	spa_log_info(this->log, NAME " %p: using cpu flags %08x", this, this->cpu_flags);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+const struct spa_handle_factory spa_resample_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
@@ -0,0 +1,96 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __SPA_AUDIOCONVERT_RESAMPLE_H__
+#define __SPA_AUDIOCONVERT_RESAMPLE_H__
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/support/cpu.h>
+
+#define RESAMPLE_MIN_QUALITY		0
+#define RESAMPLE_MAX_QUALITY		7
+#define RESAMPLE_DEFAULT_QUALITY	4
+
+/* the largest rate correction that can be applied with update_rate */
+#define RESAMPLE_MIN_RATE		0.5
+#define RESAMPLE_MAX_RATE		2.0
+
+/* resample planar float samples from i_rate to o_rate */
+struct resample {
+	uint32_t cpu_flags;	/**< SPA_CPU_FLAG_* to use */
+	uint32_t channels;
+	uint32_t i_rate;
+	uint32_t o_rate;
+	int quality;		/**< RESAMPLE_MIN_QUALITY .. RESAMPLE_MAX_QUALITY */
+	double rate;		/**< rate correction, see update_rate */
+
+	void (*free) (struct resample *r);
+	/** adjust the input rate with the fractional \a rate. A value
+	 * bigger than 1.0 consumes the input faster and makes less output
+	 * samples. This can be called between calls to process to track
+	 * the drift between two clocks. */
+	void (*update_rate) (struct resample *r, double rate);
+	/** resample at most \a in_len samples from \a src to at most
+	 * \a out_len samples in \a dst. On return \a in_len and \a out_len
+	 * contain the number of consumed and produced samples. */
+	void (*process) (struct resample *r,
+			 const float *src[], uint32_t *in_len,
+			 float *dst[], uint32_t *out_len);
+	/** forget all history */
+	void (*reset) (struct resample *r);
+	/** the number of input samples of delay */
+	uint32_t (*delay) (struct resample *r);
+
+	void *data;
+};
+
+#define resample_free(r)		(r)->free(r)
+#define resample_update_rate(r,...)	(r)->update_rate(r,__VA_ARGS__)
+#define resample_process(r,...)		(r)->process(r,__VA_ARGS__)
+#define resample_reset(r)		(r)->reset(r)
+#define resample_delay(r)		(r)->delay(r)
+
+/** set up a windowed sinc resampler for the channels, rates, quality
+ * and cpu_flags of \a r */
+int resample_native_init(struct resample *r);
+
+/** get the SIMD features of the running CPU that have an optimized
+ * implementation compiled in, a mask of SPA_CPU_FLAG_* */
+uint32_t resample_get_cpu_flags(void);
+
+/* dot product of n_taps samples with a filter, n_taps is a multiple
+ * of 8 and taps are 16 byte aligned */
+typedef void (*inner_product_func_t) (float *d, const float *s,
+				      const float *taps, uint32_t n_taps);
+/* the same but with the filter interpolated between t0 and t1 with x */
+typedef void (*inner_product_ip_func_t) (float *d, const float *s,
+					 const float *t0, const float *t1, float x,
+					 uint32_t n_taps);
+
+#if defined (HAVE_SSE2)
+void inner_product_sse2(float *d, const float *s, const float *taps, uint32_t n_taps);
+void inner_product_ip_sse2(float *d, const float *s,
+			   const float *t0, const float *t1, float x, uint32_t n_taps);
+#endif
+
+#endif /* __SPA_AUDIOCONVERT_RESAMPLE_H__ */
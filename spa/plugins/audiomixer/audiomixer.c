@@ -149,11 +149,7 @@ struct impl {
 	struct spa_audio_info format;
 	uint32_t bpf;
 
-	mix_clear_func_t clear;
-	mix_func_t copy;
-	mix_func_t add;
-	mix_scale_func_t copy_scale;
-	mix_scale_func_t add_scale;
+	mix_n_func_t mix;
 
 	bool started;
 };
@@ -617,19 +613,11 @@ static int port_set_format(struct spa_node *node,
 				return -EINVAL;
 		} else {
 			if (info.info.raw.format == t->audio_format.S16) {
-				this->clear = this->ops.clear[FMT_S16];
-				this->copy = this->ops.copy[FMT_S16];
-				this->add = this->ops.add[FMT_S16];
-				this->copy_scale = this->ops.copy_scale[FMT_S16];
-				this->add_scale = this->ops.add_scale[FMT_S16];
+				this->mix = this->ops.mix[FMT_S16];
 				this->bpf = sizeof(int16_t) * info.info.raw.channels;
 			}
 			else if (info.info.raw.format == t->audio_format.F32) {
-				this->clear = this->ops.clear[FMT_F32];
-				this->copy = this->ops.copy[FMT_F32];
-				this->add = this->ops.add[FMT_F32];
-				this->copy_scale = this->ops.copy_scale[FMT_F32];
-				this->add_scale = this->ops.add_scale[FMT_F32];
+				this->mix = this->ops.mix[FMT_F32];
 				this->bpf = sizeof(float) * info.info.raw.channels;
 			}
 			else
@@ -817,77 +805,59 @@ impl_node_port_send_command(struct spa_node *node,
 }
 
 static inline void
-add_port_data(struct impl *this, void *out, size_t outsize, struct port *port, int layer)
+get_port_data(struct impl *this, struct port *port, void **data, uint32_t *avail)
 {
-	size_t insize;
 	struct buffer *b;
-	uint32_t index, offset, len1, len2, maxsize;
 	struct spa_data *d;
-	void *data;
-	double volume = *port->io_volume;
-	bool mute = *port->io_mute;
+	uint32_t insize, index, offset, maxsize;
 
 	b = spa_list_first(&port->queue, struct buffer, link);
-
 	d = b->outbuf->datas;
 
 	maxsize = d[0].maxsize;
-	data = d[0].data;
-
 	insize = SPA_MIN(d[0].chunk->size, maxsize);
-	outsize = SPA_MIN(outsize, insize);
 
 	index = d[0].chunk->offset + (insize - port->queued_bytes);
 	offset = index % maxsize;
 
-	len1 = SPA_MIN(outsize, maxsize - offset);
-	len2 = outsize - len1;
-
-	if (volume < 0.001 || mute) {
-		/* silence, for the first layer clear, otherwise do nothing */
-		if (layer == 0) {
-			this->clear(out, len1);
-			if (len2 > 0)
-				this->clear(out + len1, len2);
-		}
-	}
-	else if (volume < 0.999 || volume > 1.001) {
-		mix_scale_func_t mix = layer == 0 ? this->copy_scale : this->add_scale;
+	/* contiguous data until the end of the queued data or the ringbuffer */
+	*data = SPA_MEMBER(d[0].data, offset, void);
+	*avail = SPA_MIN(port->queued_bytes, maxsize - offset);
+}
 
-		mix(out, SPA_MEMBER(data, offset, void), volume, len1);
-		if (len2 > 0)
-			mix(out + len1, data, volume, len2);
-	}
-	else {
-		mix_func_t mix = layer == 0 ? this->copy : this->add;
+static inline void
+consume_port_data(struct impl *this, struct port *port, size_t size)
+{
+	struct buffer *b;
 
-		mix(out, SPA_MEMBER(data, offset, void), len1);
-		if (len2 > 0)
-			mix(out + len1, data, len2);
-	}
+	b = spa_list_first(&port->queue, struct buffer, link);
 
-	port->queued_bytes -= outsize;
+	port->queued_bytes -= size;
 
 	if (port->queued_bytes == 0) {
 		spa_log_trace(this->log, NAME " %p: return buffer %d on port %p %zd",
-			      this, b->outbuf->id, port, outsize);
+			      this, b->outbuf->id, port, size);
 		port->io->buffer_id = b->outbuf->id;
 		spa_list_remove(&b->link);
 		b->outstanding = true;
 	} else {
 		spa_log_trace(this->log, NAME " %p: keeping buffer %d on port %p %zd %zd",
-			      this, b->outbuf->id, port, port->queued_bytes, outsize);
+			      this, b->outbuf->id, port, port->queued_bytes, size);
 	}
 }
 
 static int mix_output(struct impl *this, size_t n_bytes)
 {
 	struct buffer *outbuf;
-	int i, layer;
+	int i;
 	struct port *outport;
 	struct spa_io_buffers *outio;
 	struct spa_data *od;
-	uint32_t avail, index, maxsize, len1, len2, offset;
+	uint32_t maxsize, n_ports, n_src, j, len, avail;
+	struct port *ports[MAX_PORTS];
+	const void *src[MAX_PORTS];
+	double gain[MAX_PORTS];
+	size_t done;
 
 	outport = GET_OUT_PORT(this, 0);
 	outio = outport->io;
@@ -904,18 +874,12 @@ static int mix_output(struct impl *this, size_t n_bytes)
 	od = outbuf->outbuf->datas;
 	maxsize = od[0].maxsize;
 
-	avail = maxsize;
-	index = 0;
-	n_bytes = SPA_MIN(n_bytes, avail);
+	n_bytes = SPA_MIN(n_bytes, maxsize);
 
-	offset = index % maxsize;
-	len1 = SPA_MIN(n_bytes, maxsize - offset);
-	len2 = n_bytes - len1;
-
-	spa_log_trace(this->log, NAME " %p: dequeue output buffer %d %zd %d %d %d",
-		      this, outbuf->outbuf->id, n_bytes, offset, len1, len2);
+	spa_log_trace(this->log, NAME " %p: dequeue output buffer %d %zd",
+		      this, outbuf->outbuf->id, n_bytes);
 
-	for (layer = 0, i = 0; i < this->last_port; i++) {
+	for (n_ports = 0, i = 0; i < this->last_port; i++) {
 		struct port *in_port = GET_IN_PORT(this, i);
 
 		if (in_port->io == NULL || in_port->n_buffers == 0)
@@ -925,14 +889,39 @@ static int mix_output(struct impl *this, size_t n_bytes)
 			spa_log_warn(this->log, NAME " %p: underrun stream %d", this, i);
 			continue;
 		}
+		ports[n_ports++] = in_port;
+	}
+
+	/* mix all ports in one pass over the output. When the data of one of
+	 * the inputs wraps around in its ringbuffer we do another pass for the
+	 * remaining part */
+	for (done = 0; done < n_bytes; done += len) {
+		len = n_bytes - done;
+
+		for (n_src = 0, j = 0; j < n_ports; j++) {
+			struct port *in_port = ports[j];
+			double volume = *in_port->io_volume;
+			bool mute = *in_port->io_mute;
+			void *data;
+
+			get_port_data(this, in_port, &data, &avail);
+			len = SPA_MIN(len, avail);
+
+			if (volume < 0.001 || mute)
+				continue;
+
+			src[n_src] = data;
+			gain[n_src] = (volume < 0.999 || volume > 1.001) ? volume : 1.0;
+			n_src++;
+		}
+
+		this->mix(SPA_MEMBER(od[0].data, done, void), src, gain, n_src, len);
 
-		add_port_data(this, SPA_MEMBER(od[0].data, offset, void), len1, in_port, layer);
-		if (len2 > 0)
-			add_port_data(this, od[0].data, len2, in_port, layer);
-		layer++;
+		for (j = 0; j < n_ports; j++)
+			consume_port_data(this, ports[j], len);
 	}
 
-	od[0].chunk->offset = index;
+	od[0].chunk->offset = 0;
 	od[0].chunk->size = n_bytes;
 	od[0].chunk->stride = 0;
 
@@ -1115,7 +1104,7 @@ impl_init(const struct spa_handle_factory *factory,
 {
 	struct impl *this;
 	struct port *port;
-	uint32_t i;
+	uint32_t i, cpu_flags;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -1145,7 +1134,9 @@ impl_init(const struct spa_handle_factory *factory,
 	    SPA_PORT_INFO_FLAG_NO_REF;
 	spa_list_init(&port->queue);
 
-	spa_audiomixer_get_ops(&this->ops);
+	cpu_flags = spa_audiomixer_get_cpu_flags();
+	spa_audiomixer_get_ops_for_cpu(&this->ops, cpu_flags);
+	spa_log_info(this->log, NAME " %p: using cpu flags %08x", this, cpu_flags);
 
 	return 0;
 }
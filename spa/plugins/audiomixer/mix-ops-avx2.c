@@ -0,0 +1,350 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "mix-ops.h"
+
+#include <immintrin.h>
+
+static void
+add_s16_avx2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, unrolled;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	unrolled = n_bytes & ~31;
+
+	for (n = 0; n < unrolled; n += 32) {
+		__m256i in[2];
+
+		in[0] = _mm256_loadu_si256((const __m256i *)&s[n + 0]);
+		in[1] = _mm256_loadu_si256((const __m256i *)&s[n + 16]);
+		in[0] = _mm256_adds_epi16(in[0], _mm256_loadu_si256((const __m256i *)&d[n + 0]));
+		in[1] = _mm256_adds_epi16(in[1], _mm256_loadu_si256((const __m256i *)&d[n + 16]));
+		_mm256_storeu_si256((__m256i *)&d[n + 0], in[0]);
+		_mm256_storeu_si256((__m256i *)&d[n + 16], in[1]);
+	}
+	for (; n < n_bytes; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+/* unpack and pack work per 128 bit lane so the sample order is preserved
+ * when the lo and hi halves are packed again */
+static inline __m256i
+scale_lo_s16_avx2(__m256i in, __m256i vol)
+{
+	__m256i lo = _mm256_mullo_epi16(in, vol);
+	__m256i hi = _mm256_mulhi_epi16(in, vol);
+	return _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 11);
+}
+
+static inline __m256i
+scale_hi_s16_avx2(__m256i in, __m256i vol)
+{
+	__m256i lo = _mm256_mullo_epi16(in, vol);
+	__m256i hi = _mm256_mulhi_epi16(in, vol);
+	return _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 11);
+}
+
+static void
+copy_scale_s16_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11), t;
+	int n = 0, unrolled;
+
+	n_bytes /= sizeof(int16_t);
+
+	/* the 16 bit multiply needs the fixed point volume to fit in 16 bits */
+	if (v >= INT16_MIN && v <= INT16_MAX) {
+		__m256i vol = _mm256_set1_epi16(v);
+
+		unrolled = n_bytes & ~15;
+		for (; n < unrolled; n += 16) {
+			__m256i in = _mm256_loadu_si256((const __m256i *)&s[n]);
+			__m256i out = _mm256_packs_epi32(scale_lo_s16_avx2(in, vol),
+							 scale_hi_s16_avx2(in, vol));
+			_mm256_storeu_si256((__m256i *)&d[n], out);
+		}
+	}
+	for (; n < n_bytes; n++) {
+		t = (s[n] * v) >> 11;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_s16_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11), t;
+	int n = 0, unrolled;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (v >= INT16_MIN && v <= INT16_MAX) {
+		__m256i vol = _mm256_set1_epi16(v);
+
+		unrolled = n_bytes & ~15;
+		for (; n < unrolled; n += 16) {
+			__m256i in = _mm256_loadu_si256((const __m256i *)&s[n]);
+			__m256i out = _mm256_loadu_si256((const __m256i *)&d[n]);
+			__m256i lo, hi;
+
+			lo = _mm256_srai_epi32(_mm256_unpacklo_epi16(out, out), 16);
+			hi = _mm256_srai_epi32(_mm256_unpackhi_epi16(out, out), 16);
+			lo = _mm256_add_epi32(lo, scale_lo_s16_avx2(in, vol));
+			hi = _mm256_add_epi32(hi, scale_hi_s16_avx2(in, vol));
+			_mm256_storeu_si256((__m256i *)&d[n], _mm256_packs_epi32(lo, hi));
+		}
+	}
+	for (; n < n_bytes; n++) {
+		t = d[n] + ((s[n] * v) >> 11);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_avx2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		__m256 in[2];
+
+		in[0] = _mm256_loadu_ps(&s[n + 0]);
+		in[1] = _mm256_loadu_ps(&s[n + 8]);
+		in[0] = _mm256_add_ps(in[0], _mm256_loadu_ps(&d[n + 0]));
+		in[1] = _mm256_add_ps(in[1], _mm256_loadu_ps(&d[n + 8]));
+		_mm256_storeu_ps(&d[n + 0], in[0]);
+		_mm256_storeu_ps(&d[n + 8], in[1]);
+	}
+	for (; n < n_bytes; n++)
+		d[n] += s[n];
+}
+
+static void
+copy_scale_f32_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	__m256 vol = _mm256_set1_ps(v);
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		_mm256_storeu_ps(&d[n + 0], _mm256_mul_ps(_mm256_loadu_ps(&s[n + 0]), vol));
+		_mm256_storeu_ps(&d[n + 8], _mm256_mul_ps(_mm256_loadu_ps(&s[n + 8]), vol));
+	}
+	for (; n < n_bytes; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_f32_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	__m256 vol = _mm256_set1_ps(v);
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~15;
+
+	/* no FMA here, we want the same rounding as the C version */
+	for (n = 0; n < unrolled; n += 16) {
+		__m256 in[2];
+
+		in[0] = _mm256_mul_ps(_mm256_loadu_ps(&s[n + 0]), vol);
+		in[1] = _mm256_mul_ps(_mm256_loadu_ps(&s[n + 8]), vol);
+		in[0] = _mm256_add_ps(in[0], _mm256_loadu_ps(&d[n + 0]));
+		in[1] = _mm256_add_ps(in[1], _mm256_loadu_ps(&d[n + 8]));
+		_mm256_storeu_ps(&d[n + 0], in[0]);
+		_mm256_storeu_ps(&d[n + 8], in[1]);
+	}
+	for (; n < n_bytes; n++)
+		d[n] += s[n] * v;
+}
+
+/* multiply 16 samples with a 16 bit volume, the result is in sample order */
+static inline void
+scale_s16_avx2(__m256i in, __m256i vol, __m256i *lo, __m256i *hi)
+{
+	__m256i p0 = scale_lo_s16_avx2(in, vol);
+	__m256i p1 = scale_hi_s16_avx2(in, vol);
+	*lo = _mm256_permute2x128_si256(p0, p1, 0x20);
+	*hi = _mm256_permute2x128_si256(p0, p1, 0x31);
+}
+
+/* same with a 32 bit volume, slower but works for any volume */
+static inline void
+scale_s16_32_avx2(const int16_t *s, __m256i vol, __m256i *lo, __m256i *hi)
+{
+	__m256i in0 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&s[0]));
+	__m256i in1 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&s[8]));
+	*lo = _mm256_srai_epi32(_mm256_mullo_epi32(in0, vol), 11);
+	*hi = _mm256_srai_epi32(_mm256_mullo_epi32(in1, vol), 11);
+}
+
+static void
+mix_s16_avx2(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t acc[MIX_BLOCK_SIZE] SPA_ALIGNED(32), v, t;
+	int n, i, len, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(int16_t));
+		return;
+	}
+	for (n = 0; n < n_bytes; n += len) {
+		len = SPA_MIN(n_bytes - n, MIX_BLOCK_SIZE);
+		unrolled = len & ~15;
+
+		for (j = 0; j < n_src; j++) {
+			const int16_t *s = (const int16_t *) src[j] + n;
+			bool small;
+			__m256i vol;
+
+			v = gain[j] * (1 << 11);
+			small = v >= INT16_MIN && v <= INT16_MAX;
+			vol = small ? _mm256_set1_epi16(v) : _mm256_set1_epi32(v);
+
+			for (i = 0; i < unrolled; i += 16) {
+				__m256i lo, hi;
+
+				if (small)
+					scale_s16_avx2(_mm256_loadu_si256((const __m256i *)&s[i]),
+							vol, &lo, &hi);
+				else
+					scale_s16_32_avx2(&s[i], vol, &lo, &hi);
+
+				if (j > 0) {
+					lo = _mm256_add_epi32(lo, _mm256_load_si256((__m256i *)&acc[i + 0]));
+					hi = _mm256_add_epi32(hi, _mm256_load_si256((__m256i *)&acc[i + 8]));
+				}
+				_mm256_store_si256((__m256i *)&acc[i + 0], lo);
+				_mm256_store_si256((__m256i *)&acc[i + 8], hi);
+			}
+			if (j == 0) {
+				for (; i < len; i++)
+					acc[i] = (s[i] * v) >> 11;
+			} else {
+				for (; i < len; i++)
+					acc[i] += (s[i] * v) >> 11;
+			}
+		}
+		for (i = 0; i < unrolled; i += 16) {
+			__m256i lo = _mm256_load_si256((__m256i *)&acc[i + 0]);
+			__m256i hi = _mm256_load_si256((__m256i *)&acc[i + 8]);
+			/* pack works per 128 bit lane, put the 64 bit parts back in order */
+			__m256i out = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi),
+							       _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i *)&d[n + i], out);
+		}
+		for (; i < len; i++) {
+			t = acc[i];
+			d[n + i] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		}
+	}
+}
+
+static void
+mix_f32_avx2(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float v, t;
+	int n, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(float);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(float));
+		return;
+	}
+	unrolled = n_bytes & ~31;
+
+	/* keep 32 samples of the sum in registers while all sources are
+	 * added, dst is written once and never read */
+	for (n = 0; n < unrolled; n += 32) {
+		const float *s = (const float *) src[0] + n;
+		__m256 vol = _mm256_set1_ps(gain[0]);
+		__m256 acc[4];
+
+		acc[0] = _mm256_mul_ps(_mm256_loadu_ps(&s[0]), vol);
+		acc[1] = _mm256_mul_ps(_mm256_loadu_ps(&s[8]), vol);
+		acc[2] = _mm256_mul_ps(_mm256_loadu_ps(&s[16]), vol);
+		acc[3] = _mm256_mul_ps(_mm256_loadu_ps(&s[24]), vol);
+
+		for (j = 1; j < n_src; j++) {
+			s = (const float *) src[j] + n;
+			vol = _mm256_set1_ps(gain[j]);
+
+			acc[0] = _mm256_add_ps(acc[0], _mm256_mul_ps(_mm256_loadu_ps(&s[0]), vol));
+			acc[1] = _mm256_add_ps(acc[1], _mm256_mul_ps(_mm256_loadu_ps(&s[8]), vol));
+			acc[2] = _mm256_add_ps(acc[2], _mm256_mul_ps(_mm256_loadu_ps(&s[16]), vol));
+			acc[3] = _mm256_add_ps(acc[3], _mm256_mul_ps(_mm256_loadu_ps(&s[24]), vol));
+		}
+		_mm256_storeu_ps(&d[n + 0], acc[0]);
+		_mm256_storeu_ps(&d[n + 8], acc[1]);
+		_mm256_storeu_ps(&d[n + 16], acc[2]);
+		_mm256_storeu_ps(&d[n + 24], acc[3]);
+	}
+	for (; n < n_bytes; n++) {
+		v = gain[0];
+		t = ((const float *) src[0])[n] * v;
+		for (j = 1; j < n_src; j++) {
+			v = gain[j];
+			t += ((const float *) src[j])[n] * v;
+		}
+		d[n] = t;
+	}
+}
+
+void spa_audiomixer_get_ops_avx2(struct spa_audiomixer_ops *ops)
+{
+	ops->add[FMT_S16] = add_s16_avx2;
+	ops->add[FMT_F32] = add_f32_avx2;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_avx2;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_avx2;
+	ops->add_scale[FMT_S16] = add_scale_s16_avx2;
+	ops->add_scale[FMT_F32] = add_scale_f32_avx2;
+	ops->mix[FMT_S16] = mix_s16_avx2;
+	ops->mix[FMT_F32] = mix_f32_avx2;
+}
@@ -0,0 +1,281 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "mix-ops.h"
+
+#include <arm_neon.h>
+
+static void
+add_s16_neon(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, unrolled;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	unrolled = n_bytes & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		int16x8_t in[2];
+
+		in[0] = vqaddq_s16(vld1q_s16(&s[n + 0]), vld1q_s16(&d[n + 0]));
+		in[1] = vqaddq_s16(vld1q_s16(&s[n + 8]), vld1q_s16(&d[n + 8]));
+		vst1q_s16(&d[n + 0], in[0]);
+		vst1q_s16(&d[n + 8], in[1]);
+	}
+	for (; n < n_bytes; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+copy_scale_s16_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11), t;
+	int n = 0, unrolled;
+
+	n_bytes /= sizeof(int16_t);
+
+	/* the widening multiply needs the fixed point volume to fit in 16 bits */
+	if (v >= INT16_MIN && v <= INT16_MAX) {
+		int16x4_t vol = vdup_n_s16(v);
+
+		unrolled = n_bytes & ~7;
+		for (; n < unrolled; n += 8) {
+			int16x8_t in = vld1q_s16(&s[n]);
+			int32x4_t lo = vshrq_n_s32(vmull_s16(vget_low_s16(in), vol), 11);
+			int32x4_t hi = vshrq_n_s32(vmull_s16(vget_high_s16(in), vol), 11);
+			vst1q_s16(&d[n], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+		}
+	}
+	for (; n < n_bytes; n++) {
+		t = (s[n] * v) >> 11;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_s16_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11), t;
+	int n = 0, unrolled;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (v >= INT16_MIN && v <= INT16_MAX) {
+		int16x4_t vol = vdup_n_s16(v);
+
+		unrolled = n_bytes & ~7;
+		for (; n < unrolled; n += 8) {
+			int16x8_t in = vld1q_s16(&s[n]);
+			int16x8_t out = vld1q_s16(&d[n]);
+			int32x4_t lo = vshrq_n_s32(vmull_s16(vget_low_s16(in), vol), 11);
+			int32x4_t hi = vshrq_n_s32(vmull_s16(vget_high_s16(in), vol), 11);
+
+			lo = vaddq_s32(lo, vmovl_s16(vget_low_s16(out)));
+			hi = vaddq_s32(hi, vmovl_s16(vget_high_s16(out)));
+			vst1q_s16(&d[n], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+		}
+	}
+	for (; n < n_bytes; n++) {
+		t = d[n] + ((s[n] * v) >> 11);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_neon(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		vst1q_f32(&d[n + 0], vaddq_f32(vld1q_f32(&s[n + 0]), vld1q_f32(&d[n + 0])));
+		vst1q_f32(&d[n + 4], vaddq_f32(vld1q_f32(&s[n + 4]), vld1q_f32(&d[n + 4])));
+	}
+	for (; n < n_bytes; n++)
+		d[n] += s[n];
+}
+
+static void
+copy_scale_f32_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		vst1q_f32(&d[n + 0], vmulq_n_f32(vld1q_f32(&s[n + 0]), v));
+		vst1q_f32(&d[n + 4], vmulq_n_f32(vld1q_f32(&s[n + 4]), v));
+	}
+	for (; n < n_bytes; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_f32_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~7;
+
+	/* separate multiply and add, vmlaq_f32 can be fused on aarch64 and
+	 * would round differently than the C version */
+	for (n = 0; n < unrolled; n += 8) {
+		float32x4_t in[2];
+
+		in[0] = vmulq_n_f32(vld1q_f32(&s[n + 0]), v);
+		in[1] = vmulq_n_f32(vld1q_f32(&s[n + 4]), v);
+		vst1q_f32(&d[n + 0], vaddq_f32(in[0], vld1q_f32(&d[n + 0])));
+		vst1q_f32(&d[n + 4], vaddq_f32(in[1], vld1q_f32(&d[n + 4])));
+	}
+	for (; n < n_bytes; n++)
+		d[n] += s[n] * v;
+}
+
+static void
+mix_s16_neon(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t acc[MIX_BLOCK_SIZE] SPA_ALIGNED(16), v, t;
+	int n, i, len, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(int16_t));
+		return;
+	}
+	for (n = 0; n < n_bytes; n += len) {
+		len = SPA_MIN(n_bytes - n, MIX_BLOCK_SIZE);
+		unrolled = len & ~7;
+
+		memset(acc, 0, len * sizeof(int32_t));
+		for (j = 0; j < n_src; j++) {
+			const int16_t *s = (const int16_t *) src[j] + n;
+
+			v = gain[j] * (1 << 11);
+
+			for (i = 0; i < unrolled; i += 8) {
+				int16x8_t in = vld1q_s16(&s[i]);
+				int32x4_t lo = vmulq_n_s32(vmovl_s16(vget_low_s16(in)), v);
+				int32x4_t hi = vmulq_n_s32(vmovl_s16(vget_high_s16(in)), v);
+
+				vst1q_s32(&acc[i + 0], vaddq_s32(vld1q_s32(&acc[i + 0]), vshrq_n_s32(lo, 11)));
+				vst1q_s32(&acc[i + 4], vaddq_s32(vld1q_s32(&acc[i + 4]), vshrq_n_s32(hi, 11)));
+			}
+			for (; i < len; i++)
+				acc[i] += (s[i] * v) >> 11;
+		}
+		for (i = 0; i < unrolled; i += 8) {
+			int16x4_t lo = vqmovn_s32(vld1q_s32(&acc[i + 0]));
+			int16x4_t hi = vqmovn_s32(vld1q_s32(&acc[i + 4]));
+			vst1q_s16(&d[n + i], vcombine_s16(lo, hi));
+		}
+		for (; i < len; i++) {
+			t = acc[i];
+			d[n + i] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		}
+	}
+}
+
+static void
+mix_f32_neon(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float v, t;
+	int n, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(float);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(float));
+		return;
+	}
+	unrolled = n_bytes & ~15;
+
+	/* keep 16 samples of the sum in registers while all sources are
+	 * added, dst is written once and never read */
+	for (n = 0; n < unrolled; n += 16) {
+		const float *s = (const float *) src[0] + n;
+		float32x4_t acc[4];
+
+		v = gain[0];
+		acc[0] = vmulq_n_f32(vld1q_f32(&s[0]), v);
+		acc[1] = vmulq_n_f32(vld1q_f32(&s[4]), v);
+		acc[2] = vmulq_n_f32(vld1q_f32(&s[8]), v);
+		acc[3] = vmulq_n_f32(vld1q_f32(&s[12]), v);
+
+		for (j = 1; j < n_src; j++) {
+			s = (const float *) src[j] + n;
+			v = gain[j];
+
+			acc[0] = vaddq_f32(acc[0], vmulq_n_f32(vld1q_f32(&s[0]), v));
+			acc[1] = vaddq_f32(acc[1], vmulq_n_f32(vld1q_f32(&s[4]), v));
+			acc[2] = vaddq_f32(acc[2], vmulq_n_f32(vld1q_f32(&s[8]), v));
+			acc[3] = vaddq_f32(acc[3], vmulq_n_f32(vld1q_f32(&s[12]), v));
+		}
+		vst1q_f32(&d[n + 0], acc[0]);
+		vst1q_f32(&d[n + 4], acc[1]);
+		vst1q_f32(&d[n + 8], acc[2]);
+		vst1q_f32(&d[n + 12], acc[3]);
+	}
+	for (; n < n_bytes; n++) {
+		v = gain[0];
+		t = ((const float *) src[0])[n] * v;
+		for (j = 1; j < n_src; j++) {
+			v = gain[j];
+			t += ((const float *) src[j])[n] * v;
+		}
+		d[n] = t;
+	}
+}
+
+void spa_audiomixer_get_ops_neon(struct spa_audiomixer_ops *ops)
+{
+	ops->add[FMT_S16] = add_s16_neon;
+	ops->add[FMT_F32] = add_f32_neon;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_neon;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_neon;
+	ops->add_scale[FMT_S16] = add_scale_s16_neon;
+	ops->add_scale[FMT_F32] = add_scale_f32_neon;
+	ops->mix[FMT_S16] = mix_s16_neon;
+	ops->mix[FMT_F32] = mix_f32_neon;
+}
@@ -0,0 +1,321 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include "mix-ops.h"
+
+#include <emmintrin.h>
+
+static void
+add_s16_sse2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, unrolled;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	unrolled = n_bytes & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		__m128i in[2];
+
+		in[0] = _mm_loadu_si128((const __m128i *)&s[n + 0]);
+		in[1] = _mm_loadu_si128((const __m128i *)&s[n + 8]);
+		in[0] = _mm_adds_epi16(in[0], _mm_loadu_si128((const __m128i *)&d[n + 0]));
+		in[1] = _mm_adds_epi16(in[1], _mm_loadu_si128((const __m128i *)&d[n + 8]));
+		_mm_storeu_si128((__m128i *)&d[n + 0], in[0]);
+		_mm_storeu_si128((__m128i *)&d[n + 8], in[1]);
+	}
+	for (; n < n_bytes; n++) {
+		t = d[n] + s[n];
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static inline __m128i
+scale_lo_s16_sse2(__m128i in, __m128i vol)
+{
+	__m128i lo = _mm_mullo_epi16(in, vol);
+	__m128i hi = _mm_mulhi_epi16(in, vol);
+	return _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 11);
+}
+
+static inline __m128i
+scale_hi_s16_sse2(__m128i in, __m128i vol)
+{
+	__m128i lo = _mm_mullo_epi16(in, vol);
+	__m128i hi = _mm_mulhi_epi16(in, vol);
+	return _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 11);
+}
+
+static void
+copy_scale_s16_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11), t;
+	int n = 0, unrolled;
+
+	n_bytes /= sizeof(int16_t);
+
+	/* the 16 bit multiply needs the fixed point volume to fit in 16 bits */
+	if (v >= INT16_MIN && v <= INT16_MAX) {
+		__m128i vol = _mm_set1_epi16(v);
+
+		unrolled = n_bytes & ~7;
+		for (; n < unrolled; n += 8) {
+			__m128i in = _mm_loadu_si128((const __m128i *)&s[n]);
+			__m128i out = _mm_packs_epi32(scale_lo_s16_sse2(in, vol),
+						      scale_hi_s16_sse2(in, vol));
+			_mm_storeu_si128((__m128i *)&d[n], out);
+		}
+	}
+	for (; n < n_bytes; n++) {
+		t = (s[n] * v) >> 11;
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_scale_s16_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11), t;
+	int n = 0, unrolled;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (v >= INT16_MIN && v <= INT16_MAX) {
+		__m128i vol = _mm_set1_epi16(v);
+
+		unrolled = n_bytes & ~7;
+		for (; n < unrolled; n += 8) {
+			__m128i in = _mm_loadu_si128((const __m128i *)&s[n]);
+			__m128i out = _mm_loadu_si128((const __m128i *)&d[n]);
+			__m128i lo, hi;
+
+			/* sign extend the destination to 32 bits before adding */
+			lo = _mm_srai_epi32(_mm_unpacklo_epi16(out, out), 16);
+			hi = _mm_srai_epi32(_mm_unpackhi_epi16(out, out), 16);
+			lo = _mm_add_epi32(lo, scale_lo_s16_sse2(in, vol));
+			hi = _mm_add_epi32(hi, scale_hi_s16_sse2(in, vol));
+			_mm_storeu_si128((__m128i *)&d[n], _mm_packs_epi32(lo, hi));
+		}
+	}
+	for (; n < n_bytes; n++) {
+		t = d[n] + ((s[n] * v) >> 11);
+		d[n] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+	}
+}
+
+static void
+add_f32_sse2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		__m128 in[2];
+
+		in[0] = _mm_loadu_ps(&s[n + 0]);
+		in[1] = _mm_loadu_ps(&s[n + 4]);
+		in[0] = _mm_add_ps(in[0], _mm_loadu_ps(&d[n + 0]));
+		in[1] = _mm_add_ps(in[1], _mm_loadu_ps(&d[n + 4]));
+		_mm_storeu_ps(&d[n + 0], in[0]);
+		_mm_storeu_ps(&d[n + 4], in[1]);
+	}
+	for (; n < n_bytes; n++)
+		d[n] += s[n];
+}
+
+static void
+copy_scale_f32_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	__m128 vol = _mm_set1_ps(v);
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		_mm_storeu_ps(&d[n + 0], _mm_mul_ps(_mm_loadu_ps(&s[n + 0]), vol));
+		_mm_storeu_ps(&d[n + 4], _mm_mul_ps(_mm_loadu_ps(&s[n + 4]), vol));
+	}
+	for (; n < n_bytes; n++)
+		d[n] = s[n] * v;
+}
+
+static void
+add_scale_f32_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = scale;
+	__m128 vol = _mm_set1_ps(v);
+	int n, unrolled;
+
+	n_bytes /= sizeof(float);
+	unrolled = n_bytes & ~7;
+
+	for (n = 0; n < unrolled; n += 8) {
+		__m128 in[2];
+
+		in[0] = _mm_mul_ps(_mm_loadu_ps(&s[n + 0]), vol);
+		in[1] = _mm_mul_ps(_mm_loadu_ps(&s[n + 4]), vol);
+		in[0] = _mm_add_ps(in[0], _mm_loadu_ps(&d[n + 0]));
+		in[1] = _mm_add_ps(in[1], _mm_loadu_ps(&d[n + 4]));
+		_mm_storeu_ps(&d[n + 0], in[0]);
+		_mm_storeu_ps(&d[n + 4], in[1]);
+	}
+	for (; n < n_bytes; n++)
+		d[n] += s[n] * v;
+}
+
+static void
+mix_s16_sse2(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t acc[MIX_BLOCK_SIZE] SPA_ALIGNED(16), v, t;
+	int n, i, len, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(int16_t));
+		return;
+	}
+	for (n = 0; n < n_bytes; n += len) {
+		len = SPA_MIN(n_bytes - n, MIX_BLOCK_SIZE);
+		unrolled = len & ~7;
+
+		for (j = 0; j < n_src; j++) {
+			const int16_t *s = (const int16_t *) src[j] + n;
+
+			v = gain[j] * (1 << 11);
+			i = 0;
+			if (v >= INT16_MIN && v <= INT16_MAX) {
+				__m128i vol = _mm_set1_epi16(v);
+
+				for (; i < unrolled; i += 8) {
+					__m128i in = _mm_loadu_si128((const __m128i *)&s[i]);
+					__m128i lo = scale_lo_s16_sse2(in, vol);
+					__m128i hi = scale_hi_s16_sse2(in, vol);
+
+					if (j > 0) {
+						lo = _mm_add_epi32(lo, _mm_load_si128((__m128i *)&acc[i + 0]));
+						hi = _mm_add_epi32(hi, _mm_load_si128((__m128i *)&acc[i + 4]));
+					}
+					_mm_store_si128((__m128i *)&acc[i + 0], lo);
+					_mm_store_si128((__m128i *)&acc[i + 4], hi);
+				}
+			}
+			if (j == 0) {
+				for (; i < len; i++)
+					acc[i] = (s[i] * v) >> 11;
+			} else {
+				for (; i < len; i++)
+					acc[i] += (s[i] * v) >> 11;
+			}
+		}
+		for (i = 0; i < unrolled; i += 8) {
+			__m128i lo = _mm_load_si128((__m128i *)&acc[i + 0]);
+			__m128i hi = _mm_load_si128((__m128i *)&acc[i + 4]);
+			_mm_storeu_si128((__m128i *)&d[n + i], _mm_packs_epi32(lo, hi));
+		}
+		for (; i < len; i++) {
+			t = acc[i];
+			d[n + i] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		}
+	}
+}
+
+static void
+mix_f32_sse2(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float v, t;
+	int n, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(float);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(float));
+		return;
+	}
+	unrolled = n_bytes & ~15;
+
+	/* keep 16 samples of the sum in registers while all sources are
+	 * added, dst is written once and never read */
+	for (n = 0; n < unrolled; n += 16) {
+		const float *s = (const float *) src[0] + n;
+		__m128 vol = _mm_set1_ps(gain[0]);
+		__m128 acc[4];
+
+		acc[0] = _mm_mul_ps(_mm_loadu_ps(&s[0]), vol);
+		acc[1] = _mm_mul_ps(_mm_loadu_ps(&s[4]), vol);
+		acc[2] = _mm_mul_ps(_mm_loadu_ps(&s[8]), vol);
+		acc[3] = _mm_mul_ps(_mm_loadu_ps(&s[12]), vol);
+
+		for (j = 1; j < n_src; j++) {
+			s = (const float *) src[j] + n;
+			vol = _mm_set1_ps(gain[j]);
+
+			acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(_mm_loadu_ps(&s[0]), vol));
+			acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(_mm_loadu_ps(&s[4]), vol));
+			acc[2] = _mm_add_ps(acc[2], _mm_mul_ps(_mm_loadu_ps(&s[8]), vol));
+			acc[3] = _mm_add_ps(acc[3], _mm_mul_ps(_mm_loadu_ps(&s[12]), vol));
+		}
+		_mm_storeu_ps(&d[n + 0], acc[0]);
+		_mm_storeu_ps(&d[n + 4], acc[1]);
+		_mm_storeu_ps(&d[n + 8], acc[2]);
+		_mm_storeu_ps(&d[n + 12], acc[3]);
+	}
+	for (; n < n_bytes; n++) {
+		v = gain[0];
+		t = ((const float *) src[0])[n] * v;
+		for (j = 1; j < n_src; j++) {
+			v = gain[j];
+			t += ((const float *) src[j])[n] * v;
+		}
+		d[n] = t;
+	}
+}
+
+void spa_audiomixer_get_ops_sse2(struct spa_audiomixer_ops *ops)
+{
+	ops->add[FMT_S16] = add_s16_sse2;
+	ops->add[FMT_F32] = add_f32_sse2;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_sse2;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_sse2;
+	ops->add_scale[FMT_S16] = add_scale_s16_sse2;
+	ops->add_scale[FMT_F32] = add_scale_f32_sse2;
+	ops->mix[FMT_S16] = mix_s16_sse2;
+	ops->mix[FMT_F32] = mix_f32_sse2;
+}
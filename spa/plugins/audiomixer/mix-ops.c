@@ -255,24 +255,146 @@ add_scale_f32_i(void *dst, int dst_stride, const void *src, int src_stride, cons
 	}
 }
 
-void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops)
+static void
+mix_s16(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	int16_t *d = dst;
+	int32_t acc[MIX_BLOCK_SIZE], v, t;
+	int n, i, len;
+	uint32_t j;
+
+	n_bytes /= sizeof(int16_t);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(int16_t));
+		return;
+	}
+	/* accumulate a block of all sources in 32 bits and clamp only once
+	 * when writing to dst */
+	for (n = 0; n < n_bytes; n += len) {
+		len = SPA_MIN(n_bytes - n, MIX_BLOCK_SIZE);
+
+		for (j = 0; j < n_src; j++) {
+			const int16_t *s = (const int16_t *) src[j] + n;
+
+			v = gain[j] * (1 << 11);
+			if (j == 0) {
+				for (i = 0; i < len; i++)
+					acc[i] = (s[i] * v) >> 11;
+			} else {
+				for (i = 0; i < len; i++)
+					acc[i] += (s[i] * v) >> 11;
+			}
+		}
+		for (i = 0; i < len; i++) {
+			t = acc[i];
+			d[n + i] = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		}
+	}
+}
+
+static void
+mix_f32(void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	float *d = dst;
+	float acc[8], v;
+	int n, i, unrolled;
+	uint32_t j;
+
+	n_bytes /= sizeof(float);
+
+	if (n_src == 0) {
+		memset(d, 0, n_bytes * sizeof(float));
+		return;
+	}
+	unrolled = n_bytes & ~7;
+
+	/* sum all sources for a few samples in registers and write dst once */
+	for (n = 0; n < unrolled; n += 8) {
+		const float *s = (const float *) src[0] + n;
+
+		v = gain[0];
+		for (i = 0; i < 8; i++)
+			acc[i] = s[i] * v;
+		for (j = 1; j < n_src; j++) {
+			s = (const float *) src[j] + n;
+			v = gain[j];
+			for (i = 0; i < 8; i++)
+				acc[i] += s[i] * v;
+		}
+		for (i = 0; i < 8; i++)
+			d[n + i] = acc[i];
+	}
+	for (; n < n_bytes; n++) {
+		v = gain[0];
+		acc[0] = ((const float *) src[0])[n] * v;
+		for (j = 1; j < n_src; j++) {
+			v = gain[j];
+			acc[0] += ((const float *) src[j])[n] * v;
+		}
+		d[n] = acc[0];
+	}
+}
+
+static void get_ops_c(struct spa_audiomixer_ops *ops)
 {
 	ops->clear[FMT_S16] = clear_s16;
 	ops->clear[FMT_F32] = clear_f32;
 	ops->copy[FMT_S16] = copy_s16;
 	ops->copy[FMT_F32] = copy_f32;
-        ops->add[FMT_S16] = add_s16;
-        ops->add[FMT_F32] = add_f32;
-        ops->copy_scale[FMT_S16] = copy_scale_s16;
-        ops->copy_scale[FMT_F32] = copy_scale_f32;
-        ops->add_scale[FMT_S16] = add_scale_s16;
-        ops->add_scale[FMT_F32] = add_scale_f32;
-        ops->copy_i[FMT_S16] = copy_s16_i;
-        ops->copy_i[FMT_F32] = copy_f32_i;
-        ops->add_i[FMT_S16] = add_s16_i;
-        ops->add_i[FMT_F32] = add_f32_i;
-        ops->copy_scale_i[FMT_S16] = copy_scale_s16_i;
-        ops->copy_scale_i[FMT_F32] = copy_scale_f32_i;
-        ops->add_scale_i[FMT_S16] = add_scale_s16_i;
-        ops->add_scale_i[FMT_F32] = add_scale_f32_i;
+	ops->add[FMT_S16] = add_s16;
+	ops->add[FMT_F32] = add_f32;
+	ops->copy_scale[FMT_S16] = copy_scale_s16;
+	ops->copy_scale[FMT_F32] = copy_scale_f32;
+	ops->add_scale[FMT_S16] = add_scale_s16;
+	ops->add_scale[FMT_F32] = add_scale_f32;
+	ops->copy_i[FMT_S16] = copy_s16_i;
+	ops->copy_i[FMT_F32] = copy_f32_i;
+	ops->add_i[FMT_S16] = add_s16_i;
+	ops->add_i[FMT_F32] = add_f32_i;
+	ops->copy_scale_i[FMT_S16] = copy_scale_s16_i;
+	ops->copy_scale_i[FMT_F32] = copy_scale_f32_i;
+	ops->add_scale_i[FMT_S16] = add_scale_s16_i;
+	ops->add_scale_i[FMT_F32] = add_scale_f32_i;
+	ops->mix[FMT_S16] = mix_s16;
+	ops->mix[FMT_F32] = mix_f32;
+}
+
+uint32_t spa_audiomixer_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+#if defined (HAVE_SSE2)
+	flags |= SPA_CPU_FLAG_SSE2;
+#endif
+#if defined (HAVE_AVX2)
+	flags |= SPA_CPU_FLAG_AVX2;
+#endif
+#if defined (HAVE_NEON)
+	flags |= SPA_CPU_FLAG_NEON;
+#endif
+	return spa_cpu_get_flags() & flags;
+}
+
+void spa_audiomixer_get_ops_for_cpu(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	/* start with the C versions and let each SIMD level override what it
+	 * implements, from least to most capable */
+	get_ops_c(ops);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_audiomixer_get_ops_sse2(ops);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		spa_audiomixer_get_ops_avx2(ops);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_audiomixer_get_ops_neon(ops);
+#endif
+}
+
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops)
+{
+	spa_audiomixer_get_ops_for_cpu(ops, spa_audiomixer_get_cpu_flags());
 }
@@ -21,6 +21,7 @@
 #include <stdio.h>
 
 #include <spa/utils/defs.h>
+#include <spa/support/cpu.h>
 
 typedef void (*mix_clear_func_t) (void *dst, int n_bytes);
 typedef void (*mix_func_t) (void *dst, const void *src, int n_bytes);
@@ -29,6 +30,14 @@ typedef void (*mix_i_func_t) (void *dst, int dst_stride,
 			      const void *src, int src_stride, int n_bytes);
 typedef void (*mix_scale_i_func_t) (void *dst, int dst_stride,
 				    const void *src, int src_stride, const double scale, int n_bytes);
+/* mix \a n_src sources, each multiplied with its gain, into \a dst.
+ * \a dst is only written once, with 0 sources it is cleared */
+typedef void (*mix_n_func_t) (void *dst, const void *src[], const double gain[],
+			      uint32_t n_src, int n_bytes);
+
+/* number of s16 samples summed in a 32 bit accumulator per pass over
+ * all sources */
+#define MIX_BLOCK_SIZE	256
 
 enum {
 	FMT_S16,
@@ -46,6 +55,25 @@ struct spa_audiomixer_ops {
 	mix_i_func_t add_i[FMT_MAX];
 	mix_scale_i_func_t copy_scale_i[FMT_MAX];
 	mix_scale_i_func_t add_scale_i[FMT_MAX];
+	mix_n_func_t mix[FMT_MAX];
 };
 
+/** get the SIMD features of the running CPU that have an optimized
+ * implementation compiled in, a mask of SPA_CPU_FLAG_* */
+uint32_t spa_audiomixer_get_cpu_flags(void);
+
+/** fill \a ops with the best functions for the given cpu flags */
+void spa_audiomixer_get_ops_for_cpu(struct spa_audiomixer_ops *ops, uint32_t cpu_flags);
+
+/** fill \a ops with the best functions for the running CPU */
 void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops);
+
+#if defined (HAVE_SSE2)
+void spa_audiomixer_get_ops_sse2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined (HAVE_AVX2)
+void spa_audiomixer_get_ops_avx2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined (HAVE_NEON)
+void spa_audiomixer_get_ops_neon(struct spa_audiomixer_ops *ops);
+#endif
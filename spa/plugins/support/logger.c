@@ -18,10 +18,13 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/eventfd.h>
 
 #include <spa/support/type-map.h>
@@ -36,6 +39,12 @@
 
 #define TRACE_BUFFER (16*1024)
 
+/* binary trace messages go to one ring per thread so that the writers
+ * never share a ringbuffer */
+#define MAX_TRACE_RINGS	8
+#define MAX_TRACE_ENTRY	512
+#define MAX_TRACE_STRING	128
+
 struct type {
 	uint32_t log;
 };
@@ -45,6 +54,46 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->log = spa_type_map_get_id(map, SPA_TYPE__Log);
 }
 
+/* a binary trace message, the raw arguments follow the header and are
+ * formatted later in the main loop with the same format string */
+struct trace_entry {
+	uint32_t size;			/**< size of header and arguments, 8 aligned */
+	int32_t line;
+	uint64_t time;
+	const char *file;
+	const char *func;
+	const char *fmt;
+};
+
+struct trace_ring {
+	pthread_t owner;
+	int used;
+	uint32_t dropped;
+	struct spa_ringbuffer rb;
+	uint8_t data[TRACE_BUFFER];
+};
+
+enum arg_type {
+	ARG_INVALID,
+	ARG_PERCENT,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_INTMAX,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_POINTER,
+	ARG_STRING,
+};
+
+struct arg_spec {
+	enum arg_type type;
+	int n_star;			/**< number of * width and precision args */
+	int precision;			/**< precision, -1 when not given and -2 when
+					  *  it is the last * arg */
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_log log;
@@ -55,10 +104,297 @@ struct impl {
 	struct spa_ringbuffer trace_rb;
 	uint8_t trace_data[TRACE_BUFFER];
 
+	bool binary_trace;
+	struct trace_ring rings[MAX_TRACE_RINGS];
+
 	bool have_source;
 	struct spa_source source;
 };
 
+static __thread struct {
+	struct impl *impl;
+	struct trace_ring *ring;
+} thread_ring;
+
+/* parse the conversion specification after the % in @p, returns a pointer
+ * to the character after the conversion */
+static const char *parse_spec(const char *p, struct arg_spec *spec)
+{
+	int length = 0;
+
+	spec->type = ARG_INVALID;
+	spec->n_star = 0;
+	spec->precision = -1;
+
+	if (*p == '%') {
+		spec->type = ARG_PERCENT;
+		return p + 1;
+	}
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		spec->n_star++;
+		p++;
+	}
+	while (*p >= '0' && *p <= '9')
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->n_star++;
+			spec->precision = -2;
+			p++;
+		} else {
+			spec->precision = 0;
+			while (*p >= '0' && *p <= '9')
+				spec->precision = SPA_MIN(spec->precision * 10 + (*p++ - '0'),
+							  MAX_TRACE_STRING);
+		}
+	}
+	switch (*p) {
+	case 'h':
+		p += p[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		length = p[1] == 'l' ? ARG_LLONG : ARG_LONG;
+		p += length == ARG_LLONG ? 2 : 1;
+		break;
+	case 'q':
+		length = ARG_LLONG;
+		p++;
+		break;
+	case 'z':
+		length = ARG_SIZE;
+		p++;
+		break;
+	case 'j':
+		length = ARG_INTMAX;
+		p++;
+		break;
+	case 't':
+		length = ARG_PTRDIFF;
+		p++;
+		break;
+	case 'L':
+		/* long double is not supported */
+		return p;
+	}
+	switch (*p) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		spec->type = length ? length : ARG_INT;
+		break;
+	case 'c':
+		if (length == 0)
+			spec->type = ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		spec->type = ARG_DOUBLE;
+		break;
+	case 's':
+		if (length == 0)
+			spec->type = ARG_STRING;
+		break;
+	case 'p':
+		spec->type = ARG_POINTER;
+		break;
+	default:
+		/* %n, %m and wide characters are not supported */
+		return p;
+	}
+	return p + 1;
+}
+
+static inline bool put_arg(uint8_t *buffer, uint32_t *size, const void *data, uint32_t len)
+{
+	if (*size + SPA_ROUND_UP_N(len, 8) > MAX_TRACE_ENTRY)
+		return false;
+	memcpy(buffer + *size, data, len);
+	*size += SPA_ROUND_UP_N(len, 8);
+	return true;
+}
+
+/* copy the arguments of @fmt from @args into @buffer after the header,
+ * strings are copied because they might not be valid anymore when the
+ * message is formatted */
+static bool encode_args(uint8_t *buffer, uint32_t *size, const char *fmt, va_list args)
+{
+	struct arg_spec spec;
+	const char *p = fmt;
+	int64_t star = 0;
+	int i;
+
+	while ((p = strchr(p, '%')) != NULL) {
+		p = parse_spec(p + 1, &spec);
+
+		for (i = 0; i < spec.n_star; i++) {
+			star = va_arg(args, int);
+			if (!put_arg(buffer, size, &star, sizeof(star)))
+				return false;
+		}
+		/* a negative * precision is taken as if it was not given */
+		if (spec.precision == -2)
+			spec.precision = star < 0 ? -1 : (int) SPA_MIN(star, MAX_TRACE_STRING);
+
+		switch (spec.type) {
+		case ARG_INVALID:
+			return false;
+		case ARG_PERCENT:
+			break;
+		case ARG_DOUBLE:
+		{
+			double v = va_arg(args, double);
+			if (!put_arg(buffer, size, &v, sizeof(v)))
+				return false;
+			break;
+		}
+		case ARG_POINTER:
+		{
+			void *v = va_arg(args, void *);
+			if (!put_arg(buffer, size, &v, sizeof(v)))
+				return false;
+			break;
+		}
+		case ARG_STRING:
+		{
+			const char *str = va_arg(args, const char *);
+			uint32_t len, max = MAX_TRACE_STRING - 1;
+			int64_t v;
+
+			/* with a precision, the string does not need to be
+			 * terminated, never read more than the precision */
+			if (spec.precision >= 0)
+				max = SPA_MIN((uint32_t) spec.precision, max);
+			len = str ? strnlen(str, max) : 0;
+			v = str ? (int64_t) len : -1;
+
+			if (!put_arg(buffer, size, &v, sizeof(v)))
+				return false;
+			if (str == NULL)
+				break;
+			if (*size + len + 1 > MAX_TRACE_ENTRY)
+				return false;
+			memcpy(buffer + *size, str, len);
+			buffer[*size + len] = '\0';
+			*size += SPA_ROUND_UP_N(len + 1, 8);
+			break;
+		}
+		default:
+		{
+			int64_t v;
+			switch (spec.type) {
+			case ARG_LONG:
+				v = va_arg(args, long);
+				break;
+			case ARG_LLONG:
+				v = va_arg(args, long long);
+				break;
+			case ARG_SIZE:
+				v = va_arg(args, size_t);
+				break;
+			case ARG_INTMAX:
+				v = va_arg(args, intmax_t);
+				break;
+			case ARG_PTRDIFF:
+				v = va_arg(args, ptrdiff_t);
+				break;
+			default:
+				v = va_arg(args, int);
+				break;
+			}
+			if (!put_arg(buffer, size, &v, sizeof(v)))
+				return false;
+			break;
+		}
+		}
+	}
+	return true;
+}
+
+static struct trace_ring *get_ring(struct impl *impl)
+{
+	pthread_t self = pthread_self();
+	struct trace_ring *ring;
+	int i;
+
+	/* the ring is owned by this thread until the logger is cleared */
+	if (SPA_LIKELY(thread_ring.impl == impl &&
+		       (thread_ring.ring == NULL ||
+			(__atomic_load_n(&thread_ring.ring->used, __ATOMIC_RELAXED) > 0 &&
+			 pthread_equal(thread_ring.ring->owner, self)))))
+		return thread_ring.ring;
+
+	for (i = 0, ring = NULL; i < MAX_TRACE_RINGS && ring == NULL; i++) {
+		if (__atomic_load_n(&impl->rings[i].used, __ATOMIC_ACQUIRE) &&
+		    pthread_equal(impl->rings[i].owner, self))
+			ring = &impl->rings[i];
+	}
+	for (i = 0; i < MAX_TRACE_RINGS && ring == NULL; i++) {
+		int expected = 0;
+		if (__atomic_compare_exchange_n(&impl->rings[i].used, &expected, -1, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			ring = &impl->rings[i];
+			ring->owner = self;
+			__atomic_store_n(&ring->used, 1, __ATOMIC_RELEASE);
+		}
+	}
+	thread_ring.impl = impl;
+	thread_ring.ring = ring;
+
+	return ring;
+}
+
+/* write the message in binary form to the ring of this thread, returns
+ * false when the message could not be encoded and should be formatted
+ * right away */
+static bool
+write_binary_trace(struct impl *impl, const char *file, int line, const char *func,
+		   const char *fmt, va_list args)
+{
+	uint64_t buffer[MAX_TRACE_ENTRY / sizeof(uint64_t)];
+	struct trace_entry *e = (struct trace_entry *) buffer;
+	struct trace_ring *ring;
+	struct timespec now;
+	uint32_t index, size = sizeof(struct trace_entry);
+	int32_t filled;
+	va_list copy;
+	bool res;
+
+	if ((ring = get_ring(impl)) == NULL)
+		return false;
+
+	va_copy(copy, args);
+	res = encode_args((uint8_t *) buffer, &size, fmt, copy);
+	va_end(copy);
+	if (!res)
+		return false;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	e->size = size;
+	e->line = line;
+	e->time = SPA_TIMESPEC_TO_TIME(&now);
+	e->file = file;
+	e->func = func;
+	e->fmt = fmt;
+
+	filled = spa_ringbuffer_get_write_index(&ring->rb, &index);
+	if (filled + size > TRACE_BUFFER) {
+		__atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+		return true;
+	}
+	spa_ringbuffer_write_data(&ring->rb, ring->data, TRACE_BUFFER,
+				  index & (TRACE_BUFFER - 1), buffer, size);
+	spa_ringbuffer_write_update(&ring->rb, index + size);
+
+	/* the main loop drains the ring completely, only wake it up when
+	 * it was empty */
+	if (filled == 0) {
+		uint64_t count = 1;
+		if (write(impl->source.fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+			fprintf(stderr, "error signaling eventfd: %s\n", strerror(errno));
+	}
+	return true;
+}
+
 static void
 impl_log_logv(struct spa_log *log,
 	      enum spa_log_level level,
@@ -74,8 +410,12 @@ impl_log_logv(struct spa_log *log,
 	int size;
 	bool do_trace;
 
-	if ((do_trace = (level == SPA_LOG_LEVEL_TRACE && impl->have_source)))
+	if ((do_trace = (level == SPA_LOG_LEVEL_TRACE && impl->have_source))) {
+		if (impl->binary_trace &&
+		    write_binary_trace(impl, file, line, func, fmt, args))
+			return;
 		level++;
+	}
 
 	vsnprintf(text, sizeof(text), fmt, args);
 	size = snprintf(location, sizeof(location), "[%s][%s:%i %s()] %s\n",
@@ -111,11 +451,160 @@ impl_log_log(struct spa_log *log,
 	va_end(args);
 }
 
+/* format the arguments that were encoded with encode_args() */
+static int decode_args(char *text, size_t size, const struct trace_entry *e)
+{
+	const uint8_t *args = SPA_MEMBER(e, sizeof(struct trace_entry), uint8_t);
+	const uint8_t *end = SPA_MEMBER(e, e->size, uint8_t);
+	const char *p = e->fmt, *s;
+	struct arg_spec spec;
+	char conv[32];
+	int64_t star[2];
+	size_t len = 0;
+	int i, res;
+
+#define APPEND(...)							\
+	res = snprintf(text + len, size - len, __VA_ARGS__);		\
+	if (res < 0 || (len += res) >= size)				\
+		return size - 1;
+
+#define APPEND_ARG(value)						\
+	switch (spec.n_star) {						\
+	case 0:								\
+		APPEND(conv, value);					\
+		break;							\
+	case 1:								\
+		APPEND(conv, (int) star[0], value);			\
+		break;							\
+	default:							\
+		APPEND(conv, (int) star[0], (int) star[1], value);	\
+		break;							\
+	}
+
+	text[0] = '\0';
+	while ((s = strchr(p, '%')) != NULL) {
+		APPEND("%.*s", (int) (s - p), p);
+
+		p = parse_spec(s + 1, &spec);
+		if (spec.type == ARG_PERCENT) {
+			APPEND("%%");
+			continue;
+		}
+		if ((size_t) (p - s) >= sizeof(conv))
+			return len;
+		memcpy(conv, s, p - s);
+		conv[p - s] = '\0';
+
+		for (i = 0; i < spec.n_star; i++) {
+			memcpy(&star[i], args, sizeof(int64_t));
+			args += sizeof(int64_t);
+		}
+		if (args + sizeof(int64_t) > end)
+			return len;
+
+		switch (spec.type) {
+		case ARG_DOUBLE:
+		{
+			double v;
+			memcpy(&v, args, sizeof(v));
+			APPEND_ARG(v);
+			break;
+		}
+		case ARG_POINTER:
+		{
+			void *v;
+			memcpy(&v, args, sizeof(v));
+			APPEND_ARG(v);
+			break;
+		}
+		case ARG_STRING:
+		{
+			int64_t l;
+			memcpy(&l, args, sizeof(l));
+			if (l < 0) {
+				APPEND_ARG((const char *) NULL);
+			} else {
+				args += sizeof(int64_t);
+				APPEND_ARG((const char *) args);
+				args += SPA_ROUND_UP_N(l + 1, 8) - sizeof(int64_t);
+			}
+			break;
+		}
+		default:
+		{
+			int64_t v;
+			memcpy(&v, args, sizeof(v));
+			switch (spec.type) {
+			case ARG_LONG:
+				APPEND_ARG((long) v);
+				break;
+			case ARG_LLONG:
+				APPEND_ARG((long long) v);
+				break;
+			case ARG_SIZE:
+				APPEND_ARG((size_t) v);
+				break;
+			case ARG_INTMAX:
+				APPEND_ARG((intmax_t) v);
+				break;
+			case ARG_PTRDIFF:
+				APPEND_ARG((ptrdiff_t) v);
+				break;
+			default:
+				APPEND_ARG((int) v);
+				break;
+			}
+			break;
+		}
+		}
+		args += sizeof(int64_t);
+	}
+	APPEND("%s", p);
+
+#undef APPEND_ARG
+#undef APPEND
+	return len;
+}
+
+static void flush_binary_trace(struct impl *impl, struct trace_ring *ring)
+{
+	uint64_t buffer[MAX_TRACE_ENTRY / sizeof(uint64_t)];
+	struct trace_entry *e = (struct trace_entry *) buffer;
+	char text[1024];
+	uint32_t index, dropped;
+	int32_t avail;
+
+	while ((avail = spa_ringbuffer_get_read_index(&ring->rb, &index)) > 0) {
+		uint32_t offset = index & (TRACE_BUFFER - 1);
+
+		spa_ringbuffer_read_data(&ring->rb, ring->data, TRACE_BUFFER,
+					 offset, e, sizeof(uint32_t));
+		if (e->size < sizeof(struct trace_entry) || e->size > MAX_TRACE_ENTRY ||
+		    e->size > avail) {
+			fprintf(stderr, "invalid trace entry of size %u\n", e->size);
+			spa_ringbuffer_read_update(&ring->rb, index + avail);
+			break;
+		}
+		spa_ringbuffer_read_data(&ring->rb, ring->data, TRACE_BUFFER,
+					 offset, e, e->size);
+
+		decode_args(text, sizeof(text), e);
+		fprintf(stderr, "[*T*][%"PRIu64".%06u][%s:%i %s()] %s\n",
+			(uint64_t) (e->time / SPA_NSEC_PER_SEC),
+			(uint32_t) ((e->time % SPA_NSEC_PER_SEC) / SPA_NSEC_PER_USEC),
+			strrchr(e->file, '/') + 1, e->line, e->func, text);
+
+		spa_ringbuffer_read_update(&ring->rb, index + e->size);
+	}
+	if ((dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED)) > 0)
+		fprintf(stderr, "[*T*] %u trace messages dropped\n", dropped);
+}
+
 static void on_trace_event(struct spa_source *source)
 {
 	struct impl *impl = source->data;
 	int32_t avail;
-	uint32_t index;
+	uint32_t index, i;
 	uint64_t count;
 
 	if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
@@ -137,6 +626,11 @@ static void on_trace_event(struct spa_source *source)
 		}
 		spa_ringbuffer_read_update(&impl->trace_rb, index + avail);
         }
+
+	for (i = 0; i < MAX_TRACE_RINGS; i++) {
+		if (__atomic_load_n(&impl->rings[i].used, __ATOMIC_ACQUIRE) > 0)
+			flush_binary_trace(impl, &impl->rings[i]);
+	}
 }
 
 static const struct spa_log impl_log = {
@@ -167,12 +661,18 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *this;
+	uint32_t i;
 
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
 
 	this = (struct impl *) handle;
 
 	if (this->have_source) {
+		for (i = 0; i < MAX_TRACE_RINGS; i++) {
+			if (this->rings[i].used > 0)
+				flush_binary_trace(this, &this->rings[i]);
+			this->rings[i].used = 0;
+		}
 		spa_loop_remove_source(this->source.loop, &this->source);
 		close(this->source.fd);
 		this->have_source = false;
@@ -190,6 +690,7 @@ impl_init(const struct spa_handle_factory *factory,
 	struct impl *this;
 	uint32_t i;
 	struct spa_loop *loop = NULL;
+	const char *str;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -225,6 +726,12 @@ impl_init(const struct spa_handle_factory *factory,
 
 	spa_ringbuffer_init(&this->trace_rb);
 
+	if (info && (str = spa_dict_lookup(info, "log.binary-trace")) &&
+	    (strcmp(str, "true") == 0 || atoi(str) == 1))
+		this->binary_trace = true;
+	for (i = 0; i < MAX_TRACE_RINGS; i++)
+		spa_ringbuffer_init(&this->rings[i].rb);
+
 	spa_log_debug(&this->log, NAME " %p: initialized", this);
 
 	return 0;
@@ -28,29 +28,59 @@
 #include <sys/eventfd.h>
 #include <sys/signalfd.h>
 #include <pthread.h>
+#include <semaphore.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/support/type-map.h>
 #include <spa/support/plugin.h>
 #include <spa/utils/list.h>
+#include <spa/utils/dict.h>
 #include <spa/utils/ringbuffer.h>
 
+#ifdef HAVE_IO_URING
+#include "uring.h"
+#endif
+
 #define NAME "loop"
 
 #define DATAS_SIZE (4096 * 8)
 
 /** \cond */
 
+#ifdef HAVE_IO_URING
+#define URING_ENTRIES	256
+#define URING_MAX_CQES	64
+
+/* A poll request on the io_uring for a source. When the source is removed
+ * or updated while the request is pending, the request is cancelled and
+ * the entry is freed when its completion arrives. */
+struct poll_entry {
+	struct spa_list link;
+	struct spa_source *source;	/**< the source or NULL when cancelled */
+	bool armed;			/**< request pending in the kernel */
+};
+#endif
+
+/* completion of a blocking invoke, lives on the stack of the caller */
+struct invoke_done {
+	sem_t sem;
+	int res;
+};
+
+/* Items are reserved in the ringbuffer by atomically moving the write index
+ * so that any thread can queue them. The loop thread only handles items
+ * after their commit field is set and clears the memory of the items it
+ * handled, so that a new item never looks committed before it is. */
 struct invoke_item {
 	size_t item_size;
+	uint32_t commit;
 	spa_invoke_func_t func;
 	uint32_t seq;
 	void *data;
 	size_t size;
-	bool block;
+	struct invoke_done *done;
 	void *user_data;
-	int res;
 };
 
 struct type {
@@ -85,8 +115,21 @@ struct impl {
 	int epoll_fd;
 	pthread_t thread;
 
+#ifdef HAVE_IO_URING
+	struct uring uring;		/**< used instead of epoll when fd != -1 */
+	struct poll_entry **polls;	/**< poll entries indexed with the fd */
+	uint32_t n_polls;
+	struct spa_list poll_list;
+	bool dispatching;
+#endif
+
 	struct spa_source *wakeup;
-	int ack_fd;
+
+	struct spa_source *timer;	/**< timerfd of all timer sources */
+	uint64_t timer_armed;		/**< time the timerfd is armed for or 0 */
+	struct source_impl **timers;	/**< heap of armed timers, earliest first */
+	uint32_t n_timers;
+	uint32_t max_timers;
 
 	struct spa_ringbuffer buffer;
 	uint8_t buffer_data[DATAS_SIZE];
@@ -108,6 +151,10 @@ struct source_impl {
 	} func;
 	int signal_number;
 	bool enabled;
+
+	uint64_t expire;		/**< timer expiration time */
+	uint64_t interval;		/**< timer interval or 0 */
+	uint32_t heap_index;		/**< index in timers or SPA_ID_INVALID */
 };
 /** \endcond */
 
@@ -143,12 +190,227 @@ static inline enum spa_io spa_epoll_to_io(uint32_t events)
 	return mask;
 }
 
+/* The hooks are called from the loop and from all threads that block in
+ * invoke at the same time. Walk the list without the cursor that
+ * spa_hook_list_call() inserts in it. */
+static inline void hooks_before(struct impl *impl)
+{
+	struct spa_hook *h;
+
+	spa_list_for_each(h, &impl->hooks_list.list, link) {
+		const struct spa_loop_control_hooks *hooks = h->funcs;
+		if (hooks->before)
+			hooks->before(h->data);
+	}
+}
+
+static inline void hooks_after(struct impl *impl)
+{
+	struct spa_hook *h;
+
+	spa_list_for_each(h, &impl->hooks_list.list, link) {
+		const struct spa_loop_control_hooks *hooks = h->funcs;
+		if (hooks->after)
+			hooks->after(h->data);
+	}
+}
+
+#ifdef HAVE_IO_URING
+/* The io_uring backend uses one-shot poll requests. The requests of the
+ * sources that were dispatched are queued again and submitted together,
+ * without waiting, before the iteration returns. The polls are then
+ * armed whenever the loop is not dispatching and the ring fd can be
+ * polled by another loop like the epoll fd. */
+static inline bool use_uring(struct impl *impl)
+{
+	return impl->uring.fd != -1;
+}
+
+static int uring_submit(struct impl *impl)
+{
+	/* during dispatch, requests go out together after it */
+	if (impl->dispatching)
+		return 0;
+	return uring_enter(&impl->uring, 0, 0);
+}
+
+static int uring_poll_add(struct impl *impl, struct poll_entry *e)
+{
+	struct io_uring_sqe *sqe;
+
+	if ((sqe = uring_get_sqe(&impl->uring)) == NULL)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = e->source->fd;
+	sqe->poll32_events = spa_io_to_epoll(e->source->mask);
+	sqe->user_data = (uintptr_t) e;
+	e->armed = true;
+
+	return 0;
+}
+
+static void uring_poll_cancel(struct impl *impl, struct poll_entry *e)
+{
+	struct io_uring_sqe *sqe;
+
+	e->source = NULL;
+	/* entries that are not armed are being dispatched and are
+	 * freed after that */
+	if (!e->armed)
+		return;
+
+	if ((sqe = uring_get_sqe(&impl->uring)) == NULL) {
+		spa_log_warn(impl->log, NAME " %p: can't cancel poll %p", impl, e);
+		return;
+	}
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->addr = (uintptr_t) e;
+	sqe->user_data = 0;
+}
+
+static int uring_add_source(struct impl *impl, struct spa_source *source)
+{
+	struct poll_entry *e;
+	int res;
+
+	if ((uint32_t) source->fd >= impl->n_polls) {
+		uint32_t n_polls = SPA_MAX(impl->n_polls * 2, (uint32_t) source->fd + 1);
+		void *polls = realloc(impl->polls, n_polls * sizeof(struct poll_entry *));
+		if (polls == NULL)
+			return errno;
+		impl->polls = polls;
+		memset(&impl->polls[impl->n_polls], 0,
+		       (n_polls - impl->n_polls) * sizeof(struct poll_entry *));
+		impl->n_polls = n_polls;
+	}
+	if (impl->polls[source->fd] != NULL)
+		return EEXIST;
+
+	if ((e = calloc(1, sizeof(struct poll_entry))) == NULL)
+		return errno;
+
+	e->source = source;
+	spa_list_append(&impl->poll_list, &e->link);
+	impl->polls[source->fd] = e;
+
+	if ((res = uring_poll_add(impl, e)) < 0 ||
+	    (res = uring_submit(impl)) < 0)
+		return -res;
+
+	return 0;
+}
+
+static int uring_update_source(struct impl *impl, struct spa_source *source)
+{
+	struct poll_entry *e;
+	int res;
+
+	if ((uint32_t) source->fd >= impl->n_polls ||
+	    (e = impl->polls[source->fd]) == NULL || e->source != source)
+		return ENOENT;
+
+	/* not armed, the new mask is used when it is rearmed */
+	if (!e->armed)
+		return 0;
+
+	uring_poll_cancel(impl, e);
+	impl->polls[source->fd] = NULL;
+
+	if ((res = uring_add_source(impl, source)) != 0)
+		return res;
+
+	return 0;
+}
+
+static void uring_remove_source(struct impl *impl, struct spa_source *source)
+{
+	struct poll_entry *e;
+
+	if ((uint32_t) source->fd >= impl->n_polls ||
+	    (e = impl->polls[source->fd]) == NULL || e->source != source)
+		return;
+
+	impl->polls[source->fd] = NULL;
+	uring_poll_cancel(impl, e);
+	uring_submit(impl);
+}
+
+static void uring_free_poll(struct poll_entry *e)
+{
+	spa_list_remove(&e->link);
+	free(e);
+}
+
+static int uring_iterate(struct impl *impl, int timeout)
+{
+	struct io_uring_cqe cqes[URING_MAX_CQES];
+	struct poll_entry *e;
+	uint32_t i, n, n_polls = 0;
+	int res;
+
+	hooks_before(impl);
+
+	res = uring_enter(&impl->uring, 1, timeout);
+
+	hooks_after(impl);
+
+	if (SPA_UNLIKELY(res < 0))
+		return res;
+
+	n = uring_reap(&impl->uring, cqes, SPA_N_ELEMENTS(cqes));
+
+	impl->dispatching = true;
+
+	/* first set all the rmasks, see loop_iterate() */
+	for (i = 0; i < n; i++) {
+		if ((e = (struct poll_entry *)(uintptr_t) cqes[i].user_data) == NULL)
+			continue;
+		e->armed = false;
+		n_polls++;
+		if (e->source)
+			e->source->rmask = cqes[i].res < 0 ?
+				SPA_IO_ERR : spa_epoll_to_io(cqes[i].res);
+	}
+	for (i = 0; i < n; i++) {
+		struct spa_source *s;
+
+		if ((e = (struct poll_entry *)(uintptr_t) cqes[i].user_data) == NULL)
+			continue;
+		s = e->source;
+		if (s && s->rmask && s->loop == &impl->loop)
+			s->func(s);
+	}
+	for (i = 0; i < n; i++) {
+		if ((e = (struct poll_entry *)(uintptr_t) cqes[i].user_data) == NULL)
+			continue;
+		if (e->source == NULL)
+			uring_free_poll(e);
+		else if (!e->armed)
+			uring_poll_add(impl, e);
+	}
+
+	impl->dispatching = false;
+
+	/* rearm without waiting so that the ring fd reports new events */
+	if ((res = uring_submit(impl)) < 0)
+		spa_log_warn(impl->log, NAME " %p: can't submit polls: %s",
+			     impl, strerror(-res));
+
+	return n_polls;
+}
+#endif
+
 static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
 {
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
 	source->loop = loop;
 
+#ifdef HAVE_IO_URING
+	if (use_uring(impl))
+		return source->fd != -1 ? uring_add_source(impl, source) : 0;
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -167,6 +429,10 @@ static int loop_update_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (use_uring(impl))
+		return source->fd != -1 ? uring_update_source(impl, source) : 0;
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -185,12 +451,70 @@ static void loop_remove_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (use_uring(impl)) {
+		if (source->fd != -1)
+			uring_remove_source(impl, source);
+	} else
+#endif
 	if (source->fd != -1)
 		epoll_ctl(impl->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
 
 	source->loop = NULL;
 }
 
+/* reserve space for an item with @size bytes of data, this can be
+ * called from any thread */
+static struct invoke_item *invoke_reserve(struct impl *impl, size_t size)
+{
+	struct invoke_item *item;
+	uint32_t idx, offset, l0;
+	int32_t filled;
+	size_t item_size;
+
+	idx = __atomic_load_n(&impl->buffer.writeindex, __ATOMIC_RELAXED);
+	while (true) {
+		filled = idx - __atomic_load_n(&impl->buffer.readindex, __ATOMIC_ACQUIRE);
+		if (filled < 0) {
+			/* another thread moved the write index */
+			idx = __atomic_load_n(&impl->buffer.writeindex, __ATOMIC_RELAXED);
+			continue;
+		}
+		if (filled > DATAS_SIZE) {
+			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
+			return NULL;
+		}
+		offset = idx & (DATAS_SIZE - 1);
+		l0 = DATAS_SIZE - offset;
+
+		if (l0 > sizeof(struct invoke_item) + size) {
+			item_size = sizeof(struct invoke_item) + size;
+			if (l0 < sizeof(struct invoke_item) + item_size)
+				item_size = l0;
+		} else {
+			item_size = l0 + size;
+		}
+		if (filled + item_size > DATAS_SIZE) {
+			spa_log_warn(impl->log, NAME " %p: queue full %d", impl,
+					DATAS_SIZE - filled);
+			return NULL;
+		}
+		/* on failure idx is updated and everything is computed again */
+		if (__atomic_compare_exchange_n(&impl->buffer.writeindex, &idx, idx + item_size,
+						true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+	}
+
+	item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+	item->item_size = item_size;
+	if (item_size > l0)
+		item->data = impl->buffer_data;
+	else
+		item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
+
+	return item;
+}
+
 static int
 loop_invoke(struct spa_loop *loop,
 	    spa_invoke_func_t func,
@@ -203,69 +527,50 @@ loop_invoke(struct spa_loop *loop,
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 	bool in_thread = pthread_equal(impl->thread, pthread_self());
 	struct invoke_item *item;
+	struct invoke_done done;
 	int res;
 
-	if (in_thread) {
-		res = func(loop, false, seq, data, size, user_data);
-	} else {
-		int32_t filled, avail;
-		uint32_t idx, offset, l0;
-
-		filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-		if (filled < 0 || filled > DATAS_SIZE) {
-			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
-			return -EPIPE;
-		}
-		avail = DATAS_SIZE - filled;
-		if (avail < sizeof(struct invoke_item)) {
-			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-			return -EPIPE;
-		}
-		offset = idx & (DATAS_SIZE - 1);
+	if (in_thread)
+		return func(loop, false, seq, data, size, user_data);
 
-		l0 = DATAS_SIZE - offset;
+	/* a blocking caller waits until the item is handled so the
+	 * data does not need to be copied */
+	if ((item = invoke_reserve(impl, block ? 0 : SPA_ROUND_UP_N(size, 8))) == NULL)
+		return -EPIPE;
 
-		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
-		item->func = func;
-		item->seq = seq;
-		item->size = size;
-		item->block = block;
-		item->user_data = user_data;
+	item->func = func;
+	item->seq = seq;
+	item->size = size;
+	item->user_data = user_data;
 
-		if (l0 > sizeof(struct invoke_item) + size) {
-			item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-			item->item_size = sizeof(struct invoke_item) + size;
-			if (l0 < sizeof(struct invoke_item) + item->item_size)
-				item->item_size = l0;
-		} else {
-			item->data = impl->buffer_data;
-			item->item_size = l0 + size;
-		}
+	if (block) {
+		sem_init(&done.sem, 0, 0);
+		item->data = (void *) data;
+		item->done = &done;
+	} else {
 		memcpy(item->data, data, size);
+		item->done = NULL;
+	}
 
-		spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
-
-		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
+	__atomic_store_n(&item->commit, 1, __ATOMIC_RELEASE);
 
-		if (block) {
-			uint64_t count = 1;
+	spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
 
-			spa_loop_control_hook_before(&impl->hooks_list);
+	if (block) {
+		hooks_before(impl);
 
-			if (read(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-						impl, strerror(errno));
+		while (sem_wait(&done.sem) < 0 && errno == EINTR);
 
-			spa_loop_control_hook_after(&impl->hooks_list);
+		hooks_after(impl);
 
-			res = item->res;
-		}
-		else {
-			if (seq != SPA_ID_INVALID)
-				res = SPA_RESULT_RETURN_ASYNC(seq);
-			else
-				res = 0;
-		}
+		sem_destroy(&done.sem);
+		res = done.res;
+	}
+	else {
+		if (seq != SPA_ID_INVALID)
+			res = SPA_RESULT_RETURN_ASYNC(seq);
+		else
+			res = 0;
 	}
 	return res;
 }
@@ -273,19 +578,37 @@ loop_invoke(struct spa_loop *loop,
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
-	uint32_t index;
+	uint32_t index, offset, l0;
+
 	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
-		struct invoke_item *item =
-		    SPA_MEMBER(impl->buffer_data, index & (DATAS_SIZE - 1), struct invoke_item);
-		item->res = item->func(&impl->loop, true, item->seq, item->data, item->size,
+		struct invoke_item *item;
+		struct invoke_done *done;
+		size_t item_size;
+		int res;
+
+		offset = index & (DATAS_SIZE - 1);
+		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+
+		/* still being written, the writer will wake us up again */
+		if (__atomic_load_n(&item->commit, __ATOMIC_ACQUIRE) == 0)
+			break;
+
+		res = item->func(&impl->loop, true, item->seq, item->data, item->size,
 			   item->user_data);
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
 
-		if (item->block) {
-			uint64_t count = 1;
-			if (write(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, strerror(errno));
+		done = item->done;
+		item_size = item->item_size;
+
+		l0 = DATAS_SIZE - offset;
+		memset(item, 0, SPA_MIN(item_size, l0));
+		if (item_size > l0)
+			memset(impl->buffer_data, 0, item_size - l0);
+
+		spa_ringbuffer_read_update(&impl->buffer, index + item_size);
+
+		if (done) {
+			done->res = res;
+			sem_post(&done->sem);
 		}
 	}
 }
@@ -294,6 +617,10 @@ static int loop_get_fd(struct spa_loop_control *ctrl)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
 
+#ifdef HAVE_IO_URING
+	if (use_uring(impl))
+		return impl->uring.fd;
+#endif
 	return impl->epoll_fd;
 }
 
@@ -335,15 +662,22 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 	struct epoll_event ep[32];
 	int i, nfds, save_errno = 0;
 
-	spa_loop_control_hook_before(&impl->hooks_list);
+#ifdef HAVE_IO_URING
+	if (use_uring(impl)) {
+		int res = uring_iterate(impl, timeout);
+		process_destroy(impl);
+		return res;
+	}
+#endif
+	hooks_before(impl);
 
 	if (SPA_UNLIKELY((nfds = epoll_wait(impl->epoll_fd, ep, SPA_N_ELEMENTS(ep), timeout)) < 0))
 		save_errno = errno;
 
-	spa_loop_control_hook_after(&impl->hooks_list);
+	hooks_after(impl);
 
 	if (SPA_UNLIKELY(nfds < 0))
-		return save_errno;
+		return save_errno == EINTR ? 0 : -save_errno;
 
 	/* first we set all the rmasks, then call the callbacks. The reason is that
 	 * some callback might also want to look at other sources it manages and
@@ -359,7 +693,7 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 	}
 	process_destroy(impl);
 
-	return 0;
+	return nfds;
 }
 
 static void source_io_func(struct spa_source *source)
@@ -504,16 +838,139 @@ static void loop_signal_event(struct spa_source *source)
 				source, source->fd, strerror(errno));
 }
 
-static void source_timer_func(struct spa_source *source)
+static inline uint64_t get_time_ns(void)
 {
-	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
-	uint64_t expirations;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
 
-	if (read(source->fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t))
-		spa_log_warn(impl->impl->log, NAME " %p: failed to read timer fd %d: %s",
-				source, source->fd, strerror(errno));
+/* All timers share one timerfd that is armed for the earliest timer in
+ * a binary heap. */
+static inline bool timer_before(struct source_impl *a, struct source_impl *b)
+{
+	return a->expire < b->expire;
+}
+
+static inline void timer_set(struct impl *impl, uint32_t index, struct source_impl *t)
+{
+	impl->timers[index] = t;
+	t->heap_index = index;
+}
+
+static void timers_up(struct impl *impl, uint32_t index)
+{
+	struct source_impl *t = impl->timers[index];
+
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+		if (!timer_before(t, impl->timers[parent]))
+			break;
+		timer_set(impl, index, impl->timers[parent]);
+		index = parent;
+	}
+	timer_set(impl, index, t);
+}
 
-	impl->func.timer(source->data, expirations);
+static void timers_down(struct impl *impl, uint32_t index)
+{
+	struct source_impl *t = impl->timers[index];
+
+	while (true) {
+		uint32_t child = 2 * index + 1;
+		if (child >= impl->n_timers)
+			break;
+		if (child + 1 < impl->n_timers &&
+		    timer_before(impl->timers[child + 1], impl->timers[child]))
+			child++;
+		if (!timer_before(impl->timers[child], t))
+			break;
+		timer_set(impl, index, impl->timers[child]);
+		index = child;
+	}
+	timer_set(impl, index, t);
+}
+
+static int timers_add(struct impl *impl, struct source_impl *t)
+{
+	if (impl->n_timers == impl->max_timers) {
+		uint32_t max = SPA_MAX(impl->max_timers * 2, 16u);
+		void *timers = realloc(impl->timers, max * sizeof(struct source_impl *));
+		if (timers == NULL)
+			return -errno;
+		impl->timers = timers;
+		impl->max_timers = max;
+	}
+	timer_set(impl, impl->n_timers++, t);
+	timers_up(impl, t->heap_index);
+	return 0;
+}
+
+static void timers_remove(struct impl *impl, struct source_impl *t)
+{
+	uint32_t index = t->heap_index;
+	struct source_impl *last;
+
+	if (index >= impl->n_timers || impl->timers[index] != t)
+		return;
+
+	t->heap_index = SPA_ID_INVALID;
+	last = impl->timers[--impl->n_timers];
+	if (last == t)
+		return;
+
+	timer_set(impl, index, last);
+	timers_up(impl, index);
+	timers_down(impl, last->heap_index);
+}
+
+/* arm the timerfd for the earliest timer, a timer that is removed does
+ * not rearm, the timerfd then simply wakes up with nothing to do */
+static int timers_rearm(struct impl *impl)
+{
+	struct itimerspec its;
+	uint64_t expire = impl->n_timers > 0 ? impl->timers[0]->expire : 0;
+
+	if (expire == impl->timer_armed)
+		return 0;
+
+	spa_zero(its);
+	its.it_value.tv_sec = expire / SPA_NSEC_PER_SEC;
+	its.it_value.tv_nsec = expire % SPA_NSEC_PER_SEC;
+	if (timerfd_settime(impl->timer->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		return errno;
+
+	impl->timer_armed = expire;
+	return 0;
+}
+
+static void timers_dispatch(void *data, int fd, enum spa_io mask)
+{
+	struct impl *impl = data;
+	uint64_t expirations, now;
+
+	if (read(fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t) && errno != EAGAIN)
+		spa_log_warn(impl->log, NAME " %p: failed to read timer fd %d: %s",
+				impl, fd, strerror(errno));
+
+	impl->timer_armed = 0;
+	now = get_time_ns();
+
+	while (impl->n_timers > 0 && impl->timers[0]->expire <= now) {
+		struct source_impl *t = impl->timers[0];
+
+		if (t->interval > 0) {
+			expirations = 1 + (now - t->expire) / t->interval;
+			t->expire += expirations * t->interval;
+			timers_down(impl, 0);
+		} else {
+			expirations = 1;
+			timers_remove(impl, t);
+		}
+		/* the callback can update or destroy any timer */
+		t->func.timer(t->source.data, expirations);
+	}
+	timers_rearm(impl);
 }
 
 static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
@@ -527,15 +984,11 @@ static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
 		return NULL;
 
 	source->source.loop = &impl->loop;
-	source->source.func = source_timer_func;
 	source->source.data = data;
-	source->source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-	source->source.mask = SPA_IO_IN;
+	source->source.fd = -1;
 	source->impl = impl;
-	source->close = true;
 	source->func.timer = func;
-
-	spa_loop_add_source(&impl->loop, &source->source);
+	source->heap_index = SPA_ID_INVALID;
 
 	spa_list_insert(&impl->source_list, &source->link);
 
@@ -546,25 +999,30 @@ static int
 loop_update_timer(struct spa_source *source,
 		  struct timespec *value, struct timespec *interval, bool absolute)
 {
-	struct itimerspec its;
-	int flags = 0;
+	struct source_impl *t = SPA_CONTAINER_OF(source, struct source_impl, source);
+	struct impl *impl = t->impl;
+	uint64_t expire = 0;
+	int res;
 
-	spa_zero(its);
 	if (value) {
-		its.it_value = *value;
+		expire = SPA_TIMESPEC_TO_TIME(value);
 	} else if (interval) {
-		its.it_value = *interval;
+		expire = SPA_TIMESPEC_TO_TIME(interval);
 		absolute = true;
 	}
-	if (interval)
-		its.it_interval = *interval;
-	if (absolute)
-		flags |= TFD_TIMER_ABSTIME;
+	t->interval = interval ? SPA_TIMESPEC_TO_TIME(interval) : 0;
 
-	if (timerfd_settime(source->fd, flags, &its, NULL) < 0)
-		return errno;
+	timers_remove(impl, t);
 
-	return 0;
+	/* like timerfd, a value of 0 disarms the timer */
+	if (expire == 0)
+		return timers_rearm(impl);
+
+	t->expire = absolute ? expire : get_time_ns() + expire;
+	if ((res = timers_add(impl, t)) < 0)
+		return -res;
+
+	return timers_rearm(impl);
 }
 
 static void source_signal_func(struct spa_source *source)
@@ -621,6 +1079,8 @@ static void loop_destroy_source(struct spa_source *source)
 
 	spa_list_remove(&impl->link);
 
+	timers_remove(impl->impl, impl);
+
 	if (source->loop)
 		spa_loop_remove_source(source->loop, source);
 
@@ -696,8 +1156,17 @@ static int impl_clear(struct spa_handle *handle)
 		loop_destroy_source(&source->source);
 
 	process_destroy(impl);
-
-	close(impl->ack_fd);
+	free(impl->timers);
+
+#ifdef HAVE_IO_URING
+	if (use_uring(impl)) {
+		struct poll_entry *e, *t;
+		spa_list_for_each_safe(e, t, &impl->poll_list, link)
+			uring_free_poll(e);
+		free(impl->polls);
+		uring_clear(&impl->uring);
+	}
+#endif
 	close(impl->epoll_fd);
 
 	return 0;
@@ -712,6 +1181,9 @@ impl_init(const struct spa_handle_factory *factory,
 {
 	struct impl *impl;
 	uint32_t i;
+#ifdef HAVE_IO_URING
+	const char *str;
+#endif
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -740,14 +1212,33 @@ impl_init(const struct spa_handle_factory *factory,
 	if (impl->epoll_fd == -1)
 		return errno;
 
+#ifdef HAVE_IO_URING
+	impl->uring.fd = -1;
+	spa_list_init(&impl->poll_list);
+
+	if (info && (str = spa_dict_lookup(info, "loop.backend")) &&
+	    strcmp(str, "io_uring") == 0) {
+		int res = uring_init(&impl->uring, URING_ENTRIES,
+				     IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP);
+		if (res < 0)
+			spa_log_warn(impl->log, NAME " %p: can't use io_uring, using epoll: %s",
+					impl, spa_strerror(res));
+		else
+			spa_log_info(impl->log, NAME " %p: using io_uring", impl);
+	}
+#endif
+
 	spa_list_init(&impl->source_list);
 	spa_list_init(&impl->destroy_list);
 	spa_hook_list_init(&impl->hooks_list);
 
 	spa_ringbuffer_init(&impl->buffer);
+	memset(impl->buffer_data, 0, sizeof(impl->buffer_data));
 
 	impl->wakeup = spa_loop_utils_add_event(&impl->utils, wakeup_func, impl);
-	impl->ack_fd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+	impl->timer = spa_loop_utils_add_io(&impl->utils,
+				timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK),
+				SPA_IO_IN, true, timers_dispatch, impl);
 
 	spa_log_debug(impl->log, NAME " %p: initialized", impl);
 
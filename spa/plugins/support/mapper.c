@@ -18,6 +18,7 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -52,6 +53,10 @@ struct impl {
 
 	struct array types;
 	struct array strings;
+
+	/* open addressing hash table of id + 1, 0 is an empty slot */
+	uint32_t *hash;
+	uint32_t hash_size;
 };
 
 static inline void * alloc_size(struct array *array, size_t size, size_t extend)
@@ -66,22 +71,86 @@ static inline void * alloc_size(struct array *array, size_t size, size_t extend)
 	return res;
 }
 
+static inline uint32_t hash_string(const char *str)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+
+	while (*str) {
+		h ^= (uint8_t) *str++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline const char *get_string(struct impl *impl, uint32_t id)
+{
+	off_t o = ((off_t *)impl->types.data)[id];
+	return SPA_MEMBER(impl->strings.data, o, char);
+}
+
+static inline uint32_t *find_slot(struct impl *impl, const char *type, uint32_t h)
+{
+	uint32_t mask = impl->hash_size - 1, i = h & mask;
+
+	while (impl->hash[i] != 0) {
+		if (strcmp(get_string(impl, impl->hash[i] - 1), type) == 0)
+			break;
+		i = (i + 1) & mask;
+	}
+	return &impl->hash[i];
+}
+
+static int grow_hash(struct impl *impl)
+{
+	uint32_t i, n_types, size = impl->hash_size ? impl->hash_size * 2 : 256;
+	uint32_t *hash, *old = impl->hash, mask = size - 1;
+
+	if ((hash = calloc(size, sizeof(uint32_t))) == NULL)
+		return -ENOMEM;
+
+	/* rehash all types, the ids are unique so we don't need to compare */
+	n_types = impl->types.size / sizeof(off_t);
+	for (i = 0; i < n_types; i++) {
+		uint32_t j = hash_string(get_string(impl, i)) & mask;
+		while (hash[j] != 0)
+			j = (j + 1) & mask;
+		hash[j] = i + 1;
+	}
+	impl->hash = hash;
+	impl->hash_size = size;
+	free(old);
+
+	return 0;
+}
+
 static uint32_t
 impl_type_map_get_id(struct spa_type_map *map, const char *type)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
-	uint32_t i, len;
+	uint32_t i, len, h, *slot, n_types;
 	void *p;
-	off_t o, *off;
+	off_t *off;
 
 	if (type == NULL)
 		return SPA_ID_INVALID;
 
-	for (i = 0; i < impl->types.size / sizeof(off_t); i++) {
-		o = ((off_t *)impl->types.data)[i];
-		if (strcmp(SPA_MEMBER(impl->strings.data, o, char), type) == 0)
-			return i;
+	h = hash_string(type);
+	n_types = impl->types.size / sizeof(off_t);
+
+	if (impl->hash_size > 0) {
+		slot = find_slot(impl, type, h);
+		if (*slot != 0)
+			return *slot - 1;
 	}
+
+	/* keep the load factor under 1/2 */
+	if ((n_types + 1) * 2 > impl->hash_size) {
+		if (grow_hash(impl) < 0)
+			return SPA_ID_INVALID;
+	}
+	slot = find_slot(impl, type, h);
+
 	len = strlen(type);
 	p = alloc_size(&impl->strings, len+1, 1024);
 	memcpy(p, type, len + 1);
@@ -90,8 +159,9 @@ impl_type_map_get_id(struct spa_type_map *map, const char *type)
 	*off = SPA_PTRDIFF(p, impl->strings.data);
 	i = SPA_PTRDIFF(off, impl->types.data) / sizeof(off_t);
 
-	return i;
+	*slot = i + 1;
 
+	return i;
 }
 
 static const char *
@@ -99,10 +169,8 @@ impl_type_map_get_type(const struct spa_type_map *map, uint32_t id)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
 
-	if (id < impl->types.size / sizeof(off_t)) {
-		off_t o = ((off_t *)impl->types.data)[id];
-		return SPA_MEMBER(impl->strings.data, o, char);
-	}
+	if (id < impl->types.size / sizeof(off_t))
+		return get_string(impl, id);
 	return NULL;
 }
 
@@ -150,6 +218,7 @@ static int impl_clear(struct spa_handle *handle)
 		free(impl->types.data);
 	if (impl->strings.data)
 		free(impl->strings.data);
+	free(impl->hash);
 
 	return 0;
 }
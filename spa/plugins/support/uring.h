@@ -0,0 +1,201 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Minimal io_uring submission and completion rings, using the syscalls
+ * directly so that no extra library is needed. */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <spa/utils/defs.h>
+
+struct uring {
+	int fd;
+	uint32_t features;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+	struct io_uring_sqe *sqes;
+	unsigned sq_queued;		/**< sqes filled in but not submitted */
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+};
+
+static inline void uring_clear(struct uring *r)
+{
+	if (r->sqes)
+		munmap(r->sqes, r->sqes_size);
+	if (r->cq_ring && r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring, r->cq_ring_size);
+	if (r->sq_ring)
+		munmap(r->sq_ring, r->sq_ring_size);
+	if (r->fd != -1)
+		close(r->fd);
+	spa_zero(*r);
+	r->fd = -1;
+}
+
+static inline int uring_init(struct uring *r, unsigned entries, uint32_t features)
+{
+	struct io_uring_params p;
+	int res;
+
+	spa_zero(*r);
+	spa_zero(p);
+
+	r->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0) {
+		r->fd = -1;
+		return -errno;
+	}
+	r->features = p.features;
+	if ((r->features & features) != features) {
+		res = -ENOTSUP;
+		goto error;
+	}
+
+	r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->sq_ring_size = r->cq_ring_size = SPA_MAX(r->sq_ring_size, r->cq_ring_size);
+
+	r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		r->sq_ring = NULL;
+		res = -errno;
+		goto error;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) {
+			r->cq_ring = NULL;
+			res = -errno;
+			goto error;
+		}
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		res = -errno;
+		goto error;
+	}
+
+	r->sq_head = SPA_MEMBER(r->sq_ring, p.sq_off.head, unsigned);
+	r->sq_tail = SPA_MEMBER(r->sq_ring, p.sq_off.tail, unsigned);
+	r->sq_mask = SPA_MEMBER(r->sq_ring, p.sq_off.ring_mask, unsigned);
+	r->sq_array = SPA_MEMBER(r->sq_ring, p.sq_off.array, unsigned);
+	r->sq_entries = p.sq_entries;
+
+	r->cq_head = SPA_MEMBER(r->cq_ring, p.cq_off.head, unsigned);
+	r->cq_tail = SPA_MEMBER(r->cq_ring, p.cq_off.tail, unsigned);
+	r->cq_mask = SPA_MEMBER(r->cq_ring, p.cq_off.ring_mask, unsigned);
+	r->cqes = SPA_MEMBER(r->cq_ring, p.cq_off.cqes, struct io_uring_cqe);
+
+	return 0;
+
+      error:
+	uring_clear(r);
+	return res;
+}
+
+/* submit the queued sqes and wait for at least @min_complete completions
+ * or until @timeout ms passed, a negative timeout waits forever */
+static inline int uring_enter(struct uring *r, unsigned min_complete, int timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	unsigned flags = 0;
+	int res;
+
+	spa_zero(arg);
+	if (min_complete > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeout >= 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * SPA_NSEC_PER_MSEC;
+			arg.ts = (uint64_t)(uintptr_t) &ts;
+		}
+	}
+	flags |= IORING_ENTER_EXT_ARG;
+
+	res = syscall(__NR_io_uring_enter, r->fd, r->sq_queued, min_complete, flags,
+		      &arg, sizeof(arg));
+	if (res < 0)
+		return errno == ETIME || errno == EINTR ? 0 : -errno;
+
+	r->sq_queued -= SPA_MIN((unsigned) res, r->sq_queued);
+	return 0;
+}
+
+/* get a free sqe, submits the queued sqes first when the ring is full */
+static inline struct io_uring_sqe *uring_get_sqe(struct uring *r)
+{
+	unsigned tail = *r->sq_tail, index;
+	struct io_uring_sqe *sqe;
+
+	if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+		if (uring_enter(r, 0, 0) < 0)
+			return NULL;
+		if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries)
+			return NULL;
+	}
+	index = tail & *r->sq_mask;
+	sqe = &r->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	r->sq_array[index] = index;
+	r->sq_queued++;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	return sqe;
+}
+
+/* fill up to @max_cqes completions in @cqes and consume them from the ring */
+static inline unsigned uring_reap(struct uring *r, struct io_uring_cqe *cqes, unsigned max_cqes)
+{
+	unsigned head = *r->cq_head, n;
+	unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (n = 0; head != tail && n < max_cqes; head++, n++)
+		cqes[n] = r->cqes[head & *r->cq_mask];
+
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+	return n;
+}
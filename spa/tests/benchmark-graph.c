@@ -0,0 +1,421 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <setjmp.h>
+
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/graph/graph.h>
+#include <spa/graph/graph-scheduler6.h>
+#include <spa/graph/graph-scheduler7.h>
+
+#define MAX_COUNT	10000
+
+/* a cycle is aborted when the nodes are called more often than this */
+#define MAX_CALLS(n_nodes)	(8 * (n_nodes) + 64)
+
+struct scheduler {
+	const char *name;
+	/* set the callbacks on the graph, returns the scheduler data */
+	void *(*init) (struct spa_graph *graph);
+	void (*clear) (void *data);
+	bool core;		/**< used by the core or the graph pool, must
+				  *  process all graphs */
+};
+
+/* the recursive scheduler that the core runs on a single data thread */
+static void *data_init(struct spa_graph *graph)
+{
+	struct spa_graph_data *data = calloc(1, sizeof(struct spa_graph_data));
+
+	spa_graph_data_init(data, graph);
+	spa_graph_set_callbacks(graph, &spa_graph_impl_default, data);
+	return data;
+}
+
+static void data_clear(void *data)
+{
+	free(data);
+}
+
+/* the plan is compiled before the cycles, like the core does on the main
+ * loop, and swapped in */
+struct plans {
+	struct spa_graph_plan plan;
+	struct spa_graph_plan next;
+};
+
+static void *plan_init(struct spa_graph *graph)
+{
+	struct plans *p = calloc(1, sizeof(struct plans));
+
+	spa_graph_plan_init(&p->plan, graph);
+	spa_graph_plan_init(&p->next, graph);
+	if (spa_graph_plan_compile(&p->next) < 0 ||
+	    spa_graph_plan_swap(&p->plan, &p->next) < 0)
+		fprintf(stderr, "can't compile the plan\n");
+	spa_graph_set_callbacks(graph, &spa_graph_plan_impl_default, &p->plan);
+	return p;
+}
+
+static void plan_clear(void *data)
+{
+	struct plans *p = data;
+
+	spa_graph_plan_clear(&p->plan);
+	spa_graph_plan_clear(&p->next);
+	free(p);
+}
+
+static const struct scheduler schedulers[] = {
+	{ "scheduler6", data_init, data_clear, true },
+	{ "scheduler7", plan_init, plan_clear, true },
+};
+
+static uint32_t n_calls, max_calls;
+static jmp_buf abort_cycle;
+
+static void check_calls(void)
+{
+	if (++n_calls > max_calls)
+		longjmp(abort_cycle, 1);
+}
+
+/* a node that consumes all its inputs and produces one buffer on
+ * each output. Nodes without inputs are sources, nodes without outputs
+ * are sinks. Async sources only produce their output after the cycle,
+ * like a remote node would. */
+struct node {
+	struct spa_node node;
+	struct spa_graph_node gnode;
+
+	uint32_t n_in;
+	struct spa_graph_port *in;
+	uint32_t n_out;
+	struct spa_graph_port *out;
+	struct spa_io_buffers *out_io;
+
+	bool async;
+	bool pending;
+	uint32_t processed;
+};
+
+static int produce(struct node *n)
+{
+	uint32_t i;
+
+	n->processed++;
+	for (i = 0; i < n->n_out; i++)
+		n->out_io[i].status = SPA_STATUS_HAVE_BUFFER;
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int node_process_input(struct spa_node *node)
+{
+	struct node *n = SPA_CONTAINER_OF(node, struct node, node);
+	uint32_t i;
+
+	check_calls();
+
+	for (i = 0; i < n->n_in; i++) {
+		if (n->in[i].io->status != SPA_STATUS_HAVE_BUFFER)
+			return SPA_STATUS_NEED_BUFFER;
+	}
+	for (i = 0; i < n->n_in; i++)
+		n->in[i].io->status = SPA_STATUS_OK;
+
+	if (n->n_out == 0) {
+		n->processed++;
+		return SPA_STATUS_OK;
+	}
+	return produce(n);
+}
+
+static int node_process_output(struct spa_node *node)
+{
+	struct node *n = SPA_CONTAINER_OF(node, struct node, node);
+	uint32_t i;
+
+	check_calls();
+
+	if (n->async) {
+		n->pending = true;
+		return SPA_STATUS_OK;
+	}
+	if (n->n_in == 0)
+		return produce(n);
+
+	for (i = 0; i < n->n_in; i++)
+		n->in[i].io->status = SPA_STATUS_NEED_BUFFER;
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static const struct spa_node node_impl = {
+	SPA_VERSION_NODE,
+	.process_input = node_process_input,
+	.process_output = node_process_output,
+};
+
+static struct node *node_new(struct spa_graph *graph, uint32_t n_in, uint32_t n_out)
+{
+	struct node *n;
+	uint32_t i;
+
+	n = calloc(1, sizeof(struct node));
+	n->node = node_impl;
+	n->n_in = n_in;
+	n->in = calloc(n_in, sizeof(struct spa_graph_port));
+	n->n_out = n_out;
+	n->out = calloc(n_out, sizeof(struct spa_graph_port));
+	n->out_io = calloc(n_out, sizeof(struct spa_io_buffers));
+
+	spa_graph_node_init(&n->gnode);
+	spa_graph_node_set_implementation(&n->gnode, &n->node);
+	spa_graph_node_add(graph, &n->gnode);
+
+	for (i = 0; i < n_in; i++) {
+		spa_graph_port_init(&n->in[i], SPA_DIRECTION_INPUT, i, 0, NULL);
+		spa_graph_port_add(&n->gnode, &n->in[i]);
+	}
+	for (i = 0; i < n_out; i++) {
+		n->out_io[i] = SPA_IO_BUFFERS_INIT;
+		spa_graph_port_init(&n->out[i], SPA_DIRECTION_OUTPUT, i, 0, &n->out_io[i]);
+		spa_graph_port_add(&n->gnode, &n->out[i]);
+	}
+	return n;
+}
+
+static void node_free(struct node *n)
+{
+	free(n->in);
+	free(n->out);
+	free(n->out_io);
+	free(n);
+}
+
+/* the ports of a link share the io area of the output port */
+static void link_nodes(struct node *out, uint32_t out_port, struct node *in, uint32_t in_port)
+{
+	in->in[in_port].io = &out->out_io[out_port];
+	spa_graph_port_link(&out->out[out_port], &in->in[in_port]);
+}
+
+struct test {
+	struct spa_graph graph;
+	struct node **nodes;
+	uint32_t n_nodes;
+	struct node *driver;		/**< the sink that pulls or the source that pushes */
+};
+
+struct topology {
+	const char *name;
+	void (*make) (struct test *t, uint32_t n_nodes);
+};
+
+static void test_init(struct test *t, uint32_t n_nodes)
+{
+	spa_graph_init(&t->graph);
+	t->n_nodes = n_nodes;
+	t->nodes = calloc(n_nodes, sizeof(struct node *));
+}
+
+/* source -> filter -> ... -> filter -> sink, added to the graph in
+ * reverse order so that the graph order is not the processing order */
+static void make_chain(struct test *t, uint32_t n_nodes)
+{
+	uint32_t i;
+
+	for (i = n_nodes; i > 0; i--)
+		t->nodes[i - 1] = node_new(&t->graph, i == 1 ? 0 : 1, i == n_nodes ? 0 : 1);
+	for (i = 0; i < n_nodes - 1; i++)
+		link_nodes(t->nodes[i], 0, t->nodes[i + 1], 0);
+	t->driver = t->nodes[n_nodes - 1];
+}
+
+/* n_nodes - 2 sources -> mixer -> sink */
+static void make_mixer(struct test *t, uint32_t n_nodes)
+{
+	uint32_t i, n_sources = n_nodes - 2;
+	struct node *mixer;
+
+	t->driver = t->nodes[n_nodes - 1] = node_new(&t->graph, 1, 0);
+	mixer = t->nodes[n_nodes - 2] = node_new(&t->graph, n_sources, 1);
+	for (i = 0; i < n_sources; i++) {
+		t->nodes[i] = node_new(&t->graph, 0, 1);
+		link_nodes(t->nodes[i], 0, mixer, i);
+	}
+	link_nodes(mixer, 0, t->driver, 0);
+}
+
+/* source -> tee -> n_nodes - 2 sinks, driven by the source */
+static void make_tee(struct test *t, uint32_t n_nodes)
+{
+	uint32_t i, n_sinks = n_nodes - 2;
+	struct node *tee;
+
+	t->driver = t->nodes[0] = node_new(&t->graph, 0, 1);
+	tee = t->nodes[1] = node_new(&t->graph, 1, n_sinks);
+	link_nodes(t->driver, 0, tee, 0);
+	for (i = 0; i < n_sinks; i++) {
+		t->nodes[i + 2] = node_new(&t->graph, 1, 0);
+		link_nodes(tee, i, t->nodes[i + 2], 0);
+	}
+}
+
+/* n_nodes - 2 async sources -> mixer -> sink */
+static void make_async(struct test *t, uint32_t n_nodes)
+{
+	uint32_t i;
+
+	make_mixer(t, n_nodes);
+	for (i = 0; i < n_nodes - 2; i++) {
+		t->nodes[i]->async = true;
+		t->nodes[i]->gnode.flags |= SPA_GRAPH_NODE_FLAG_ASYNC;
+	}
+}
+
+static const struct topology topologies[] = {
+	{ "chain", make_chain },
+	{ "mixer", make_mixer },
+	{ "tee", make_tee },
+	{ "async", make_async },
+};
+
+static void test_clear(struct test *t)
+{
+	uint32_t i;
+
+	for (i = 0; i < t->n_nodes; i++)
+		node_free(t->nodes[i]);
+	free(t->nodes);
+}
+
+static uint64_t get_time(clockid_t clock)
+{
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+/* one cycle like a driver would start it. A sink driver pulls, then the
+ * async nodes deliver their output. A source driver produces and pushes. */
+static void run_cycle(struct test *t)
+{
+	uint32_t i;
+
+	n_calls = 0;
+
+	if (t->driver->n_in > 0) {
+		t->driver->in[0].io->status = SPA_STATUS_NEED_BUFFER;
+		spa_graph_need_input(&t->graph, &t->driver->gnode);
+	} else {
+		produce(t->driver);
+		spa_graph_have_output(&t->graph, &t->driver->gnode);
+	}
+
+	for (i = 0; i < t->n_nodes; i++) {
+		struct node *n = t->nodes[i];
+
+		if (!n->pending)
+			continue;
+		n->pending = false;
+		produce(n);
+		spa_graph_have_output(&t->graph, &n->gnode);
+	}
+}
+
+/* run the cycles and check that every node is processed exactly once
+ * per cycle */
+static int run_test(const struct scheduler *sched,
+		    const struct topology *topo, uint32_t n_nodes)
+{
+	struct test t;
+	uint64_t t0, t1, c0, c1, max = 0;
+	uint32_t i, j;
+	void *data;
+	int res = 0;
+
+	test_init(&t, n_nodes);
+	topo->make(&t, n_nodes);
+	data = sched->init(&t.graph);
+	max_calls = MAX_CALLS(n_nodes);
+
+	if (setjmp(abort_cycle) != 0) {
+		printf("%-6s %-11s %4d nodes: cycle %d does not end\n",
+		       topo->name, sched->name, n_nodes, j);
+		res = -EINVAL;
+		goto done;
+	}
+
+	c0 = get_time(CLOCK_THREAD_CPUTIME_ID);
+	t0 = get_time(CLOCK_MONOTONIC);
+	for (j = 0; j < MAX_COUNT; j++) {
+		uint64_t start = t0;
+
+		run_cycle(&t);
+
+		t1 = get_time(CLOCK_MONOTONIC);
+		if (j > 0)
+			max = SPA_MAX(max, t1 - start);
+		t0 = t1;
+	}
+	c1 = get_time(CLOCK_THREAD_CPUTIME_ID);
+
+	for (i = 0; i < t.n_nodes; i++) {
+		if (t.nodes[i]->processed != MAX_COUNT) {
+			printf("%-6s %-11s %4d nodes: node %d processed %d times\n",
+			       topo->name, sched->name, n_nodes, i, t.nodes[i]->processed);
+			res = -EINVAL;
+			goto done;
+		}
+	}
+
+	printf("%-6s %-11s %4d nodes: %9.1f ns/cycle %9.1f max %7.1f ns/node\n",
+	       topo->name, sched->name, n_nodes,
+	       (double)(c1 - c0) / MAX_COUNT, (double) max,
+	       (double)(c1 - c0) / ((uint64_t)MAX_COUNT * n_nodes));
+
+      done:
+	sched->clear(data);
+	test_clear(&t);
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t sizes[] = { 10, 50, 100, 200, 500 };
+	uint32_t i, j, k;
+	int res = 0;
+
+	for (i = 0; i < SPA_N_ELEMENTS(topologies); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(sizes); j++) {
+			for (k = 0; k < SPA_N_ELEMENTS(schedulers); k++) {
+				if (run_test(&schedulers[k], &topologies[i], sizes[j]) < 0 &&
+				    schedulers[k].core)
+					res = -1;
+			}
+		}
+	}
+	return res;
+}
@@ -0,0 +1,197 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/type-map.h>
+#include <spa/support/loop.h>
+#include <spa/utils/dict.h>
+
+#define MAX_CLIENTS	4096
+#define DEFAULT_CLIENTS	500
+#define DEFAULT_ROUNDS	20000
+#define ACTIVE_CLIENTS	16
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_handle *handle;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	struct spa_source *event;
+	int fds[MAX_CLIENTS][2];
+	struct spa_source *sources[MAX_CLIENTS];
+
+	uint32_t n_clients;
+	uint32_t n_rounds;
+	uint64_t handled;
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+static void *make_handle(struct data *d, const char *name, const struct spa_dict *info,
+			 const struct spa_support *support, uint32_t n_support)
+{
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t index = 0;
+
+	while (spa_handle_factory_enum(&factory, &index) > 0) {
+		if (strcmp(factory->name, name))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if (spa_handle_factory_init(factory, handle, info, support, n_support) < 0) {
+			printf("can't make %s\n", name);
+			return NULL;
+		}
+		return handle;
+	}
+	printf("can't find %s\n", name);
+	return NULL;
+}
+
+static void on_client(void *data, int fd, enum spa_io mask)
+{
+	struct data *d = data;
+	uint8_t buf[64];
+
+	if (read(fd, buf, sizeof(buf)) > 0)
+		d->handled++;
+}
+
+/* the event stands in for a realtime source that wakes up every cycle */
+static void on_event(void *data, uint64_t count)
+{
+	struct data *d = data;
+	d->handled++;
+}
+
+static int run(struct data *d, const char *backend)
+{
+	struct spa_dict_item items[1] = { SPA_DICT_ITEM_INIT("loop.backend", backend) };
+	struct spa_dict info = SPA_DICT_INIT(items, 1);
+	struct spa_support support[1] = { { SPA_TYPE__TypeMap, d->map } };
+	char path[64], name[64];
+	uint64_t t0, t1, expected;
+	uint32_t i, j, next = 0;
+	ssize_t len;
+	void *iface;
+
+	if ((d->handle = make_handle(d, "loop", &info, support, 1)) == NULL)
+		return -1;
+
+	spa_handle_get_interface(d->handle,
+			spa_type_map_get_id(d->map, SPA_TYPE__LoopControl), &iface);
+	d->control = iface;
+	spa_handle_get_interface(d->handle,
+			spa_type_map_get_id(d->map, SPA_TYPE__LoopUtils), &iface);
+	d->utils = iface;
+
+	/* show what the loop really uses, it falls back to epoll */
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", spa_loop_control_get_fd(d->control));
+	if ((len = readlink(path, name, sizeof(name) - 1)) < 0)
+		len = 0;
+	name[len] = '\0';
+
+	for (i = 0; i < d->n_clients; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, d->fds[i]) < 0) {
+			printf("socketpair failed: %s\n", strerror(errno));
+			return -1;
+		}
+		d->sources[i] = spa_loop_utils_add_io(d->utils, d->fds[i][0],
+						     SPA_IO_IN, false, on_client, d);
+	}
+	d->event = spa_loop_utils_add_event(d->utils, on_event, d);
+
+	spa_loop_control_enter(d->control);
+
+	d->handled = expected = 0;
+	t0 = get_time();
+	for (i = 0; i < d->n_rounds; i++) {
+		for (j = 0; j < ACTIVE_CLIENTS; j++) {
+			if (write(d->fds[next][1], "x", 1) != 1)
+				printf("write failed: %s\n", strerror(errno));
+			next = (next + 1) % d->n_clients;
+		}
+		spa_loop_utils_signal_event(d->utils, d->event);
+		expected += ACTIVE_CLIENTS + 1;
+
+		while (d->handled < expected)
+			spa_loop_control_iterate(d->control, -1);
+	}
+	t1 = get_time();
+
+	spa_loop_control_leave(d->control);
+
+	printf("%-8s (%s) %u clients: %8.1f ns/round, %6.1f ns/event\n",
+	       backend, name, d->n_clients,
+	       (double)(t1 - t0) / d->n_rounds,
+	       (double)(t1 - t0) / expected);
+
+	for (i = 0; i < d->n_clients; i++) {
+		spa_loop_utils_destroy_source(d->utils, d->sources[i]);
+		close(d->fds[i][0]);
+		close(d->fds[i][1]);
+	}
+	spa_loop_utils_destroy_source(d->utils, d->event);
+	spa_handle_clear(d->handle);
+	free(d->handle);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct spa_handle *handle;
+	void *iface;
+
+	data.n_clients = argc > 1 ? atoi(argv[1]) : DEFAULT_CLIENTS;
+	data.n_rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+	data.n_clients = SPA_CLAMP(data.n_clients, ACTIVE_CLIENTS, MAX_CLIENTS);
+	if (data.n_rounds == 0)
+		data.n_rounds = DEFAULT_ROUNDS;
+
+	if ((handle = make_handle(&data, "mapper", NULL, NULL, 0)) == NULL)
+		return -1;
+	/* the type map is always the first registered type */
+	if (spa_handle_get_interface(handle, 0, &iface) < 0)
+		return -1;
+	data.map = iface;
+
+	if (run(&data, "epoll") < 0)
+		return -1;
+	if (run(&data, "io_uring") < 0)
+		return -1;
+
+	return 0;
+}
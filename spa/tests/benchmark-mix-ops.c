@@ -0,0 +1,113 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mix-ops.h"
+
+#define N_SAMPLES	2048
+#define MAX_SOURCES	64
+#define MAX_COUNT	1000
+/* the destinations are rotated over more memory than the L2 cache holds,
+ * like the output buffers of a real graph, so that writing them is not
+ * free for the layered mix */
+#define DST_MEMORY	(32 * 1024 * 1024)
+#define N_DST		(DST_MEMORY / (N_SAMPLES * sizeof(float)))
+
+static const char *fmt_names[FMT_MAX] = { "s16", "f32" };
+static const int fmt_sizes[FMT_MAX] = { sizeof(int16_t), sizeof(float) };
+
+static float src_data[MAX_SOURCES][N_SAMPLES];
+static float (*dst_data)[N_SAMPLES];
+
+static uint64_t get_time(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+static void mix_layered(const struct spa_audiomixer_ops *ops, int fmt,
+			void *dst, const void *src[], const double gain[], uint32_t n_src, int n_bytes)
+{
+	uint32_t i;
+
+	ops->copy_scale[fmt](dst, src[0], gain[0], n_bytes);
+	for (i = 1; i < n_src; i++)
+		ops->add_scale[fmt](dst, src[i], gain[i], n_bytes);
+}
+
+static void run(const struct spa_audiomixer_ops *ops, int fmt, uint32_t n_src)
+{
+	const void *src[MAX_SOURCES];
+	double gain[MAX_SOURCES];
+	int n_bytes = N_SAMPLES * fmt_sizes[fmt], i;
+	uint64_t t0, t1, t2;
+	uint32_t j;
+
+	for (j = 0; j < n_src; j++) {
+		src[j] = src_data[j];
+		gain[j] = 0.5;
+	}
+
+	t0 = get_time();
+	for (i = 0; i < MAX_COUNT; i++)
+		mix_layered(ops, fmt, dst_data[i % N_DST], src, gain, n_src, n_bytes);
+	t1 = get_time();
+	for (i = 0; i < MAX_COUNT; i++)
+		ops->mix[fmt](dst_data[i % N_DST], src, gain, n_src, n_bytes);
+	t2 = get_time();
+
+	printf("%s %2d inputs: layered %7.3f ns/sample, fused %7.3f ns/sample\n",
+	       fmt_names[fmt], n_src,
+	       (double)(t1 - t0) / (MAX_COUNT * N_SAMPLES),
+	       (double)(t2 - t1) / (MAX_COUNT * N_SAMPLES));
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audiomixer_ops ops;
+	uint32_t cpu_flags, n_src;
+	int fmt, i, j;
+
+	for (i = 0; i < MAX_SOURCES; i++)
+		for (j = 0; j < N_SAMPLES; j++)
+			src_data[i][j] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+
+	/* touch all pages before the first run */
+	if ((dst_data = malloc(N_DST * sizeof(*dst_data))) == NULL)
+		return -1;
+	memset(dst_data, 0, N_DST * sizeof(*dst_data));
+
+	cpu_flags = argc > 1 ? strtoul(argv[1], NULL, 0) : spa_audiomixer_get_cpu_flags();
+	printf("cpu flags %08x\n", cpu_flags);
+
+	spa_audiomixer_get_ops_for_cpu(&ops, cpu_flags);
+
+	for (fmt = 0; fmt < FMT_MAX; fmt++)
+		for (n_src = 2; n_src <= MAX_SOURCES; n_src *= 2)
+			run(&ops, fmt, n_src);
+
+	free(dst_data);
+
+	return 0;
+}
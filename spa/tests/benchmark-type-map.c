@@ -0,0 +1,111 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/type-map.h>
+
+#define N_TYPES		4096
+#define MAX_COUNT	100
+
+static char names[N_TYPES][64];
+static uint32_t ids[N_TYPES];
+
+static uint64_t get_time(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+static struct spa_type_map *make_map(void)
+{
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t index = 0;
+	void *iface;
+	int res;
+
+	while ((res = spa_handle_factory_enum(&factory, &index)) > 0) {
+		if (strcmp(factory->name, "mapper"))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, handle, NULL, NULL, 0)) < 0) {
+			printf("can't make mapper: %d\n", res);
+			return NULL;
+		}
+		/* the type map is always the first registered type */
+		if ((res = spa_handle_get_interface(handle, 0, &iface)) < 0) {
+			printf("can't get type map interface: %d\n", res);
+			return NULL;
+		}
+		return iface;
+	}
+	printf("can't find mapper\n");
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_type_map *map;
+	uint64_t t0, t1, t2;
+	int i, j;
+
+	if ((map = make_map()) == NULL)
+		return -1;
+
+	/* type names share long prefixes, like the real ones */
+	for (i = 0; i < N_TYPES; i++)
+		snprintf(names[i], sizeof(names[i]),
+			 SPA_TYPE_ENUM_BASE "Benchmark:Type:%d:type%d", i % 64, i);
+
+	t0 = get_time();
+	for (i = 0; i < N_TYPES; i++)
+		ids[i] = spa_type_map_get_id(map, names[i]);
+	t1 = get_time();
+	for (j = 0; j < MAX_COUNT; j++) {
+		for (i = 0; i < N_TYPES; i++) {
+			if (spa_type_map_get_id(map, names[i]) != ids[i]) {
+				printf("type %s changed id\n", names[i]);
+				return -1;
+			}
+		}
+	}
+	t2 = get_time();
+
+	for (i = 0; i < N_TYPES; i++) {
+		if (strcmp(spa_type_map_get_type(map, ids[i]), names[i]) != 0) {
+			printf("wrong type for id %u\n", ids[i]);
+			return -1;
+		}
+	}
+
+	printf("%d types: register %7.1f ns/type, lookup %7.1f ns/lookup\n",
+	       N_TYPES,
+	       (double)(t1 - t0) / N_TYPES,
+	       (double)(t2 - t1) / (MAX_COUNT * N_TYPES));
+
+	return 0;
+}
@@ -0,0 +1,225 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/type-map.h>
+#include <spa/support/loop.h>
+
+#define MAX_THREADS	64
+#define DEFAULT_THREADS	8
+#define DEFAULT_COUNT	100000
+#define MAX_PAYLOAD	200
+
+struct msg {
+	uint32_t thread;
+	uint32_t count;
+	uint32_t len;
+	uint8_t payload[MAX_PAYLOAD];
+};
+
+static struct spa_loop *loop;
+static struct spa_loop_control *control;
+
+static int n_threads, n_count;
+static uint32_t last[MAX_THREADS];
+static uint64_t n_handled, n_errors, n_full;
+static bool async_only;
+static bool running = true;
+
+static const struct spa_handle_factory *find_factory(const char *name)
+{
+	const struct spa_handle_factory *factory;
+	uint32_t index = 0;
+
+	while (spa_handle_factory_enum(&factory, &index) > 0) {
+		if (strcmp(factory->name, name) == 0)
+			return factory;
+	}
+	printf("can't find %s\n", name);
+	return NULL;
+}
+
+static int make_loop(void)
+{
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	struct spa_type_map *map;
+	struct spa_support support[1];
+	void *iface;
+	int res;
+
+	if ((factory = find_factory("mapper")) == NULL)
+		return -ENOENT;
+	handle = calloc(1, factory->size);
+	if ((res = spa_handle_factory_init(factory, handle, NULL, NULL, 0)) < 0)
+		return res;
+	/* the type map is always the first registered type */
+	if ((res = spa_handle_get_interface(handle, 0, &iface)) < 0)
+		return res;
+	map = iface;
+
+	if ((factory = find_factory("loop")) == NULL)
+		return -ENOENT;
+	support[0].type = SPA_TYPE__TypeMap;
+	support[0].data = map;
+	handle = calloc(1, factory->size);
+	if ((res = spa_handle_factory_init(factory, handle, NULL, support, 1)) < 0)
+		return res;
+
+	if ((res = spa_handle_get_interface(handle,
+				spa_type_map_get_id(map, SPA_TYPE__Loop), &iface)) < 0)
+		return res;
+	loop = iface;
+	if ((res = spa_handle_get_interface(handle,
+				spa_type_map_get_id(map, SPA_TYPE__LoopControl), &iface)) < 0)
+		return res;
+	control = iface;
+
+	return 0;
+}
+
+/* runs in the loop thread, messages of one thread must arrive in order */
+static int do_msg(struct spa_loop *loop, bool async, uint32_t seq,
+		  const void *data, size_t size, void *user_data)
+{
+	const struct msg *m = data;
+	uint32_t i;
+
+	if (size != offsetof(struct msg, payload) + m->len || m->count != last[m->thread]) {
+		printf("thread %u: expected %u got %u\n", m->thread, last[m->thread], m->count);
+		n_errors++;
+	}
+	/* overlapping reservations corrupt the payload */
+	for (i = 0; i < m->len && i < MAX_PAYLOAD; i++) {
+		if (m->payload[i] != (uint8_t) (m->thread + m->count + i)) {
+			printf("thread %u: corrupt payload in %u\n", m->thread, m->count);
+			n_errors++;
+			break;
+		}
+	}
+	last[m->thread] = m->count + 1;
+	n_handled++;
+
+	return m->count;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		   const void *data, size_t size, void *user_data)
+{
+	running = false;
+	return 0;
+}
+
+static void *loop_start(void *arg)
+{
+	spa_loop_control_enter(control);
+	while (running)
+		spa_loop_control_iterate(control, -1);
+	spa_loop_control_leave(control);
+
+	return NULL;
+}
+
+static void *writer_start(void *arg)
+{
+	struct msg m = { SPA_PTR_TO_UINT32(arg), 0 };
+	uint32_t i;
+	int res;
+
+	while (m.count < n_count) {
+		/* mix blocking and async invokes of different sizes so that
+		 * the items wrap around the end of the queue */
+		bool block = !async_only && (m.count % 4) == 0;
+
+		m.len = (m.thread * 7 + m.count * 13) % MAX_PAYLOAD;
+		for (i = 0; i < m.len; i++)
+			m.payload[i] = m.thread + m.count + i;
+
+		res = spa_loop_invoke(loop, do_msg, SPA_ID_INVALID, &m,
+				      offsetof(struct msg, payload) + m.len, block, NULL);
+		if (res == -EPIPE) {
+			__atomic_add_fetch(&n_full, 1, __ATOMIC_RELAXED);
+			sched_yield();
+			continue;
+		}
+		if (block && res != m.count) {
+			printf("thread %u: wrong result %d for %u\n", m.thread, res, m.count);
+			__atomic_add_fetch(&n_errors, 1, __ATOMIC_RELAXED);
+		}
+		m.count++;
+	}
+	return NULL;
+}
+
+static int run(void)
+{
+	pthread_t loop_thread, threads[MAX_THREADS];
+	int i;
+
+	printf("starting loop stress test: %d threads, %d %sinvokes\n", n_threads, n_count,
+			async_only ? "async " : "");
+
+	memset(last, 0, sizeof(last));
+	n_handled = n_errors = n_full = 0;
+	running = true;
+
+	pthread_create(&loop_thread, NULL, loop_start, NULL);
+	for (i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, writer_start, SPA_UINT32_TO_PTR(i));
+	for (i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	spa_loop_invoke(loop, do_stop, SPA_ID_INVALID, NULL, 0, true, NULL);
+	pthread_join(loop_thread, NULL);
+
+	printf("handled %"PRIu64" invokes, %"PRIu64" errors, queue full %"PRIu64" times\n",
+			n_handled, n_errors, n_full);
+
+	return n_handled == (uint64_t) n_threads * n_count && n_errors == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+	n_threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+	n_count = argc > 2 ? atoi(argv[2]) : DEFAULT_COUNT;
+	n_threads = SPA_CLAMP(n_threads, 1, MAX_THREADS);
+
+	if (make_loop() < 0)
+		return -1;
+
+	if (run() < 0)
+		return -1;
+
+	/* only async invokes keep the queue busy, with more writers than
+	 * cpus some of them are preempted between loading the write index
+	 * and reserving, while the loop consumes past it */
+	async_only = true;
+	n_threads = SPA_CLAMP(sysconf(_SC_NPROCESSORS_ONLN) * 4, n_threads, MAX_THREADS);
+
+	return run();
+}
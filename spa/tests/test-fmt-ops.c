@@ -0,0 +1,208 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fmt-ops.h"
+#include "channelmix-ops.h"
+
+#define N_SAMPLES	1031
+#define MAX_CHANNELS	8
+
+static const char *conv_names[CONV_MAX] = {
+	"u8", "s8", "u16", "s16", "u24", "s24", "u24_32", "s24_32", "u32", "s32", "f32", "f64"
+};
+static const int n_samples[] = { 0, 1, 3, 7, 8, 15, 16, 17, 33, 255, N_SAMPLES };
+static const uint32_t n_channels[] = { 1, 2, 3, 6, MAX_CHANNELS };
+
+static float src_f32[MAX_CHANNELS][N_SAMPLES];
+static float tmp_f32[2][MAX_CHANNELS][N_SAMPLES + 1];
+static uint8_t packed[3][MAX_CHANNELS * N_SAMPLES * 8 + 8];
+
+static int n_failed;
+
+static void fill_random(void)
+{
+	int i, j;
+
+	/* go slightly out of range to test the clipping */
+	for (i = 0; i < MAX_CHANNELS; i++)
+		for (j = 0; j < N_SAMPLES; j++)
+			src_f32[i][j] = (rand() / (float) RAND_MAX) * 2.2f - 1.1f;
+	src_f32[0][0] = 1.0f;
+	src_f32[0][1] = -1.0f;
+	memset(tmp_f32, 0x55, sizeof(tmp_f32));
+	memset(packed, 0xaa, sizeof(packed));
+}
+
+static void get_planes(float **planes, int idx)
+{
+	int i;
+	for (i = 0; i < MAX_CHANNELS; i++)
+		planes[i] = tmp_f32[idx][i];
+}
+
+static int check(const char *what, int conv, int order, uint32_t cpu_flags,
+		 uint32_t channels, int n, int ok)
+{
+	if (ok)
+		return 0;
+	printf("%s %s%s cpu %08x: channels %d n %d failed\n", what,
+	       conv_names[conv], order == CONV_SWAP ? "_oe" : "", cpu_flags, channels, n);
+	n_failed++;
+	return -1;
+}
+
+static void test_ops(const struct spa_audioconvert_ops *ref,
+		     const struct spa_audioconvert_ops *ops, uint32_t cpu_flags)
+{
+	int conv, order, i;
+	uint32_t j, c;
+	const float *src[MAX_CHANNELS];
+	float *d0[MAX_CHANNELS], *d1[MAX_CHANNELS];
+
+	for (i = 0; i < MAX_CHANNELS; i++)
+		src[i] = src_f32[i];
+	get_planes(d0, 0);
+	get_planes(d1, 1);
+
+	for (conv = 0; conv < CONV_MAX; conv++) {
+		uint32_t size = spa_audioconvert_sample_size[conv];
+
+		for (order = 0; order < CONV_ORDER_MAX; order++) {
+			for (j = 0; j < SPA_N_ELEMENTS(n_channels); j++) {
+				for (i = 0; i < SPA_N_ELEMENTS(n_samples); i++) {
+					uint32_t channels = n_channels[j];
+					int n = n_samples[i];
+					size_t bytes = size * channels * n;
+
+					fill_random();
+
+					/* the optimized functions must produce the same samples,
+					 * and not touch anything past the end */
+					ref->from_f32d[conv][order](packed[0], src, channels, n);
+					ops->from_f32d[conv][order](packed[1], src, channels, n);
+					if (check("from_f32d", conv, order, cpu_flags, channels, n,
+						  memcmp(packed[0], packed[1], bytes + 8) == 0) < 0)
+						continue;
+
+					ref->to_f32d[conv][order](d0, packed[0], channels, n);
+					ops->to_f32d[conv][order](d1, packed[0], channels, n);
+					if (check("to_f32d", conv, order, cpu_flags, channels, n,
+						  memcmp(tmp_f32[0], tmp_f32[1], sizeof(tmp_f32[0])) == 0) < 0)
+						continue;
+
+					/* converting back must give the same samples again */
+					ops->from_f32d[conv][order](packed[2], (const float **) d1, channels, n);
+					if (check("round-trip", conv, order, cpu_flags, channels, n,
+						  memcmp(packed[0], packed[2], bytes) == 0) < 0)
+						continue;
+
+					/* and the floats must be close to the original, only the
+					 * integer formats clip */
+					for (c = 0; c < channels && n > 0; c++) {
+						float v = src_f32[c][n - 1];
+						if (conv < CONV_F32)
+							v = fmaxf(-1.0f, fminf(1.0f, v));
+						float tol = conv <= CONV_S8 ? 1.0f / 64.0f : 1.0f / 16384.0f;
+						if (check("precision", conv, order, cpu_flags, channels, n,
+							  fabsf(d1[c][n - 1] - v) <= tol) < 0)
+							break;
+					}
+				}
+			}
+		}
+	}
+}
+
+static void test_channelmix(void)
+{
+	struct channelmix mix;
+	const float *src[MAX_CHANNELS];
+	float *dst[MAX_CHANNELS];
+	int i;
+
+	fill_random();
+	for (i = 0; i < MAX_CHANNELS; i++)
+		src[i] = src_f32[i];
+	get_planes(dst, 0);
+
+	/* mono to stereo copies the channel */
+	channelmix_init(&mix, 1, 0, 2, 0);
+	channelmix_process(&mix, dst, src, N_SAMPLES);
+	for (i = 0; i < N_SAMPLES; i++) {
+		if (dst[0][i] != src[0][i] || dst[1][i] != src[0][i]) {
+			printf("channelmix 1->2 failed at %d\n", i);
+			n_failed++;
+			break;
+		}
+	}
+
+	/* stereo to mono averages */
+	channelmix_init(&mix, 2, 0, 1, 0);
+	channelmix_process(&mix, dst, src, N_SAMPLES);
+	for (i = 0; i < N_SAMPLES; i++) {
+		if (fabsf(dst[0][i] - (src[0][i] + src[1][i]) * 0.5f) > 1e-6f) {
+			printf("channelmix 2->1 failed at %d\n", i);
+			n_failed++;
+			break;
+		}
+	}
+
+	/* same channels is the identity */
+	channelmix_init(&mix, 3, 0, 3, 0);
+	if (!mix.identity) {
+		printf("channelmix 3->3 is not identity\n");
+		n_failed++;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audioconvert_ops ref, ops;
+	uint32_t cpu_flags, flags;
+	int i;
+
+	cpu_flags = spa_audioconvert_get_cpu_flags();
+	printf("cpu flags %08x\n", cpu_flags);
+
+	spa_audioconvert_get_ops_for_cpu(&ref, 0);
+
+	printf("testing cpu flags %08x\n", 0);
+	test_ops(&ref, &ref, 0);
+
+	for (i = 0; i < 32; i++) {
+		flags = cpu_flags & (1u << i);
+		if (flags == 0)
+			continue;
+		printf("testing cpu flags %08x\n", flags);
+		spa_audioconvert_get_ops_for_cpu(&ops, flags);
+		test_ops(&ref, &ops, flags);
+	}
+
+	test_channelmix();
+
+	printf("%d failures\n", n_failed);
+
+	return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <wchar.h>
+
+/* the binary trace encoder and decoder are internal to the logger */
+#include "logger.c"
+
+static int n_failed;
+
+/* encode the arguments like a binary trace message, decode them again and
+ * compare with @expected, or with vsnprintf when @expected is NULL */
+static void check(int line, bool encodable, const char *expected, const char *fmt, ...)
+{
+	uint64_t buffer[MAX_TRACE_ENTRY / sizeof(uint64_t)];
+	struct trace_entry *e = (struct trace_entry *) buffer;
+	uint32_t size = sizeof(struct trace_entry);
+	char text[1024], ref[1024];
+	va_list args;
+	bool res;
+
+	va_start(args, fmt);
+	res = encode_args((uint8_t *) buffer, &size, fmt, args);
+	va_end(args);
+
+	if (res != encodable) {
+		printf("line %d: \"%s\" encoded %d, expected %d\n", line, fmt, res, encodable);
+		n_failed++;
+		return;
+	}
+	if (!res)
+		return;
+
+	if (size > MAX_TRACE_ENTRY || (size & 7)) {
+		printf("line %d: \"%s\" invalid size %u\n", line, fmt, size);
+		n_failed++;
+		return;
+	}
+
+	e->size = size;
+	e->fmt = fmt;
+	decode_args(text, sizeof(text), e);
+
+	if (expected == NULL) {
+		va_start(args, fmt);
+		vsnprintf(ref, sizeof(ref), fmt, args);
+		va_end(args);
+		expected = ref;
+	}
+	if (strcmp(text, expected) != 0) {
+		printf("line %d: \"%s\" decoded \"%s\", expected \"%s\"\n",
+		       line, fmt, text, expected);
+		n_failed++;
+	}
+}
+
+#define CHECK(fmt,...)			check(__LINE__, true, NULL, fmt, ##__VA_ARGS__)
+#define CHECK_TEXT(text,fmt,...)	check(__LINE__, true, text, fmt, ##__VA_ARGS__)
+#define CHECK_FAIL(fmt,...)		check(__LINE__, false, NULL, fmt, ##__VA_ARGS__)
+
+static void test_numbers(void)
+{
+	int v = 42;
+
+	CHECK("no arguments");
+	CHECK("%d %i %u %x %X %o", -1, 2, 3u, 0xabu, 0xcdu, 8);
+	CHECK("%hhd %hd %hu", 300, 70000, 70000);
+	CHECK("%ld %lu %lld %llu", -5l, 5ul, -6ll, 6ull);
+	CHECK("%zd %zu %jd %td", (ssize_t) -3, (size_t) 3, (intmax_t) -9, (ptrdiff_t) -1);
+	CHECK("%" PRIu64 " %" PRIi64, UINT64_MAX, INT64_MIN);
+	CHECK("%c%c", 'o', 'k');
+	CHECK("%#x %+d % d %-4d| %04d", 255u, 1, 2, 3, 4);
+	CHECK("%f %e %g %a %.3f %E", 1.5, -2.25, 1e10, 1.0, 3.14159, 0.001);
+	CHECK("%p %p", &v, NULL);
+	CHECK("100%% %d%%", 5);
+	CHECK("%*d|%-*d|%.*f|%*.*f", 6, 1, 4, 2, 2, 2.71828, 9, 3, 3.14159);
+	CHECK_FAIL("tail %");
+}
+
+static void test_strings(void)
+{
+	const char unterminated[] = { 'a', 'b', 'c', 'd' };
+	char longer[MAX_TRACE_STRING * 2], truncated[MAX_TRACE_STRING];
+
+	memset(longer, 'x', sizeof(longer) - 1);
+	longer[sizeof(longer) - 1] = '\0';
+	memset(truncated, 'x', sizeof(truncated) - 1);
+	truncated[sizeof(truncated) - 1] = '\0';
+
+	CHECK("%s and %s", "one", "two");
+	CHECK("%s", "");
+	CHECK("[%8s] [%-8s]", "right", "left");
+	CHECK_TEXT("null (null) 5", "null %s %d", (const char *) NULL, 5);
+
+	/* a precision limits what is read of the string */
+	CHECK("%.2s", "abcdef");
+	CHECK("%.*s", 4, unterminated);
+	CHECK_TEXT("ab||", "%.*s|%.0s|", 2, unterminated, unterminated);
+	CHECK("%4.*s|", 3, unterminated);
+	CHECK("%.*s", -1, "negative precision is ignored");
+
+	/* strings are cut at the maximum size of the trace */
+	CHECK_TEXT(truncated, "%s", longer);
+	CHECK_TEXT(truncated, "%.200s", longer);
+	CHECK_TEXT("abc", "%.*s", MAX_TRACE_STRING * 4, "abc");
+}
+
+static void test_unsupported(void)
+{
+	int n;
+	char big[MAX_TRACE_STRING];
+
+	memset(big, 'y', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+
+	CHECK_FAIL("%ls", L"wide");
+	CHECK_FAIL("%lc", (wint_t) 'w');
+	CHECK_FAIL("%Lf", (long double) 1.0);
+	CHECK_FAIL("%n", &n);
+	CHECK_FAIL("%m");
+	/* the arguments do not fit in one trace entry */
+	CHECK_FAIL("%s %s %s %s", big, big, big, big);
+}
+
+int main(int argc, char *argv[])
+{
+	test_numbers();
+	test_strings();
+	test_unsupported();
+
+	printf("%d failures\n", n_failed);
+
+	return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mix-ops.h"
+
+#define N_SAMPLES	1031
+#define MAX_OFFSET	7
+#define MAX_SOURCES	33
+#define SRC_SIZE	(N_SAMPLES + MAX_OFFSET + MAX_SOURCES * 5)
+
+static const char *fmt_names[FMT_MAX] = { "s16", "f32" };
+static const int fmt_sizes[FMT_MAX] = { sizeof(int16_t), sizeof(float) };
+static const double scales[] = { 0.0, 0.25, 0.5, 0.7071, 1.0, 1.3, 3.0, 9.99, 20.0 };
+static const int n_samples[] = { 0, 1, 3, 7, 8, 15, 16, 17, 31, 32, 33, 64, 255, N_SAMPLES };
+static const uint32_t n_sources[] = { 0, 1, 2, 3, 8, MAX_SOURCES };
+
+static int16_t src_s16[SRC_SIZE];
+static int16_t dst_s16[2][N_SAMPLES + MAX_OFFSET];
+static float src_f32[SRC_SIZE];
+static float dst_f32[2][N_SAMPLES + MAX_OFFSET];
+
+static int n_failed;
+
+static void fill_random(void)
+{
+	int i;
+
+	for (i = 0; i < SRC_SIZE; i++) {
+		src_s16[i] = (rand() & 0xffff) - 0x8000;
+		src_f32[i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+	}
+	for (i = 0; i < N_SAMPLES + MAX_OFFSET; i++) {
+		dst_s16[0][i] = dst_s16[1][i] = (rand() & 0xffff) - 0x8000;
+		dst_f32[0][i] = dst_f32[1][i] = (rand() / (float) RAND_MAX) * 2.0f - 1.0f;
+	}
+}
+
+static void *get_src(int fmt, int offset)
+{
+	return fmt == FMT_S16 ? (void *) &src_s16[offset] : (void *) &src_f32[offset];
+}
+
+static void *get_dst(int fmt, int idx, int offset)
+{
+	return fmt == FMT_S16 ? (void *) &dst_s16[idx][offset] : (void *) &dst_f32[idx][offset];
+}
+
+static void compare(const char *op, int fmt, uint32_t cpu_flags,
+		    double scale, int n, int offset)
+{
+	int i;
+
+	/* also compare past the end to catch overruns of the tail loop */
+	for (i = 0; i < N_SAMPLES + MAX_OFFSET; i++) {
+		if (fmt == FMT_S16) {
+			if (dst_s16[0][i] == dst_s16[1][i])
+				continue;
+			printf("%s_%s cpu %08x: scale %f n %d offset %d: %d != %d at %d\n",
+			       op, fmt_names[fmt], cpu_flags, scale, n, offset,
+			       dst_s16[0][i], dst_s16[1][i], i);
+		} else {
+			if (fabsf(dst_f32[0][i] - dst_f32[1][i]) <= 1e-6f)
+				continue;
+			printf("%s_%s cpu %08x: scale %f n %d offset %d: %f != %f at %d\n",
+			       op, fmt_names[fmt], cpu_flags, scale, n, offset,
+			       dst_f32[0][i], dst_f32[1][i], i);
+		}
+		n_failed++;
+		return;
+	}
+}
+
+static void test_ops(const struct spa_audiomixer_ops *ref,
+		     const struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	int fmt, i, j, offset;
+	uint32_t k, l;
+	const void *srcs[MAX_SOURCES];
+	double gains[MAX_SOURCES];
+
+	for (fmt = 0; fmt < FMT_MAX; fmt++) {
+		for (i = 0; i < SPA_N_ELEMENTS(n_samples); i++) {
+			int n_bytes = n_samples[i] * fmt_sizes[fmt];
+
+			for (offset = 0; offset < MAX_OFFSET; offset++) {
+				fill_random();
+				ref->clear[fmt](get_dst(fmt, 0, offset), n_bytes);
+				ops->clear[fmt](get_dst(fmt, 1, offset), n_bytes);
+				compare("clear", fmt, cpu_flags, 0.0, n_samples[i], offset);
+
+				fill_random();
+				ref->copy[fmt](get_dst(fmt, 0, offset), get_src(fmt, offset), n_bytes);
+				ops->copy[fmt](get_dst(fmt, 1, offset), get_src(fmt, offset), n_bytes);
+				compare("copy", fmt, cpu_flags, 0.0, n_samples[i], offset);
+
+				fill_random();
+				ref->add[fmt](get_dst(fmt, 0, offset), get_src(fmt, offset), n_bytes);
+				ops->add[fmt](get_dst(fmt, 1, offset), get_src(fmt, offset), n_bytes);
+				compare("add", fmt, cpu_flags, 0.0, n_samples[i], offset);
+
+				for (j = 0; j < SPA_N_ELEMENTS(scales); j++) {
+					fill_random();
+					ref->copy_scale[fmt](get_dst(fmt, 0, offset),
+							get_src(fmt, offset), scales[j], n_bytes);
+					ops->copy_scale[fmt](get_dst(fmt, 1, offset),
+							get_src(fmt, offset), scales[j], n_bytes);
+					compare("copy_scale", fmt, cpu_flags, scales[j], n_samples[i], offset);
+
+					fill_random();
+					ref->add_scale[fmt](get_dst(fmt, 0, offset),
+							get_src(fmt, offset), scales[j], n_bytes);
+					ops->add_scale[fmt](get_dst(fmt, 1, offset),
+							get_src(fmt, offset), scales[j], n_bytes);
+					compare("add_scale", fmt, cpu_flags, scales[j], n_samples[i], offset);
+				}
+
+				for (k = 0; k < SPA_N_ELEMENTS(n_sources); k++) {
+					for (l = 0; l < n_sources[k]; l++) {
+						srcs[l] = get_src(fmt, offset + l * 5);
+						gains[l] = scales[l % SPA_N_ELEMENTS(scales)];
+					}
+					fill_random();
+					ref->mix[fmt](get_dst(fmt, 0, offset), srcs, gains,
+							n_sources[k], n_bytes);
+					ops->mix[fmt](get_dst(fmt, 1, offset), srcs, gains,
+							n_sources[k], n_bytes);
+					compare("mix", fmt, cpu_flags, n_sources[k], n_samples[i], offset);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audiomixer_ops ref, ops;
+	uint32_t cpu_flags, flags;
+	int i;
+
+	cpu_flags = spa_audiomixer_get_cpu_flags();
+	printf("cpu flags %08x\n", cpu_flags);
+
+	spa_audiomixer_get_ops_for_cpu(&ref, 0);
+
+	/* test every SIMD level on its own and then all levels combined */
+	for (i = 0; i < 32; i++) {
+		flags = cpu_flags & (1u << i);
+		if (flags == 0)
+			continue;
+		printf("testing cpu flags %08x\n", flags);
+		spa_audiomixer_get_ops_for_cpu(&ops, flags);
+		test_ops(&ref, &ops, flags);
+	}
+	printf("testing cpu flags %08x\n", cpu_flags);
+	spa_audiomixer_get_ops_for_cpu(&ops, cpu_flags);
+	test_ops(&ref, &ops, cpu_flags);
+
+	printf("%d failures\n", n_failed);
+
+	return n_failed == 0 ? 0 : 1;
+}
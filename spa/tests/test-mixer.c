@@ -50,7 +50,7 @@ static SPA_LOG_IMPL(default_log);
 #define spa_debug(...)	spa_log_trace(&default_log.log,__VA_ARGS__)
 
 #include <spa/graph/graph.h>
-#include <spa/graph/graph-scheduler1.h>
+#include <spa/graph/graph-scheduler6.h>
 
 struct type {
 	uint32_t node;
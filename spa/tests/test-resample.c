@@ -0,0 +1,166 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "resample.h"
+
+#define N_CHANNELS	2
+#define N_SAMPLES	4096
+#define MAX_OUT		(N_SAMPLES * 8)
+
+static float src_f32[N_CHANNELS][N_SAMPLES];
+static float dst_f32[2][N_CHANNELS][MAX_OUT];
+
+static const uint32_t rates[][2] = {
+	{ 44100, 48000 },
+	{ 48000, 44100 },
+	{ 48000, 48000 },
+	{ 8000, 48000 },
+	{ 48000, 16000 },
+	{ 44100, 44101 },
+};
+
+static int n_failed;
+
+static void fill_sine(uint32_t rate, double freq)
+{
+	uint32_t i, c;
+
+	for (c = 0; c < N_CHANNELS; c++)
+		for (i = 0; i < N_SAMPLES; i++)
+			src_f32[c][i] = 0.5 * sin(2 * M_PI * freq * i / rate + c);
+}
+
+/* feed the input in chunks of \a chunk samples and collect all output */
+static uint32_t run(struct resample *r, int idx, uint32_t chunk)
+{
+	const float *src[N_CHANNELS];
+	float *dst[N_CHANNELS];
+	uint32_t c, in_done = 0, out_done = 0, in_len, out_len;
+
+	while (in_done < N_SAMPLES) {
+		for (c = 0; c < N_CHANNELS; c++) {
+			src[c] = &src_f32[c][in_done];
+			dst[c] = &dst_f32[idx][c][out_done];
+		}
+		in_len = SPA_MIN(chunk, N_SAMPLES - in_done);
+		out_len = MAX_OUT - out_done;
+		resample_process(r, src, &in_len, dst, &out_len);
+		in_done += in_len;
+		out_done += out_len;
+		if (in_len == 0 && out_len == 0)
+			break;
+	}
+	return out_done;
+}
+
+static void test_rates(uint32_t cpu_flags, int quality, double rate)
+{
+	struct resample r0, r1;
+	uint32_t i, j, c, n0, n1, expected, delay;
+	double freq;
+
+	for (i = 0; i < SPA_N_ELEMENTS(rates); i++) {
+		memset(&r0, 0, sizeof(r0));
+		r0.channels = N_CHANNELS;
+		r0.i_rate = rates[i][0];
+		r0.o_rate = rates[i][1];
+		r0.quality = quality;
+		r0.rate = rate;
+		r1 = r0;
+		r1.cpu_flags = cpu_flags;
+
+		if (resample_native_init(&r0) < 0 || resample_native_init(&r1) < 0) {
+			printf("init failed\n");
+			n_failed++;
+			return;
+		}
+		/* well inside the pass band of all qualities */
+		freq = SPA_MIN(r0.i_rate, r0.o_rate) / 40.0;
+		fill_sine(r0.i_rate, freq);
+
+		/* the chunking must not change the result */
+		n0 = run(&r0, 0, N_SAMPLES);
+		n1 = run(&r1, 1, 13);
+
+		delay = resample_delay(&r0);
+		expected = (N_SAMPLES - delay) * (double) r0.o_rate / r0.i_rate / rate;
+		if (n0 != n1 || abs((int) n0 - (int) expected) > 2) {
+			printf("cpu %08x quality %d rate %f %d->%d: %d and %d samples, expected %d\n",
+			       cpu_flags, quality, rate, r0.i_rate, r0.o_rate, n0, n1, expected);
+			n_failed++;
+			goto done;
+		}
+		for (c = 0; c < N_CHANNELS; c++) {
+			float max = 0.0f;
+
+			for (j = 0; j < n0; j++) {
+				if (fabsf(dst_f32[0][c][j] - dst_f32[1][c][j]) > 1e-5f) {
+					printf("cpu %08x quality %d rate %f %d->%d: %f != %f at %d\n",
+					       cpu_flags, quality, rate, r0.i_rate, r0.o_rate,
+					       dst_f32[0][c][j], dst_f32[1][c][j], j);
+					n_failed++;
+					goto done;
+				}
+				if (j > n0 / 4)
+					max = fmaxf(max, fabsf(dst_f32[0][c][j]));
+			}
+			/* the sine must pass with the same amplitude */
+			if (fabsf(max - 0.5f) > 0.01f) {
+				printf("cpu %08x quality %d rate %f %d->%d: amplitude %f\n",
+				       cpu_flags, quality, rate, r0.i_rate, r0.o_rate, max);
+				n_failed++;
+				goto done;
+			}
+		}
+	      done:
+		resample_free(&r0);
+		resample_free(&r1);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const double adjust[] = { 1.0, 1.001, 0.999, 1.05 };
+	uint32_t cpu_flags, flags;
+	int i, q, a;
+
+	cpu_flags = resample_get_cpu_flags();
+	setvbuf(stdout, NULL, _IONBF, 0);
+	printf("cpu flags %08x\n", cpu_flags);
+
+	for (i = -1; i < 32; i++) {
+		flags = i < 0 ? 0 : cpu_flags & (1u << i);
+		if (i >= 0 && flags == 0)
+			continue;
+		printf("testing cpu flags %08x\n", flags);
+		for (q = RESAMPLE_MIN_QUALITY; q <= RESAMPLE_MAX_QUALITY; q++)
+			for (a = 0; a < SPA_N_ELEMENTS(adjust); a++)
+				test_rates(flags, q, adjust[a]);
+	}
+
+	printf("%d failures\n", n_failed);
+
+	return n_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/interfaces.h>
+#include <pipewire/type.h>
+
+#define DEFAULT_ROUNDS	1000
+
+struct object {
+	struct spa_list link;
+	struct data *data;
+	struct pw_proxy *proxy;
+	uint32_t type;
+	struct spa_hook proxy_listener;
+	struct spa_hook listener;
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+	struct pw_type *t;
+
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct pw_core_proxy *core_proxy;
+
+	struct pw_registry_proxy *registry_proxy;
+	struct spa_hook registry_listener;
+
+	struct spa_list objects;
+
+	uint32_t seq;
+	uint32_t rounds;
+	uint32_t round;
+
+	uint64_t n_params;
+	uint64_t n_bytes;
+	uint64_t start;
+};
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void on_param(void *object, uint32_t id, uint32_t index, uint32_t next,
+		const struct spa_pod *param)
+{
+	struct object *o = object;
+	struct data *d = o->data;
+
+	d->n_params++;
+	d->n_bytes += SPA_POD_SIZE(param);
+}
+
+static const struct pw_node_proxy_events node_events = {
+	PW_VERSION_NODE_PROXY_EVENTS,
+	.param = on_param,
+};
+
+static const struct pw_port_proxy_events port_events = {
+	PW_VERSION_PORT_PROXY_EVENTS,
+	.param = on_param,
+};
+
+/* queue one enum_params request on every object and a sync to
+ * find the end of the replies */
+static void do_round(struct data *d)
+{
+	struct object *o;
+
+	spa_list_for_each(o, &d->objects, link) {
+		if (o->type == d->t->node)
+			pw_node_proxy_enum_params((struct pw_node_proxy*)o->proxy,
+					d->t->param.idList, 0, 0, NULL);
+		else
+			pw_port_proxy_enum_params((struct pw_port_proxy*)o->proxy,
+					d->t->param.idEnumFormat, 0, 0, NULL);
+	}
+	pw_core_proxy_sync(d->core_proxy, ++d->seq);
+}
+
+static void on_sync_reply(void *data, uint32_t seq)
+{
+	struct data *d = data;
+	uint64_t elapsed;
+
+	if (seq != d->seq)
+		return;
+
+	if (d->round == 0) {
+		if (spa_list_is_empty(&d->objects)) {
+			fprintf(stderr, "no nodes or ports found\n");
+			pw_main_loop_quit(d->loop);
+			return;
+		}
+		d->start = get_time_ns();
+	}
+	else if (d->round == d->rounds) {
+		elapsed = get_time_ns() - d->start;
+
+		printf("%u rounds: %"PRIu64" params, %"PRIu64" bytes in %f s\n",
+				d->rounds, d->n_params, d->n_bytes, elapsed / (double)SPA_NSEC_PER_SEC);
+		printf("%f params/s, %f MB/s\n",
+				d->n_params * (double)SPA_NSEC_PER_SEC / elapsed,
+				d->n_bytes * 1000.0 / elapsed);
+		pw_main_loop_quit(d->loop);
+		return;
+	}
+	d->round++;
+	do_round(d);
+}
+
+static void destroy_object(void *data)
+{
+	struct object *o = data;
+	spa_list_remove(&o->link);
+}
+
+static const struct pw_proxy_events proxy_events = {
+	PW_VERSION_PROXY_EVENTS,
+	.destroy = destroy_object,
+};
+
+static void registry_event_global(void *data, uint32_t id, uint32_t parent_id,
+				  uint32_t permissions, uint32_t type, uint32_t version,
+				  const struct spa_dict *props)
+{
+	struct data *d = data;
+	struct pw_proxy *proxy;
+	struct object *o;
+
+	if (d->round > 0)
+		return;
+
+	if (type == d->t->node) {
+		proxy = pw_registry_proxy_bind(d->registry_proxy, id, type,
+					       PW_VERSION_NODE, sizeof(struct object));
+		if (proxy == NULL)
+			return;
+		o = pw_proxy_get_user_data(proxy);
+		pw_proxy_add_proxy_listener(proxy, &o->proxy_listener, &node_events, o);
+	}
+	else if (type == d->t->port) {
+		proxy = pw_registry_proxy_bind(d->registry_proxy, id, type,
+					       PW_VERSION_PORT, sizeof(struct object));
+		if (proxy == NULL)
+			return;
+		o = pw_proxy_get_user_data(proxy);
+		pw_proxy_add_proxy_listener(proxy, &o->proxy_listener, &port_events, o);
+	}
+	else
+		return;
+
+	o->data = d;
+	o->proxy = proxy;
+	o->type = type;
+	spa_list_append(&d->objects, &o->link);
+	pw_proxy_add_listener(proxy, &o->listener, &proxy_events, o);
+}
+
+static const struct pw_registry_proxy_events registry_events = {
+	PW_VERSION_REGISTRY_PROXY_EVENTS,
+	.global = registry_event_global,
+};
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *data = _data;
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		printf("remote error: %s\n", error);
+		pw_main_loop_quit(data->loop);
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		data->core_proxy = pw_remote_get_core_proxy(data->remote);
+		data->registry_proxy = pw_core_proxy_get_registry(data->core_proxy,
+								  data->t->registry,
+								  PW_VERSION_REGISTRY, 0);
+		pw_registry_proxy_add_listener(data->registry_proxy,
+					       &data->registry_listener,
+					       &registry_events, data);
+		/* the reply comes after all globals */
+		pw_core_proxy_sync(data->core_proxy, ++data->seq);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.state_changed = on_state_changed,
+	.sync_reply = on_sync_reply,
+};
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+
+	pw_init(&argc, &argv);
+
+	data.rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+	if (data.rounds == 0)
+		data.rounds = DEFAULT_ROUNDS;
+
+	data.loop = pw_main_loop_new(NULL);
+	if (data.loop == NULL)
+		return -1;
+
+	data.core = pw_core_new(pw_main_loop_get_loop(data.loop), NULL);
+	if (data.core == NULL)
+		return -1;
+	data.t = pw_core_get_type(data.core);
+
+	data.remote = pw_remote_new(data.core, NULL, 0);
+	if (data.remote == NULL)
+		return -1;
+
+	spa_list_init(&data.objects);
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+	if (pw_remote_connect(data.remote) < 0)
+		return -1;
+
+	pw_main_loop_run(data.loop);
+
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(data.loop);
+
+	return 0;
+}
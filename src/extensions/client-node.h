@@ -25,6 +25,7 @@ extern "C" {
 #endif
 
 #include <spa/utils/defs.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/param/param.h>
 #include <spa/node/node.h>
 
@@ -44,6 +45,32 @@ struct pw_client_node_area {
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	uint32_t buffer_size;		/**< size of the memory of each ringbuffer,
+					  *  a power of 2 */
+};
+
+/** Wakeup state of the side that reads a ringbuffer of the transport,
+ * shared between client and server \memberof pw_client_node */
+struct pw_client_node_activation {
+	int32_t pending;	/**< the reader was woken up and will read the new
+				  *  messages, no other wakeup is needed */
+	int32_t trigger;	/**< number of times a peer client placed buffers
+				  *  on the input io of the reader directly, only
+				  *  used in \ref pw_client_node_peer_area */
+	uint32_t dropped;	/**< number of messages for the reader that were
+				  *  dropped because the ringbuffer was full */
+};
+
+/** Memory shared between a client and the peer client that triggers one of
+ * its input ports directly. It only contains what the peer needs to hand
+ * over a buffer. \memberof pw_client_node */
+struct pw_client_node_peer_area {
+	struct pw_client_node_activation activation;	/**< activation of the client
+							  *  for this input port */
+	struct spa_io_buffers io;			/**< io of the input port */
+	uint32_t taken;					/**< number of times the client
+							  *  took the triggers, the server
+							  *  checks it for progress */
 };
 
 /** \class pw_client_node_transport
@@ -62,6 +89,10 @@ struct pw_client_node_transport {
 	struct spa_ringbuffer *input_buffer;	/**< ringbuffer for input memory */
 	void *output_data;			/**< output memory for ringbuffer */
 	struct spa_ringbuffer *output_buffer;	/**< ringbuffer for output memory */
+	struct pw_client_node_activation *input_activation;	/**< activation of the
+								  *  reader of input memory */
+	struct pw_client_node_activation *output_activation;	/**< activation of the
+								  *  reader of output memory */
 
 	/** Destroy a transport
 	 * \param trans a transport to destroy
@@ -152,6 +183,94 @@ struct pw_client_node_message_port_reuse_buffer {
 		SPA_POD_INT_INIT(port_id),							\
 		SPA_POD_INT_INIT(buffer_id))
 
+/** Signal the other side after adding messages
+ * \param trans the transport
+ * \return true when the other side needs to be woken up
+ *
+ * The other side only needs a wakeup on its fd when it was not woken up
+ * already, the messages that are added before it reads them are
+ * delivered with the same wakeup.
+ *
+ * \memberof pw_client_node_transport
+ */
+static inline bool pw_client_node_transport_signal(struct pw_client_node_transport *trans)
+{
+	return __atomic_exchange_n(&trans->output_activation->pending, 1, __ATOMIC_SEQ_CST) == 0;
+}
+
+/** Finish reading messages
+ * \param trans the transport
+ * \return true when new messages arrived and should be read
+ *
+ * Call this when \ref next_message() returns no more messages, before
+ * waiting for a new wakeup. When this returns true, the other side did
+ * not wake us up and the messages should be read now.
+ *
+ * \memberof pw_client_node_transport
+ */
+static inline bool pw_client_node_transport_idle(struct pw_client_node_transport *trans)
+{
+	uint32_t index;
+
+	__atomic_store_n(&trans->input_activation->pending, 0, __ATOMIC_SEQ_CST);
+	if (spa_ringbuffer_get_read_index(trans->input_buffer, &index) <
+	    (int32_t) sizeof(struct pw_client_node_message))
+		return false;
+
+	__atomic_store_n(&trans->input_activation->pending, 1, __ATOMIC_SEQ_CST);
+	return true;
+}
+
+/** Trigger the client of a peer area
+ * \param area the peer area, as received with port_set_peer
+ * \return true when the peer needs to be woken up
+ *
+ * Call this after placing a buffer on the io of the peer area. The peer
+ * processes its input without waiting for a message from the server.
+ *
+ * \memberof pw_client_node
+ */
+static inline bool pw_client_node_peer_trigger(struct pw_client_node_peer_area *area)
+{
+	__atomic_add_fetch(&area->activation.trigger, 1, __ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&area->activation.pending, 1, __ATOMIC_SEQ_CST) == 0;
+}
+
+/** Take the pending triggers
+ * \param area the peer area
+ * \return the number of times the peer triggered us since the last call
+ *
+ * The server stops the direct link when the triggers are not taken for a
+ * while, the peer then goes through the server again.
+ *
+ * \memberof pw_client_node
+ */
+static inline int32_t pw_client_node_peer_take_trigger(struct pw_client_node_peer_area *area)
+{
+	__atomic_add_fetch(&area->taken, 1, __ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&area->activation.trigger, 0, __ATOMIC_SEQ_CST);
+}
+
+/** Finish processing the triggers of the peer
+ * \param area the peer area
+ * \return true when the peer triggered us again and the input should be
+ *	processed now
+ *
+ * Call this together with \ref pw_client_node_transport_idle() before
+ * waiting for a new wakeup.
+ *
+ * \memberof pw_client_node
+ */
+static inline bool pw_client_node_peer_idle(struct pw_client_node_peer_area *area)
+{
+	__atomic_store_n(&area->activation.pending, 0, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&area->activation.trigger, __ATOMIC_SEQ_CST) == 0)
+		return false;
+
+	__atomic_store_n(&area->activation.pending, 1, __ATOMIC_SEQ_CST);
+	return true;
+}
+
 /** information about a buffer */
 struct pw_client_node_buffer {
 	uint32_t mem_id;		/**< the memory id for the metadata */
@@ -299,7 +418,8 @@ pw_client_node_proxy_destroy(struct pw_client_node_proxy *p)
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_USE_BUFFERS	8
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_COMMAND		9
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_SET_IO		10
-#define PW_CLIENT_NODE_PROXY_EVENT_NUM			11
+#define PW_CLIENT_NODE_PROXY_EVENT_PORT_SET_PEER	11
+#define PW_CLIENT_NODE_PROXY_EVENT_NUM			12
 
 /** \ref pw_client_node events */
 struct pw_client_node_proxy_events {
@@ -446,6 +566,34 @@ struct pw_client_node_proxy_events {
 			     uint32_t mem_id,
 			     uint32_t offset,
 			     uint32_t size);
+	/**
+	 * Set the peer of a port that is triggered directly.
+	 *
+	 * The server allocates a \ref pw_client_node_peer_area for the link
+	 * and sends it to both clients. For an output port, the client places
+	 * its buffers on the io of the area, calls
+	 * \ref pw_client_node_peer_trigger() and wakes up the peer with
+	 * \a writefd when needed. For an input port, \a writefd is -1, the
+	 * client uses the io of the area for the port, receives its buffers
+	 * from the peer and should recycle them with reuse_buffer messages.
+	 *
+	 * \param direction the direction of the port
+	 * \param port_id the port id
+	 * \param peer_port_id the port id of the peer or SPA_ID_INVALID
+	 *	when the port is no longer triggered directly
+	 * \param writefd fd to wake up the peer
+	 * \param memfd fd of the memory with the peer area or -1
+	 * \param offset offset of the peer area in \a memfd
+	 * \param size size of the peer area
+	 */
+	void (*port_set_peer) (void *object,
+			       enum spa_direction direction,
+			       uint32_t port_id,
+			       uint32_t peer_port_id,
+			       int writefd,
+			       int memfd,
+			       uint32_t offset,
+			       uint32_t size);
 };
 
 static inline void
@@ -479,6 +627,8 @@ pw_client_node_proxy_add_listener(struct pw_client_node_proxy *p,
 	pw_resource_notify(r,struct pw_client_node_proxy_events,port_command,__VA_ARGS__)
 #define pw_client_node_resource_port_set_io(r,...)	\
 	pw_resource_notify(r,struct pw_client_node_proxy_events,port_set_io,__VA_ARGS__)
+#define pw_client_node_resource_port_set_peer(r,...)	\
+	pw_resource_notify(r,struct pw_client_node_proxy_events,port_set_peer,__VA_ARGS__)
 
 #ifdef __cplusplus
 }  /* extern "C" */
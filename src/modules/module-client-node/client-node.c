@@ -47,6 +47,11 @@
 
 #define MAX_BUFFERS      64
 
+/* how often the server checks the direct links and after how many checks
+ * without progress it gives up on them */
+#define PEER_CHECK_MSEC		100
+#define PEER_CHECK_STALLED	10
+
 #define CHECK_IN_PORT_ID(this,d,p)       ((d) == SPA_DIRECTION_INPUT && (p) < MAX_INPUTS)
 #define CHECK_OUT_PORT_ID(this,d,p)      ((d) == SPA_DIRECTION_OUTPUT && (p) < MAX_OUTPUTS)
 #define CHECK_PORT_ID(this,d,p)          (CHECK_IN_PORT_ID(this,d,p) || CHECK_OUT_PORT_ID(this,d,p))
@@ -92,6 +97,17 @@ struct port {
 
 	uint32_t n_buffers;
 	struct buffer buffers[MAX_BUFFERS];
+
+	struct pw_port *port;
+	struct spa_hook port_listener;
+	struct spa_node mix;		/**< the original mixer or tee of the port */
+
+	struct impl *peer;		/**< client we trigger (output port) or client
+					  *  that triggers us (input port) directly */
+	uint32_t peer_port_id;
+	struct pw_memblock *peer_mem;	/**< peer area shared by both clients (output port) */
+	uint32_t peer_taken;		/**< taken triggers at the last check (output port) */
+	uint32_t peer_stalled;		/**< checks without progress of the peer (output port) */
 };
 
 struct node {
@@ -128,6 +144,7 @@ struct impl {
 	struct pw_client_node this;
 
 	bool client_reuse;
+	bool client_direct;
 
 	struct pw_core *core;
 	struct pw_type *t;
@@ -135,6 +152,8 @@ struct impl {
 	struct node node;
 
 	struct pw_client_node_transport *transport;
+	uint32_t max_inputs;		/**< number of input io in the transport */
+	uint32_t max_outputs;		/**< number of output io in the transport */
 
 	struct spa_hook node_listener;
 	struct spa_hook resource_listener;
@@ -146,6 +165,15 @@ struct impl {
 
 	uint32_t input_ready;
 	bool out_pending;
+
+	struct spa_source *dropped_event;
+	uint32_t dropped[2];		/**< dropped messages from and to the client,
+					  *  as last seen by the data thread */
+
+	struct pw_array old_peer_mems;	/**< peer areas to free after the events
+					  *  with their fd were sent */
+	struct spa_source *peer_mem_event;
+	struct spa_source *peer_timer;	/**< checks that the peers take the triggers */
 };
 
 /** \endcond */
@@ -267,6 +295,10 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 static inline void do_flush(struct node *this)
 {
 	uint64_t cmd = 1;
+
+	if (!pw_client_node_transport_signal(this->impl->transport))
+		return;
+
 	if (write(this->writefd, &cmd, 8) != 8)
 		spa_log_warn(this->log, "node %p: error flushing : %s", this, strerror(errno));
 
@@ -704,13 +736,10 @@ impl_node_port_use_buffers(struct spa_node *node,
 		if ((mem = pw_memblock_find(baseptr)) == NULL)
 			return -EINVAL;
 
-		data_size = 0;
-		for (j = 0; j < buffers[i]->n_metas; j++) {
-			data_size += buffers[i]->metas[j].size;
-		}
+		data_size = pw_buffer_header_size(buffers[i]->metas, buffers[i]->n_metas,
+						  buffers[i]->n_datas);
 		for (j = 0; j < buffers[i]->n_datas; j++) {
 			struct spa_data *d = buffers[i]->datas;
-			data_size += sizeof(struct spa_chunk);
 			if (d->type == t->data.MemPtr)
 				data_size += d->maxsize;
 		}
@@ -834,6 +863,23 @@ impl_node_port_send_command(struct spa_node *node,
 	return 0;
 }
 
+/* the io of a graph port is placed in the transport, the client exchanges
+ * status and buffer ids in place */
+static inline bool port_io_shared(struct impl *impl, struct spa_graph_port *p)
+{
+	struct pw_client_node_transport *trans = impl->transport;
+
+	if (trans == NULL)
+		return false;
+
+	if (p->direction == SPA_DIRECTION_INPUT)
+		return p->port_id < impl->max_inputs &&
+			p->io == &trans->inputs[p->port_id];
+	else
+		return p->port_id < impl->max_outputs &&
+			p->io == &trans->outputs[p->port_id];
+}
+
 static int impl_node_process_input(struct spa_node *node)
 {
 	struct node *this = SPA_CONTAINER_OF(node, struct node, node);
@@ -846,25 +892,38 @@ static int impl_node_process_input(struct spa_node *node)
 	if (impl->input_ready == 0) {
 		/* the client is not ready to receive our buffers, recycle them */
 		pw_log_trace("node not ready, recycle buffers");
-		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link)
-			p->io->status = SPA_STATUS_NEED_BUFFER;
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			/* the mixer left the buffers of shared io on the links */
+			if (!port_io_shared(impl, p))
+				p->io->status = SPA_STATUS_NEED_BUFFER;
+		}
 		res = SPA_STATUS_NEED_BUFFER;
 	}
 	else {
+		bool direct = !spa_list_is_empty(&n->ports[SPA_DIRECTION_INPUT]);
+
 		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
 			struct spa_io_buffers *io = p->io;
 
-			pw_log_trace("set io status to %d %d", io->status, io->buffer_id);
-			impl->transport->inputs[p->port_id] = *io;
+			/* the peer client placed the buffer on the io already and
+			 * the client recycles it with a reuse_buffer message */
+			if (GET_IN_PORT(this, p->port_id)->peer)
+				continue;
+
+			direct = false;
+
+			pw_log_trace("io status %d %d", io->status, io->buffer_id);
 
 			/* explicitly recycle buffers when the client is not going to do it */
 			if (!client_reuse && (pp = p->peer))
 		                spa_node_port_reuse_buffer(pp->node->implementation,
 						pp->port_id, io->buffer_id);
 		}
-		pw_client_node_transport_add_message(impl->transport,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
-		do_flush(this);
+		if (!direct) {
+			pw_client_node_transport_add_message(impl->transport,
+				       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
+			do_flush(this);
+		}
 
 		impl->input_ready--;
 		res = SPA_STATUS_OK;
@@ -888,15 +947,8 @@ static int impl_node_process_output(struct spa_node *node)
 
 	impl->out_pending = true;
 
-	spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
-		struct spa_io_buffers *io = p->io;
-
-		impl->transport->outputs[p->port_id] = *io;
-
-		pw_log_trace("%d %d -> %d %d", io->status, io->buffer_id,
-				impl->transport->outputs[p->port_id].status,
-				impl->transport->outputs[p->port_id].buffer_id);
-	}
+	spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link)
+		pw_log_trace("io status %d %d", p->io->status, p->io->buffer_id);
 
       done:
 	pw_client_node_transport_add_message(impl->transport,
@@ -916,17 +968,20 @@ static int handle_node_message(struct node *this, struct pw_client_node_message
 
 	switch (PW_CLIENT_NODE_MESSAGE_TYPE(message)) {
 	case PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT:
-		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
-			*p->io = impl->transport->outputs[p->port_id];
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link)
 			pw_log_trace("have output %d %d", p->io->status, p->io->buffer_id);
-		}
 		impl->out_pending = false;
 		this->callbacks->have_output(this->callbacks_data);
 		break;
 
 	case PW_CLIENT_NODE_MESSAGE_NEED_INPUT:
 		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
-			*p->io = impl->transport->inputs[p->port_id];
+			/* the client does not see the io of ports that a peer
+			 * client triggers directly */
+			if (!port_io_shared(impl, p)) {
+				p->io->status = SPA_STATUS_NEED_BUFFER;
+				p->io->buffer_id = SPA_ID_INVALID;
+			}
 			pw_log_trace("need input %d %d", p->io->status, p->io->buffer_id);
 		}
 		impl->input_ready++;
@@ -934,13 +989,17 @@ static int handle_node_message(struct node *this, struct pw_client_node_message
 		break;
 
 	case PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER:
-		if (impl->client_reuse) {
-			struct pw_client_node_message_port_reuse_buffer *p =
-			    (struct pw_client_node_message_port_reuse_buffer *) message;
-			this->callbacks->reuse_buffer(this->callbacks_data, p->body.port_id.value,
+	{
+		struct pw_client_node_message_port_reuse_buffer *p =
+		    (struct pw_client_node_message_port_reuse_buffer *) message;
+		uint32_t port_id = p->body.port_id.value;
+
+		if (impl->client_reuse ||
+		    (port_id < MAX_INPUTS && GET_IN_PORT(this, port_id)->peer))
+			this->callbacks->reuse_buffer(this->callbacks_data, port_id,
 						     p->body.buffer_id.value);
-		}
 		break;
+	}
 
 	default:
 		pw_log_warn("unhandled message %d", PW_CLIENT_NODE_MESSAGE_TYPE(message));
@@ -949,15 +1008,68 @@ static int handle_node_message(struct node *this, struct pw_client_node_message
 	return 0;
 }
 
+static int
+do_port_set_io(struct spa_loop *loop,
+	       bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_port *port = user_data;
+	struct spa_io_buffers *io = *(struct spa_io_buffers * const *) data;
+
+	if (port->rt.port.io != io) {
+		*io = *port->rt.port.io;
+		port->rt.port.io = port->rt.mix_port.io = io;
+	}
+	return 0;
+}
+
+/* Place the io of the graph port in the transport so that the client uses it
+ * in place. Ports that a peer client triggers directly keep the io of the port,
+ * the clients use the io in the peer area of the link. */
+static void port_update_io(struct impl *impl, struct port *p)
+{
+	struct pw_port *port = p->port;
+	struct pw_client_node_transport *trans = impl->transport;
+	struct spa_io_buffers *io = &port->io;
+
+	if (trans) {
+		if (port->direction == PW_DIRECTION_INPUT) {
+			if (p->peer == NULL && port->port_id < impl->max_inputs)
+				io = &trans->inputs[port->port_id];
+		}
+		else {
+			if (port->port_id < impl->max_outputs)
+				io = &trans->outputs[port->port_id];
+		}
+	}
+	if (io == &port->io && trans)
+		pw_log_debug("client-node %p: port %d:%d io not shared", impl,
+				port->direction, port->port_id);
+
+	pw_loop_invoke(port->node->data_loop,
+		       do_port_set_io, SPA_ID_INVALID, &io, sizeof(io), true, port);
+}
+
 static void setup_transport(struct impl *impl)
 {
 	uint32_t max_inputs = 0, max_outputs = 0, n_inputs = 0, n_outputs = 0;
+	uint32_t i;
 
 	spa_node_get_n_ports(&impl->node.node, &n_inputs, &max_inputs, &n_outputs, &max_outputs);
 
 	impl->transport = pw_client_node_transport_new(max_inputs, max_outputs);
+	impl->max_inputs = max_inputs;
+	impl->max_outputs = max_outputs;
 	impl->transport->area->n_input_ports = n_inputs;
 	impl->transport->area->n_output_ports = n_outputs;
+
+	for (i = 0; i < MAX_INPUTS; i++) {
+		if (impl->node.in_ports[i].port)
+			port_update_io(impl, &impl->node.in_ports[i]);
+	}
+	for (i = 0; i < MAX_OUTPUTS; i++) {
+		if (impl->node.out_ports[i].port)
+			port_update_io(impl, &impl->node.out_ports[i]);
+	}
 }
 
 static void
@@ -1081,10 +1193,19 @@ static void node_on_data_fd_events(struct spa_source *source)
 			spa_log_warn(this->log, "node %p: error reading message: %s",
 					this, strerror(errno));
 
-		while (pw_client_node_transport_next_message(impl->transport, &message) == 1) {
-			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
-			pw_client_node_transport_parse_message(impl->transport, msg);
-			handle_node_message(this, msg);
+		do {
+			while (pw_client_node_transport_next_message(impl->transport, &message) == 1) {
+				struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
+				pw_client_node_transport_parse_message(impl->transport, msg);
+				handle_node_message(this, msg);
+			}
+		} while (pw_client_node_transport_idle(impl->transport));
+
+		if (impl->transport->input_activation->dropped != impl->dropped[0] ||
+		    impl->transport->output_activation->dropped != impl->dropped[1]) {
+			impl->dropped[0] = impl->transport->input_activation->dropped;
+			impl->dropped[1] = impl->transport->output_activation->dropped;
+			pw_loop_signal_event(impl->core->main_loop, impl->dropped_event);
 		}
 	}
 }
@@ -1227,6 +1348,43 @@ static void node_initialized(void *data)
 					  impl->transport);
 }
 
+/* expose the number of messages that did not fit in the transport in the
+ * node properties */
+static void on_dropped(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	struct pw_client_node_transport *trans = impl->transport;
+	struct spa_dict_item items[2];
+	char dropped_in[16], dropped_out[16];
+
+	if (trans == NULL)
+		return;
+
+	snprintf(dropped_in, sizeof(dropped_in), "%u", trans->input_activation->dropped);
+	snprintf(dropped_out, sizeof(dropped_out), "%u", trans->output_activation->dropped);
+
+	pw_log_warn("client-node %p: dropped messages from client %s, to client %s",
+			impl, dropped_in, dropped_out);
+
+	items[0] = SPA_DICT_ITEM_INIT("pipewire.transport.dropped-in", dropped_in);
+	items[1] = SPA_DICT_ITEM_INIT("pipewire.transport.dropped-out", dropped_out);
+	pw_node_update_properties(impl->this.node, &SPA_DICT_INIT(items, 2));
+}
+
+static void free_old_peer_mems(struct impl *impl)
+{
+	struct pw_memblock **mem;
+
+	pw_array_for_each(mem, &impl->old_peer_mems)
+		pw_memblock_free(*mem);
+	impl->old_peer_mems.size = 0;
+}
+
+static void on_peer_mem(void *data, uint64_t count)
+{
+	free_old_peer_mems(data);
+}
+
 static void node_free(void *data)
 {
 	struct impl *impl = data;
@@ -1234,6 +1392,12 @@ static void node_free(void *data)
 	pw_log_debug("client-node %p: free", &impl->this);
 	node_clear(&impl->node);
 
+	pw_loop_destroy_source(impl->core->main_loop, impl->dropped_event);
+	pw_loop_destroy_source(impl->core->main_loop, impl->peer_mem_event);
+	pw_loop_destroy_source(impl->core->main_loop, impl->peer_timer);
+	free_old_peer_mems(impl);
+	pw_array_clear(&impl->old_peer_mems);
+
 	if (impl->transport)
 		pw_client_node_transport_destroy(impl->transport);
 
@@ -1248,10 +1412,341 @@ static void node_free(void *data)
 	free(impl);
 }
 
+static struct impl *port_get_impl(struct pw_port *port)
+{
+	struct spa_node *node;
+	struct node *this;
+
+	if (port == NULL || port->node == NULL)
+		return NULL;
+
+	node = port->node->node;
+	if (node == NULL || node->process_input != impl_node_process_input)
+		return NULL;
+
+	this = SPA_CONTAINER_OF(node, struct node, node);
+	return this->impl;
+}
+
+static struct port *impl_get_port(struct impl *impl, struct pw_port *port)
+{
+	struct node *this = &impl->node;
+
+	if (port->direction == PW_DIRECTION_INPUT)
+		return GET_IN_PORT(this, port->port_id);
+	else
+		return GET_OUT_PORT(this, port->port_id);
+}
+
+static inline bool port_has_one_link(struct pw_port *port)
+{
+	return !spa_list_is_empty(&port->links) && port->links.next == port->links.prev;
+}
+
+struct peer_info {
+	struct port *port;
+	struct impl *peer;
+	uint32_t peer_port_id;
+};
+
+static int
+do_set_port_peer(struct spa_loop *loop,
+		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	const struct peer_info *info = data;
+	info->port->peer = info->peer;
+	info->port->peer_port_id = info->peer_port_id;
+	return 0;
+}
+
+/* the data loop checks the peer of the ports, change it from there */
+static void set_port_peer(struct impl *impl, struct port *port,
+			  struct impl *peer, uint32_t peer_port_id)
+{
+	struct peer_info info = { port, peer, peer_port_id };
+
+	spa_loop_invoke(impl->node.data_loop,
+			do_set_port_peer, SPA_ID_INVALID, &info, sizeof(info), true, NULL);
+}
+
+static struct pw_memblock *peer_mem_new(void)
+{
+	struct pw_memblock *mem;
+	struct pw_client_node_peer_area *area;
+
+	if (pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+			      PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			      PW_MEMBLOCK_FLAG_SEAL,
+			      sizeof(struct pw_client_node_peer_area), &mem) < 0)
+		return NULL;
+
+	area = mem->ptr;
+	spa_zero(area->activation);
+	area->io.status = SPA_STATUS_NEED_BUFFER;
+	area->io.buffer_id = SPA_ID_INVALID;
+	area->taken = 0;
+
+	return mem;
+}
+
+/* only check the direct links while there are some */
+static void update_peer_timer(struct impl *impl)
+{
+	struct timespec interval = { 0, 0 };
+	uint32_t i;
+
+	for (i = 0; i < MAX_OUTPUTS; i++) {
+		if (impl->node.out_ports[i].peer_mem) {
+			interval.tv_nsec = PEER_CHECK_MSEC * SPA_NSEC_PER_MSEC;
+			break;
+		}
+	}
+	pw_loop_update_timer(impl->core->main_loop, impl->peer_timer, NULL, &interval, false);
+}
+
+/* The clients of a direct link only share the activation and the io of the
+ * input port, in a memfd of their own. */
+static void port_set_peer(struct impl *impl, uint32_t port_id,
+			  struct impl *peer, uint32_t peer_port_id)
+{
+	struct port *port = &impl->node.out_ports[port_id];
+	struct pw_memblock *mem = NULL;
+	struct port *p;
+
+	if (port->peer == peer && port->peer_port_id == peer_port_id)
+		return;
+
+	if (peer && (mem = peer_mem_new()) == NULL) {
+		pw_log_error("client-node %p: can't allocate peer area", impl);
+		peer = NULL;
+		peer_port_id = SPA_ID_INVALID;
+		if (port->peer == NULL)
+			return;
+	}
+
+	if (port->peer) {
+		p = &port->peer->node.in_ports[port->peer_port_id];
+		set_port_peer(port->peer, p, NULL, SPA_ID_INVALID);
+		if (p->port)
+			port_update_io(port->peer, p);
+		if (port->peer->this.resource)
+			pw_client_node_resource_port_set_peer(port->peer->this.resource,
+							      SPA_DIRECTION_INPUT,
+							      port->peer_port_id,
+							      SPA_ID_INVALID, -1, -1, 0, 0);
+	}
+	set_port_peer(impl, port, peer, peer_port_id);
+
+	if (peer) {
+		p = &peer->node.in_ports[peer_port_id];
+		if (p->peer)
+			port_set_peer(p->peer, p->peer_port_id, NULL, SPA_ID_INVALID);
+		set_port_peer(peer, p, impl, port_id);
+		port_update_io(peer, p);
+		pw_client_node_resource_port_set_peer(peer->this.resource,
+						      SPA_DIRECTION_INPUT, peer_port_id,
+						      port_id, -1, mem->fd, 0, mem->size);
+	}
+
+	pw_log_debug("client-node %p: output port %u peer %p:%u", impl, port_id,
+			peer, peer_port_id);
+
+	if (impl->this.resource) {
+		if (peer)
+			pw_client_node_resource_port_set_peer(impl->this.resource,
+							      SPA_DIRECTION_OUTPUT, port_id,
+							      peer_port_id, peer->fds[1],
+							      mem->fd, 0, mem->size);
+		else
+			pw_client_node_resource_port_set_peer(impl->this.resource,
+							      SPA_DIRECTION_OUTPUT, port_id,
+							      SPA_ID_INVALID, -1, -1, 0, 0);
+	}
+
+	/* the fd of the old area can still be queued in an event to the clients */
+	if (port->peer_mem) {
+		pw_array_add_ptr(&impl->old_peer_mems, port->peer_mem);
+		pw_loop_signal_event(impl->core->main_loop, impl->peer_mem_event);
+	}
+	port->peer_mem = mem;
+	port->peer_taken = 0;
+	port->peer_stalled = 0;
+
+	update_peer_timer(impl);
+}
+
+/* A peer that was triggered but does not take the triggers anymore while
+ * it is running is stuck, our client would drop all its buffers. Go back to
+ * scheduling the link in the server, until the link changes. */
+static void on_peer_timeout(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	struct pw_client_node_peer_area *area;
+	struct port *port;
+	uint32_t i, taken;
+	int32_t trigger;
+
+	for (i = 0; i < MAX_OUTPUTS; i++) {
+		port = &impl->node.out_ports[i];
+		if (port->peer == NULL || port->peer_mem == NULL)
+			continue;
+
+		area = port->peer_mem->ptr;
+		trigger = __atomic_load_n(&area->activation.trigger, __ATOMIC_SEQ_CST);
+		taken = __atomic_load_n(&area->taken, __ATOMIC_SEQ_CST);
+
+		if (trigger == 0 || taken != port->peer_taken ||
+		    port->peer->this.node->info.state != PW_NODE_STATE_RUNNING) {
+			port->peer_taken = taken;
+			port->peer_stalled = 0;
+			continue;
+		}
+		if (++port->peer_stalled < PEER_CHECK_STALLED)
+			continue;
+
+		pw_log_warn("client-node %p: peer %p of output port %u is stalled, "
+				"stop the direct link", impl, port->peer, i);
+		port_set_peer(impl, i, NULL, SPA_ID_INVALID);
+	}
+}
+
+/* An output port of a client triggers the input port of another client
+ * directly when it is the only link on both ports. The buffer ids are then
+ * the same on both sides and the server only has to follow along. */
+static void update_peer(struct impl *impl, struct pw_port *port)
+{
+	struct impl *peer = NULL;
+	struct pw_port *input = NULL;
+	struct pw_link *link;
+
+	if (impl->client_direct && impl->this.resource && port_has_one_link(port)) {
+		link = spa_list_first(&port->links, struct pw_link, output_link);
+		input = link->input;
+		peer = port_get_impl(input);
+	}
+	if (peer && (!peer->client_direct || peer->this.resource == NULL ||
+		     peer->transport == NULL || peer->fds[1] == -1 ||
+		     !port_has_one_link(input)))
+		peer = NULL;
+
+	port_set_peer(impl, port->port_id, peer, peer ? input->port_id : SPA_ID_INVALID);
+}
+
+static void port_link_changed(struct pw_port *port, struct pw_link *link)
+{
+	struct impl *impl = port_get_impl(port), *other;
+	struct port *p = impl_get_port(impl, port);
+
+	if (port->direction == PW_DIRECTION_OUTPUT) {
+		update_peer(impl, port);
+		return;
+	}
+	if (p->peer)
+		update_peer(p->peer, p->peer->node.out_ports[p->peer_port_id].port);
+	if (link->output && (other = port_get_impl(link->output)))
+		update_peer(other, link->output);
+}
+
+static void port_link_added(void *data, struct pw_link *link)
+{
+	port_link_changed(data, link);
+}
+
+static void port_link_removed(void *data, struct pw_link *link)
+{
+	port_link_changed(data, link);
+}
+
+static void port_destroy(void *data)
+{
+	struct pw_port *port = data;
+	struct impl *impl = port_get_impl(port);
+	struct port *p = impl_get_port(impl, port);
+
+	if (p->peer) {
+		if (port->direction == PW_DIRECTION_OUTPUT)
+			port_set_peer(impl, port->port_id, NULL, SPA_ID_INVALID);
+		else
+			port_set_peer(p->peer, p->peer_port_id, NULL, SPA_ID_INVALID);
+	}
+	spa_hook_remove(&p->port_listener);
+	p->port = NULL;
+}
+
+static const struct pw_port_events port_events = {
+	PW_VERSION_PORT_EVENTS,
+	.destroy = port_destroy,
+	.link_added = port_link_added,
+	.link_removed = port_link_removed,
+};
+
+/* The mixer and tee of the port only touch the shared io when the client is
+ * not using it, the buffers stay on the links until the client is ready. */
+static int client_mix_input(struct spa_node *data)
+{
+	struct pw_port *port = SPA_CONTAINER_OF(data, struct pw_port, mix_node);
+	struct impl *impl = port_get_impl(port);
+	struct port *p = impl_get_port(impl, port);
+	struct spa_graph_port *pp;
+
+	if (impl->input_ready > 0 || !port_io_shared(impl, &port->rt.port))
+		return p->mix.process_input(data);
+
+	spa_list_for_each(pp, &port->rt.mix_node.ports[SPA_DIRECTION_INPUT], link)
+		pp->io->status = SPA_STATUS_NEED_BUFFER;
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static int client_mix_output(struct spa_node *data)
+{
+	struct pw_port *port = SPA_CONTAINER_OF(data, struct pw_port, mix_node);
+	struct impl *impl = port_get_impl(port);
+	struct port *p = impl_get_port(impl, port);
+
+	if (impl->input_ready > 0 || !port_io_shared(impl, &port->rt.port))
+		return p->mix.process_output(data);
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static int client_tee_output(struct spa_node *data)
+{
+	struct pw_port *port = SPA_CONTAINER_OF(data, struct pw_port, mix_node);
+	struct impl *impl = port_get_impl(port);
+	struct port *p = impl_get_port(impl, port);
+
+	if (!impl->out_pending || !port_io_shared(impl, &port->rt.port))
+		return p->mix.process_output(data);
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static void node_port_added(void *data, struct pw_port *port)
+{
+	struct impl *impl = data;
+	struct port *p = impl_get_port(impl, port);
+
+	p->port = port;
+	pw_port_add_listener(port, &p->port_listener, &port_events, port);
+
+	p->mix = port->mix_node;
+	if (port->direction == PW_DIRECTION_INPUT) {
+		port->mix_node.process_input = client_mix_input;
+		port->mix_node.process_output = client_mix_output;
+	}
+	else
+		port->mix_node.process_output = client_tee_output;
+
+	if (impl->transport)
+		port_update_io(impl, p);
+}
+
 static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
 	.free = node_free,
 	.initialized = node_initialized,
+	.port_added = node_port_added,
 };
 
 static const struct pw_resource_events resource_events = {
@@ -1300,6 +1795,11 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 
 	pw_array_init(&impl->mems, 64);
 
+	impl->dropped_event = pw_loop_add_event(core->main_loop, on_dropped, impl);
+	pw_array_init(&impl->old_peer_mems, 4 * sizeof(struct pw_memblock *));
+	impl->peer_mem_event = pw_loop_add_event(core->main_loop, on_peer_mem, impl);
+	impl->peer_timer = pw_loop_add_timer(core->main_loop, on_peer_timeout, impl);
+
 	if ((name = pw_properties_get(properties, "node.name")) == NULL)
 		name = "client-node";
 
@@ -1317,6 +1817,8 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 
 	str = pw_properties_get(properties, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
+	str = pw_properties_get(properties, "pipewire.client.direct");
+	impl->client_direct = str && pw_properties_parse_bool(str);
 
 	pw_resource_add_listener(this->resource,
 				 &impl->resource_listener,
@@ -1333,6 +1835,10 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 	return this;
 
       error_no_node:
+	pw_loop_destroy_source(core->main_loop, impl->dropped_event);
+	pw_loop_destroy_source(core->main_loop, impl->peer_mem_event);
+	pw_loop_destroy_source(core->main_loop, impl->peer_timer);
+	pw_array_clear(&impl->old_peer_mems);
 	pw_resource_destroy(this->resource);
 	node_clear(&impl->node);
 	free(impl);
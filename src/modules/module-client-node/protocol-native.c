@@ -439,6 +439,36 @@ static int client_node_demarshal_port_set_io(void *object, void *data, size_t si
 	return 0;
 }
 
+static int client_node_demarshal_port_set_peer(void *object, void *data, size_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t direction, port_id, peer_port_id, widx, memfd_idx, offset, sz;
+	int writefd, memfd;
+
+	spa_pod_parser_init(&prs, data, size, 0);
+	if (spa_pod_parser_get(&prs,
+			"["
+			"i", &direction,
+			"i", &port_id,
+			"i", &peer_port_id,
+			"i", &widx,
+			"i", &memfd_idx,
+			"i", &offset,
+			"i", &sz, NULL) < 0)
+		return -EINVAL;
+
+	writefd = pw_protocol_native_get_proxy_fd(proxy, widx);
+	memfd = pw_protocol_native_get_proxy_fd(proxy, memfd_idx);
+
+	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, port_set_peer, 0,
+							direction, port_id,
+							peer_port_id,
+							writefd, memfd,
+							offset, sz);
+	return 0;
+}
+
 static void
 client_node_marshal_add_mem(void *object,
 			    uint32_t mem_id,
@@ -681,6 +711,35 @@ client_node_marshal_port_set_io(void *object,
 	pw_protocol_native_end_resource(resource, b);
 }
 
+static void
+client_node_marshal_port_set_peer(void *object,
+				  enum spa_direction direction,
+				  uint32_t port_id,
+				  uint32_t peer_port_id,
+				  int writefd,
+				  int memfd,
+				  uint32_t offset,
+				  uint32_t size)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_PORT_SET_PEER);
+
+	spa_pod_builder_struct(b,
+			       "i", direction,
+			       "i", port_id,
+			       "i", peer_port_id,
+			       "i", writefd == -1 ? -1 :
+					pw_protocol_native_add_resource_fd(resource, writefd),
+			       "i", memfd == -1 ? -1 :
+					pw_protocol_native_add_resource_fd(resource, memfd),
+			       "i", offset,
+			       "i", size);
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
 
 static int client_node_demarshal_done(void *object, void *data, size_t size)
 {
@@ -867,6 +926,7 @@ static const struct pw_client_node_proxy_events pw_protocol_native_client_node_e
 	&client_node_marshal_port_use_buffers,
 	&client_node_marshal_port_command,
 	&client_node_marshal_port_set_io,
+	&client_node_marshal_port_set_peer,
 };
 
 static const struct pw_protocol_native_demarshal pw_protocol_native_client_node_event_demarshal[] = {
@@ -881,6 +941,7 @@ static const struct pw_protocol_native_demarshal pw_protocol_native_client_node_
 	{ &client_node_demarshal_port_use_buffers, PW_PROTOCOL_NATIVE_REMAP },
 	{ &client_node_demarshal_port_command, PW_PROTOCOL_NATIVE_REMAP },
 	{ &client_node_demarshal_port_set_io, PW_PROTOCOL_NATIVE_REMAP },
+	{ &client_node_demarshal_port_set_peer, 0 },
 };
 
 static const struct pw_protocol_marshal pw_protocol_native_client_node_marshal = {
@@ -30,38 +30,56 @@
 
 /** \cond */
 
-#define INPUT_BUFFER_SIZE       (1<<12)
-#define OUTPUT_BUFFER_SIZE      (1<<12)
+#define MIN_BUFFER_SIZE		(1<<12)
+#define MAX_BUFFER_SIZE		(1<<20)
+/* room in the ringbuffers for this many reuse_buffer messages per port */
+#define MESSAGES_PER_PORT	16
 
 struct transport {
 	struct pw_client_node_transport trans;
 
 	struct pw_memblock *mem;
 	size_t offset;
+	uint32_t buffer_size;
 
 	struct pw_client_node_message current;
 	uint32_t current_index;
 };
 /** \endcond */
 
-static size_t area_get_size(struct pw_client_node_area *area)
+static uint32_t get_buffer_size(uint32_t n_ports)
+{
+	uint32_t size = MIN_BUFFER_SIZE, needed;
+
+	needed = (n_ports + 1) * MESSAGES_PER_PORT *
+		sizeof(struct pw_client_node_message_port_reuse_buffer);
+
+	while (size < needed && size < MAX_BUFFER_SIZE)
+		size <<= 1;
+
+	return size;
+}
+
+static size_t area_get_size(const struct pw_client_node_area *area)
 {
 	size_t size;
 	size = sizeof(struct pw_client_node_area);
-	size += area->max_input_ports * sizeof(struct spa_io_buffers);
-	size += area->max_output_ports * sizeof(struct spa_io_buffers);
+	size += (size_t) area->max_input_ports * sizeof(struct spa_io_buffers);
+	size += (size_t) area->max_output_ports * sizeof(struct spa_io_buffers);
 	size += sizeof(struct spa_ringbuffer);
-	size += INPUT_BUFFER_SIZE;
+	size += area->buffer_size;
 	size += sizeof(struct spa_ringbuffer);
-	size += OUTPUT_BUFFER_SIZE;
+	size += area->buffer_size;
+	size += 2 * sizeof(struct pw_client_node_activation);
 	return size;
 }
 
-static void transport_setup_area(void *p, struct pw_client_node_transport *trans)
+/* lay out the transport with the sizes in \a a, a private copy of the area.
+ * The sizes in the shared memory can be changed by the other side. */
+static void transport_setup_area(void *p, const struct pw_client_node_area *a,
+				 struct pw_client_node_transport *trans)
 {
-	struct pw_client_node_area *a;
-
-	trans->area = a = p;
+	trans->area = p;
 	p = SPA_MEMBER(p, sizeof(struct pw_client_node_area), struct spa_io_buffers);
 
 	trans->inputs = p;
@@ -74,19 +92,25 @@ static void transport_setup_area(void *p, struct pw_client_node_transport *trans
 	p = SPA_MEMBER(p, sizeof(struct spa_ringbuffer), void);
 
 	trans->input_data = p;
-	p = SPA_MEMBER(p, INPUT_BUFFER_SIZE, void);
+	p = SPA_MEMBER(p, a->buffer_size, void);
 
 	trans->output_buffer = p;
 	p = SPA_MEMBER(p, sizeof(struct spa_ringbuffer), void);
 
 	trans->output_data = p;
-	p = SPA_MEMBER(p, OUTPUT_BUFFER_SIZE, void);
+	p = SPA_MEMBER(p, a->buffer_size, void);
+
+	trans->input_activation = p;
+	p = SPA_MEMBER(p, sizeof(struct pw_client_node_activation), void);
+
+	trans->output_activation = p;
+	p = SPA_MEMBER(p, sizeof(struct pw_client_node_activation), void);
 }
 
-static void transport_reset_area(struct pw_client_node_transport *trans)
+static void transport_reset_area(const struct pw_client_node_area *a,
+				 struct pw_client_node_transport *trans)
 {
 	int i;
-	struct pw_client_node_area *a = trans->area;
 
 	for (i = 0; i < a->max_input_ports; i++) {
 		trans->inputs[i].status = SPA_STATUS_OK;
@@ -98,6 +122,8 @@ static void transport_reset_area(struct pw_client_node_transport *trans)
 	}
 	spa_ringbuffer_init(trans->input_buffer);
 	spa_ringbuffer_init(trans->output_buffer);
+	spa_zero(*trans->input_activation);
+	spa_zero(*trans->output_activation);
 }
 
 static void destroy(struct pw_client_node_transport *trans)
@@ -120,14 +146,17 @@ static int add_message(struct pw_client_node_transport *trans, struct pw_client_
 		return -EINVAL;
 
 	filled = spa_ringbuffer_get_write_index(trans->output_buffer, &index);
-	avail = OUTPUT_BUFFER_SIZE - filled;
+	avail = impl->buffer_size - filled;
 	size = SPA_POD_SIZE(message);
-	if (avail < size)
+	if (avail < size) {
+		if (__atomic_add_fetch(&trans->output_activation->dropped, 1, __ATOMIC_SEQ_CST) == 1)
+			pw_log_warn("transport %p: ringbuffer full, dropping messages", trans);
 		return -ENOSPC;
+	}
 
 	spa_ringbuffer_write_data(trans->output_buffer,
-				  trans->output_data, OUTPUT_BUFFER_SIZE,
-				  index & (OUTPUT_BUFFER_SIZE - 1), message, size);
+				  trans->output_data, impl->buffer_size,
+				  index & (impl->buffer_size - 1), message, size);
 	spa_ringbuffer_write_update(trans->output_buffer, index + size);
 
 	return 0;
@@ -146,8 +175,8 @@ static int next_message(struct pw_client_node_transport *trans, struct pw_client
 		return 0;
 
 	spa_ringbuffer_read_data(trans->input_buffer,
-				 trans->input_data, INPUT_BUFFER_SIZE,
-				 impl->current_index & (INPUT_BUFFER_SIZE - 1),
+				 trans->input_data, impl->buffer_size,
+				 impl->current_index & (impl->buffer_size - 1),
 				 &impl->current, sizeof(struct pw_client_node_message));
 
 	if (avail < SPA_POD_SIZE(&impl->current))
@@ -169,8 +198,8 @@ static int parse_message(struct pw_client_node_transport *trans, void *message)
 	size = SPA_POD_SIZE(&impl->current);
 
 	spa_ringbuffer_read_data(trans->input_buffer,
-				 trans->input_data, INPUT_BUFFER_SIZE,
-				 impl->current_index & (INPUT_BUFFER_SIZE - 1), message, size);
+				 trans->input_data, impl->buffer_size,
+				 impl->current_index & (impl->buffer_size - 1), message, size);
 	spa_ringbuffer_read_update(trans->input_buffer, impl->current_index + size);
 
 	return 0;
@@ -180,6 +209,9 @@ static int parse_message(struct pw_client_node_transport *trans, void *message)
  * \param max_input_ports maximum number of input_ports
  * \param max_output_ports maximum number of output_ports
  * \return a newly allocated \ref pw_client_node_transport
+ *
+ * The size of the ringbuffers is chosen so that a burst of reuse_buffer
+ * messages for all ports fits without waiting for the other side.
  * \memberof pw_client_node_transport
  */
 struct pw_client_node_transport *
@@ -193,15 +225,18 @@ pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports
 	area.n_input_ports = 0;
 	area.max_output_ports = max_output_ports;
 	area.n_output_ports = 0;
+	area.buffer_size = get_buffer_size(max_input_ports + max_output_ports);
 
 	impl = calloc(1, sizeof(struct transport));
 	if (impl == NULL)
 		return NULL;
 
-	pw_log_debug("transport %p: new %d %d", impl, max_input_ports, max_output_ports);
+	pw_log_debug("transport %p: new %d %d, buffer size %d", impl,
+			max_input_ports, max_output_ports, area.buffer_size);
 
 	trans = &impl->trans;
 	impl->offset = 0;
+	impl->buffer_size = area.buffer_size;
 
 	if (pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
 			  PW_MEMBLOCK_FLAG_MAP_READWRITE |
@@ -211,8 +246,8 @@ pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports
 		return NULL;
 
 	memcpy(impl->mem->ptr, &area, sizeof(struct pw_client_node_area));
-	transport_setup_area(impl->mem->ptr, trans);
-	transport_reset_area(trans);
+	transport_setup_area(impl->mem->ptr, &area, trans);
+	transport_reset_area(&area, trans);
 
 	trans->destroy = destroy;
 	trans->add_message = add_message;
@@ -227,6 +262,7 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 {
 	struct transport *impl;
 	struct pw_client_node_transport *trans;
+	struct pw_client_node_area area;
 	void *tmp;
 	int res;
 
@@ -249,7 +285,25 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 
 	impl->offset = info->offset;
 
-	transport_setup_area(impl->mem->ptr, trans);
+	if (info->size < sizeof(struct pw_client_node_area)) {
+		pw_log_warn("transport %p: invalid area", impl);
+		res = -EINVAL;
+		goto invalid_area;
+	}
+
+	/* the sizes are read from the area once, the area is only set up with
+	 * the validated copy */
+	memcpy(&area, impl->mem->ptr, sizeof(struct pw_client_node_area));
+	impl->buffer_size = area.buffer_size;
+	if (area.buffer_size < MIN_BUFFER_SIZE || area.buffer_size > MAX_BUFFER_SIZE ||
+	    (area.buffer_size & (area.buffer_size - 1)) ||
+	    area_get_size(&area) > info->size) {
+		pw_log_warn("transport %p: invalid area", impl);
+		res = -EINVAL;
+		goto invalid_area;
+	}
+
+	transport_setup_area(impl->mem->ptr, &area, trans);
 
 	tmp = trans->output_buffer;
 	trans->output_buffer = trans->input_buffer;
@@ -259,6 +313,10 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 	trans->output_data = trans->input_data;
 	trans->input_data = tmp;
 
+	tmp = trans->output_activation;
+	trans->output_activation = trans->input_activation;
+	trans->input_activation = tmp;
+
 	trans->destroy = destroy;
 	trans->add_message = add_message;
 	trans->next_message = next_message;
@@ -266,6 +324,8 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 
 	return trans;
 
+      invalid_area:
+	pw_memblock_free(impl->mem);
       mmap_failed:
 	free(impl);
 	errno = -res;
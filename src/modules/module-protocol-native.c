@@ -79,6 +79,7 @@ struct client {
 
         bool disconnecting;
 	bool flush_signaled;
+	bool flushing;
         struct spa_source *flush_event;
 };
 
@@ -100,6 +101,7 @@ struct client_data {
 	struct spa_source *source;
 	struct pw_protocol_native_connection *connection;
 	bool busy;
+	bool flushing;
 };
 
 static bool pod_remap_data(uint32_t type, void *body, uint32_t size, struct pw_map *types)
@@ -221,7 +223,8 @@ process_messages(struct client_data *data)
 			continue;
 		}
 
-		if (demarshal[opcode].flags & PW_PROTOCOL_NATIVE_REMAP)
+		if ((demarshal[opcode].flags & PW_PROTOCOL_NATIVE_REMAP) &&
+		    !client->types_identity)
 			if (!pod_remap_data(SPA_POD_TYPE_STRUCT, message, size, &client->types))
 				goto invalid_message;
 
@@ -248,20 +251,52 @@ process_messages(struct client_data *data)
 	goto done;
 }
 
+static void update_mask(struct client_data *c)
+{
+	struct pw_client *client = c->client;
+	enum spa_io mask = SPA_IO_ERR | SPA_IO_HUP;
+
+	if (!c->busy)
+		mask |= SPA_IO_IN;
+	if (c->flushing)
+		mask |= SPA_IO_OUT;
+
+	pw_loop_update_io(client->core->main_loop, c->source, mask);
+}
+
+static void flush_client(struct client_data *c)
+{
+	int res;
+	bool flushing;
+
+	res = pw_protocol_native_connection_flush(c->connection);
+	flushing = res == -EAGAIN;
+
+	/* wake up when the socket can take the rest of the messages */
+	if (flushing != c->flushing) {
+		c->flushing = flushing;
+		update_mask(c);
+	}
+}
+
+void pw_protocol_native_client_set_flags(struct pw_client *client, uint32_t flags)
+{
+	struct client_data *c = client->user_data;
+
+	pw_protocol_native_connection_set_bulk(c->connection,
+			SPA_FLAG_CHECK(flags, PW_PROTOCOL_NATIVE_FLAG_BULK), false);
+}
+
 static void
 client_busy_changed(void *data, bool busy)
 {
 	struct client_data *c = data;
 	struct pw_client *client = c->client;
-	enum spa_io mask = SPA_IO_ERR | SPA_IO_HUP;
 
 	c->busy = busy;
 
-	if (!busy)
-		mask |= SPA_IO_IN;
-
 	pw_log_debug("protocol-native %p: busy changed %d", client->protocol, busy);
-	pw_loop_update_io(client->core->main_loop, c->source, mask);
+	update_mask(c);
 
 	if (!busy)
 		process_messages(c);
@@ -280,6 +315,9 @@ connection_data(void *data, int fd, enum spa_io mask)
 		return;
 	}
 
+	if (mask & SPA_IO_OUT)
+		flush_client(this);
+
 	if (mask & SPA_IO_IN)
 		process_messages(this);
 }
@@ -500,6 +538,31 @@ static int impl_steal_fd(struct pw_protocol_client *client)
 	return fd;
 }
 
+static void flush_remote(struct client *impl)
+{
+	struct pw_remote *remote = impl->this.remote;
+	enum spa_io mask = SPA_IO_IN | SPA_IO_HUP | SPA_IO_ERR;
+	bool flushing;
+	int res;
+
+	if (impl->connection == NULL)
+		return;
+
+	res = pw_protocol_native_connection_flush(impl->connection);
+	if (res < 0 && res != -EAGAIN) {
+		impl->this.disconnect(&impl->this);
+		return;
+	}
+
+	flushing = res == -EAGAIN;
+	if (flushing != impl->flushing && impl->source) {
+		impl->flushing = flushing;
+		if (flushing)
+			mask |= SPA_IO_OUT;
+		pw_loop_update_io(remote->core->main_loop, impl->source, mask);
+	}
+}
+
 static void
 on_remote_data(void *data, int fd, enum spa_io mask)
 {
@@ -516,6 +579,9 @@ on_remote_data(void *data, int fd, enum spa_io mask)
 		return;
         }
 
+	if (mask & SPA_IO_OUT)
+		flush_remote(impl);
+
         if (mask & SPA_IO_IN) {
                 uint8_t opcode;
                 uint32_t id;
@@ -551,7 +617,8 @@ on_remote_data(void *data, int fd, enum spa_io mask)
 				continue;
 			}
 
-			if (demarshal[opcode].flags & PW_PROTOCOL_NATIVE_REMAP) {
+			if ((demarshal[opcode].flags & PW_PROTOCOL_NATIVE_REMAP) &&
+			    !this->types_identity) {
 				if (!pod_remap_data(SPA_POD_TYPE_STRUCT, message, size, &this->types)) {
                                         pw_log_error
                                             ("protocol-native %p: invalid message received %u for %u", this,
@@ -577,9 +644,7 @@ static void do_flush_event(void *data, uint64_t count)
 {
         struct client *impl = data;
 	impl->flush_signaled = false;
-        if (impl->connection)
-                if (!pw_protocol_native_connection_flush(impl->connection))
-                        impl->this.disconnect(&impl->this);
+	flush_remote(impl);
 }
 
 static void on_need_flush(void *data)
@@ -604,11 +669,15 @@ static int impl_connect_fd(struct pw_protocol_client *client, int fd)
 	struct pw_remote *remote = client->remote;
 
 	impl->disconnecting = false;
+	impl->flushing = false;
 
 	impl->connection = pw_protocol_native_connection_new(remote->core, fd);
 	if (impl->connection == NULL)
                 goto error_close;
 
+	/* we tell the daemon in the hello message */
+	pw_protocol_native_connection_set_bulk(impl->connection, false, true);
+
 	pw_protocol_native_connection_add_listener(impl->connection,
 						   &impl->conn_listener,
 						   &conn_events,
@@ -730,7 +799,7 @@ static void on_before_hook(void *_data)
 
 	spa_list_for_each_safe(client, tmp, &this->client_list, protocol_link) {
 		data = client->user_data;
-		pw_protocol_native_connection_flush(data->connection);
+		flush_client(data);
 	}
 }
 
@@ -24,8 +24,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <spa/debug/pod.h>
+#include <spa/utils/ringbuffer.h>
 
 #include <pipewire/pipewire.h>
 #include <pipewire/private.h>
@@ -33,8 +36,21 @@
 #include "connection.h"
 
 #define MAX_BUFFER_SIZE (1024 * 32)
+#define IN_BUFFER_SIZE (1024 * 128)
+#define CHUNK_SIZE (1024 * 32)
+#define MAX_FREE_CHUNKS 4
+#define MAX_IOV 64
 #define MAX_FDS 28
 
+/* payloads from this size go through the bulk area when the peer supports it */
+#define BULK_THRESHOLD (1024 * 32)
+/* the bulk area is a ringbuffer in a memfd shared with the peer */
+#define BULK_HEADER_SIZE 64
+#define BULK_AREA_SIZE (1024 * 1024)
+/* size values of the messages handled by the connection itself */
+#define BULK_PAYLOAD 0xffffff	/* body is the ring index and size of the payload */
+#define BULK_AREA 0xfffffe	/* body is the fd index and size of the bulk area */
+
 static bool debug_messages = 0;
 
 struct buffer {
@@ -51,10 +67,37 @@ struct buffer {
 	bool update;
 };
 
+/* a piece of the output queue. Messages are built in place in the last
+ * chunk and never span chunks. */
+struct chunk {
+	struct spa_list link;
+	size_t offset;		/**< bytes already sent */
+	size_t size;		/**< bytes queued */
+	size_t maxsize;		/**< allocated bytes */
+	uint8_t data[0];
+};
+
+struct queue {
+	struct spa_list chunks;	/**< chunks with queued messages */
+	struct spa_list free;	/**< unused chunks of CHUNK_SIZE */
+	uint32_t n_free;
+	int fds[MAX_FDS];
+	uint32_t n_fds;
+};
+
 struct impl {
 	struct pw_protocol_native_connection this;
 
-	struct buffer in, out;
+	struct buffer in;
+	struct queue out;
+
+	bool bulk;			/**< the peer can receive payloads in the bulk area */
+	bool bulk_recv;			/**< we accept a bulk area from the peer */
+	struct pw_memblock *bulk_out;	/**< our bulk area */
+	void *bulk_in;			/**< mapped bulk area of the peer */
+	uint32_t bulk_in_size;
+	uint32_t bulk_release;		/**< read index to release on the next message */
+	bool bulk_pending;
 
 	uint32_t dest_id;
 	uint8_t opcode;
@@ -113,20 +156,182 @@ uint32_t pw_protocol_native_connection_add_fd(struct pw_protocol_native_connecti
 	return index;
 }
 
-static void *connection_ensure_size(struct pw_protocol_native_connection *conn, struct buffer *buf, size_t size)
+/* make room for size bytes starting at the read offset. Only the unread
+ * tail is moved to the start of the buffer, and only when the message
+ * would not fit otherwise. */
+static bool buffer_ensure(struct pw_protocol_native_connection *conn, struct buffer *buf, size_t size)
 {
-	if (buf->buffer_size + size > buf->buffer_maxsize) {
-		buf->buffer_maxsize = SPA_ROUND_UP_N(buf->buffer_size + size, MAX_BUFFER_SIZE);
-		buf->buffer_data = realloc(buf->buffer_data, buf->buffer_maxsize);
-		if (buf->buffer_data == NULL) {
-			buf->buffer_maxsize = 0;
+	size_t avail;
+	void *data;
+
+	if (buf->offset + size <= buf->buffer_maxsize)
+		return true;
+
+	avail = buf->buffer_size - buf->offset;
+	if (buf->offset > 0) {
+		memmove(buf->buffer_data, buf->buffer_data + buf->offset, avail);
+		buf->buffer_size = avail;
+		buf->offset = 0;
+	}
+	if (size > buf->buffer_maxsize) {
+		size = SPA_ROUND_UP_N(size, MAX_BUFFER_SIZE);
+		data = realloc(buf->buffer_data, size);
+		if (data == NULL) {
 			spa_hook_list_call(&conn->listener_list, struct pw_protocol_native_connection_events, error, 0, -ENOMEM);
-			return NULL;
+			return false;
 		}
-		pw_log_warn("connection %p: resize buffer to %zd %zd %zd",
-			    conn, buf->buffer_size, size, buf->buffer_maxsize);
+		buf->buffer_data = data;
+		buf->buffer_maxsize = size;
+		pw_log_debug("connection %p: resize buffer to %zd %zd", conn, avail, size);
+	}
+	return true;
+}
+
+static struct chunk *chunk_new(struct impl *impl, size_t size)
+{
+	struct queue *q = &impl->out;
+	struct chunk *c;
+
+	if (size <= CHUNK_SIZE && !spa_list_is_empty(&q->free)) {
+		c = spa_list_first(&q->free, struct chunk, link);
+		spa_list_remove(&c->link);
+		q->n_free--;
+	} else {
+		size = SPA_ROUND_UP_N(size, CHUNK_SIZE);
+		if ((c = malloc(sizeof(struct chunk) + size)) == NULL)
+			return NULL;
+		c->maxsize = size;
+	}
+	c->offset = 0;
+	c->size = 0;
+	spa_list_append(&q->chunks, &c->link);
+
+	return c;
+}
+
+static void chunk_free(struct impl *impl, struct chunk *c)
+{
+	struct queue *q = &impl->out;
+
+	spa_list_remove(&c->link);
+	if (c->maxsize == CHUNK_SIZE && q->n_free < MAX_FREE_CHUNKS) {
+		spa_list_append(&q->free, &c->link);
+		q->n_free++;
+	} else {
+		free(c);
+	}
+}
+
+/* get the chunk with room for size bytes of message. The first used bytes
+ * of the message are already written and move along to a new chunk. */
+static struct chunk *queue_reserve(struct pw_protocol_native_connection *conn, size_t used, size_t size)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct queue *q = &impl->out;
+	struct chunk *c = NULL, *nc;
+
+	if (!spa_list_is_empty(&q->chunks)) {
+		c = spa_list_last(&q->chunks, struct chunk, link);
+		if (c->size + size <= c->maxsize)
+			return c;
+	}
+	if ((nc = chunk_new(impl, size)) == NULL) {
+		spa_hook_list_call(&conn->listener_list, struct pw_protocol_native_connection_events, error, 0, -ENOMEM);
+		return NULL;
+	}
+	if (c != NULL) {
+		memcpy(nc->data, c->data + c->size, used);
+		if (c->size == 0)
+			chunk_free(impl, c);
 	}
-	return (uint8_t *) buf->buffer_data + buf->buffer_size;
+	return nc;
+}
+
+static void queue_clear(struct impl *impl)
+{
+	struct queue *q = &impl->out;
+	struct chunk *c, *t;
+
+	spa_list_for_each_safe(c, t, &q->chunks, link)
+		chunk_free(impl, c);
+	q->n_fds = 0;
+}
+
+static void bulk_clear(struct impl *impl)
+{
+	if (impl->bulk_in) {
+		munmap(impl->bulk_in, BULK_HEADER_SIZE + impl->bulk_in_size);
+		impl->bulk_in = NULL;
+	}
+	impl->bulk_pending = false;
+	if (impl->bulk_out) {
+		pw_memblock_free(impl->bulk_out);
+		impl->bulk_out = NULL;
+	}
+	impl->bulk = false;
+}
+
+/* map the bulk area of the peer, the fd is not needed after this */
+static void map_bulk(struct impl *impl, uint32_t index, uint32_t size)
+{
+	struct buffer *buf = &impl->in;
+	struct stat st;
+	void *data;
+	int fd;
+
+	if (!impl->bulk_recv) {
+		pw_log_error("connection %p: unexpected bulk area", impl);
+		return;
+	}
+	if (index >= buf->n_fds || (fd = buf->fds[index]) < 0) {
+		pw_log_error("connection %p: invalid bulk fd index %u", impl, index);
+		return;
+	}
+	buf->fds[index] = -1;
+
+	if (size == 0 || (size & (size - 1)) != 0 ||
+	    fstat(fd, &st) < 0 || st.st_size < BULK_HEADER_SIZE + size) {
+		pw_log_error("connection %p: invalid bulk area fd %d size %u", impl, fd, size);
+		goto done;
+	}
+	data = mmap(NULL, BULK_HEADER_SIZE + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		pw_log_error("connection %p: can't map bulk area fd %d: %m", impl, fd);
+		goto done;
+	}
+	if (impl->bulk_in)
+		munmap(impl->bulk_in, BULK_HEADER_SIZE + impl->bulk_in_size);
+	impl->bulk_in = data;
+	impl->bulk_in_size = size;
+	impl->bulk_pending = false;
+
+	pw_log_debug("connection %p: bulk area of %u bytes", impl, size);
+
+      done:
+	close(fd);
+}
+
+/* get the payload at index in the bulk area of the peer, it is released
+ * when we move to the next message */
+static void *get_bulk(struct impl *impl, uint32_t index, uint32_t size)
+{
+	uint32_t offs;
+
+	if (impl->bulk_in == NULL)
+		goto invalid;
+
+	offs = index & (impl->bulk_in_size - 1);
+	if (size > impl->bulk_in_size - offs)
+		goto invalid;
+
+	impl->bulk_release = index + size;
+	impl->bulk_pending = true;
+
+	return SPA_MEMBER(impl->bulk_in, BULK_HEADER_SIZE + offs, void);
+
+      invalid:
+	pw_log_error("connection %p: invalid bulk payload %u %u", impl, index, size);
+	return NULL;
 }
 
 static bool refill_buffer(struct pw_protocol_native_connection *conn, struct buffer *buf)
@@ -150,17 +355,19 @@ static bool refill_buffer(struct pw_protocol_native_connection *conn, struct buf
 		if (len < 0) {
 			if (errno == EINTR)
 				continue;
-			if (errno != EAGAIN || errno != EWOULDBLOCK)
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
 				goto recv_error;
 			return false;
 		}
 		break;
 	}
+	if (len == 0)
+		return false;
 
 	buf->buffer_size += len;
 
-	/* handle control messages */
-	buf->n_fds = 0;
+	/* handle control messages, the fds stay valid for the messages
+	 * in the following reads until new fds arrive */
 	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
 		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
 			continue;
@@ -182,7 +389,6 @@ static bool refill_buffer(struct pw_protocol_native_connection *conn, struct buf
 
 static void clear_buffer(struct buffer *buf)
 {
-	buf->n_fds = 0;
 	buf->offset = 0;
 	buf->size = 0;
 	buf->buffer_size = 0;
@@ -213,21 +419,19 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 	this->fd = fd;
 	spa_hook_list_init(&this->listener_list);
 
-	impl->out.buffer_data = malloc(MAX_BUFFER_SIZE);
-	impl->out.buffer_maxsize = MAX_BUFFER_SIZE;
-	impl->in.buffer_data = malloc(MAX_BUFFER_SIZE);
-	impl->in.buffer_maxsize = MAX_BUFFER_SIZE;
+	spa_list_init(&impl->out.chunks);
+	spa_list_init(&impl->out.free);
+	impl->in.buffer_data = malloc(IN_BUFFER_SIZE);
+	impl->in.buffer_maxsize = IN_BUFFER_SIZE;
 	impl->in.update = true;
 	impl->core = core;
 
-	if (impl->out.buffer_data == NULL || impl->in.buffer_data == NULL)
+	if (impl->in.buffer_data == NULL)
 		goto no_mem;
 
 	return this;
 
       no_mem:
-	free(impl->out.buffer_data);
-	free(impl->in.buffer_data);
 	free(impl);
 	return NULL;
 }
@@ -241,16 +445,79 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(struct p
 void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct chunk *c, *t;
 
 	pw_log_debug("connection %p: destroy", conn);
 
 	spa_hook_list_call(&conn->listener_list, struct pw_protocol_native_connection_events, destroy, 0);
 
-	free(impl->out.buffer_data);
+	queue_clear(impl);
+	spa_list_for_each_safe(c, t, &impl->out.free, link)
+		free(c);
+	bulk_clear(impl);
 	free(impl->in.buffer_data);
 	free(impl);
 }
 
+/** Enable sending large payloads through shared memory
+ *
+ * \param conn the connection
+ * \param enabled if the peer can receive payloads in a bulk area
+ * \param recv if payloads in a bulk area of the peer are accepted
+ *
+ * Payloads of 32 KiB and more are placed in a ringbuffer in a memfd that
+ * is shared with the peer and only their position is sent over the
+ * socket. Payloads that don't fit in the free space are sent inline.
+ *
+ * The peer can change the payload while we parse it, only accept a bulk
+ * area from a trusted peer.
+ *
+ * \memberof pw_protocol_native_connection
+ */
+void pw_protocol_native_connection_set_bulk(struct pw_protocol_native_connection *conn,
+					    bool enabled, bool recv)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct pw_memblock *mem;
+	struct chunk *c;
+	uint32_t *p, index;
+
+	pw_log_debug("connection %p: bulk %d %d", conn, enabled, recv);
+
+	impl->bulk_recv = recv;
+	impl->bulk = false;
+	if (!enabled || impl->bulk_out != NULL)
+		goto done;
+
+	if (pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+			      PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			      PW_MEMBLOCK_FLAG_SEAL,
+			      BULK_HEADER_SIZE + BULK_AREA_SIZE, &mem) < 0) {
+		pw_log_warn("connection %p: can't allocate bulk area", conn);
+		return;
+	}
+	spa_ringbuffer_init(mem->ptr);
+
+	if ((index = pw_protocol_native_connection_add_fd(conn, mem->fd)) == SPA_ID_INVALID ||
+	    (c = queue_reserve(conn, 0, 16)) == NULL) {
+		pw_memblock_free(mem);
+		return;
+	}
+	impl->bulk_out = mem;
+
+	p = (uint32_t *) (c->data + c->size);
+	p[0] = 0;
+	p[1] = BULK_AREA;
+	p[2] = index;
+	p[3] = BULK_AREA_SIZE;
+	c->size += 16;
+
+	spa_hook_list_call(&conn->listener_list,
+			struct pw_protocol_native_connection_events, need_flush, 0);
+      done:
+	impl->bulk = enabled && impl->bulk_out != NULL;
+}
+
 /** Move to the next packet in the connection
  *
  * \param conn the connection
@@ -277,11 +544,18 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 	uint8_t *data;
 	struct buffer *buf;
 	uint32_t *p;
+	void *bulk;
 
 	buf = &impl->in;
 
 	/* move to next packet */
 	buf->offset += buf->size;
+	buf->size = 0;
+
+	if (impl->bulk_pending) {
+		spa_ringbuffer_read_update(impl->bulk_in, impl->bulk_release);
+		impl->bulk_pending = false;
+	}
 
       again:
 	if (buf->update) {
@@ -291,20 +565,17 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 	}
 
 	/* now read packet */
-	data = buf->buffer_data;
-	size = buf->buffer_size;
+	data = buf->buffer_data + buf->offset;
+	size = buf->buffer_size - buf->offset;
 
-	if (buf->offset >= size) {
+	if (size == 0) {
 		clear_buffer(buf);
 		buf->update = true;
 		return false;
 	}
 
-	data += buf->offset;
-	size -= buf->offset;
-
 	if (size < 8) {
-		if (connection_ensure_size(conn, buf, 8) == NULL)
+		if (!buffer_ensure(conn, buf, 8))
 			return false;
 		buf->update = true;
 		goto again;
@@ -317,8 +588,31 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 	*opcode = p[1] >> 24;
 	len = p[1] & 0xffffff;
 
+	if (len == BULK_PAYLOAD || len == BULK_AREA) {
+		if (size < 8) {
+			if (!buffer_ensure(conn, buf, 16))
+				return false;
+			buf->update = true;
+			goto again;
+		}
+		p = (uint32_t *) data;
+		buf->offset += 16;
+
+		if (len == BULK_AREA) {
+			map_bulk(impl, p[0], p[1]);
+			goto again;
+		}
+		if ((bulk = get_bulk(impl, p[0], p[1])) == NULL)
+			goto again;
+
+		*dt = bulk;
+		*sz = p[1];
+
+		return true;
+	}
+
 	if (len > size) {
-		if (connection_ensure_size(conn, buf, len) == NULL)
+		if (!buffer_ensure(conn, buf, 8 + len))
 			return false;
 		buf->update = true;
 		goto again;
@@ -333,30 +627,24 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 	return true;
 }
 
-static inline void *begin_write(struct pw_protocol_native_connection *conn, uint32_t size)
-{
-	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
-	uint32_t *p;
-	struct buffer *buf = &impl->out;
-	/* 4 for dest_id, 1 for opcode, 3 for size and size for payload */
-	if ((p = connection_ensure_size(conn, buf, 8 + size)) == NULL)
-		return NULL;
-
-	return p + 2;
-}
-
 static uint32_t write_pod(struct spa_pod_builder *b, const void *data, uint32_t size)
 {
 	struct impl *impl = SPA_CONTAINER_OF(b, struct impl, builder);
 	uint32_t ref = b->state.offset;
+	struct chunk *c;
+
+	if (ref + size > b->size) {
+		/* 4 for dest_id, 1 for opcode, 3 for size and size for payload */
+		b->size = SPA_ROUND_UP_N(ref + size, 4096);
+		if ((c = queue_reserve(&impl->this, 8 + ref, 8 + b->size)) == NULL) {
+			b->size = 0;
+			return -1;
+		}
+		b->data = c->data + c->size + 8;
+	}
+	memcpy(b->data + ref, data, size);
 
-        if (b->size <= ref) {
-                b->size = SPA_ROUND_UP_N(ref + size, 4096);
-                b->data = begin_write(&impl->this, b->size);
-        }
-        memcpy(b->data + ref, data, size);
-
-        return ref;
+	return ref;
 }
 
 struct spa_pod_builder *
@@ -417,21 +705,62 @@ pw_protocol_native_connection_begin_proxy(struct pw_protocol_native_connection *
 	return &impl->builder;
 }
 
+/* copy the payload to the bulk area and replace it with its
+ * index and size */
+static bool write_bulk(struct impl *impl, uint32_t *payload, uint32_t size)
+{
+	struct spa_ringbuffer *rb = impl->bulk_out->ptr;
+	uint32_t index, offs, skip;
+	int32_t filled;
+
+	filled = spa_ringbuffer_get_write_index(rb, &index);
+	if (filled < 0 || filled > BULK_AREA_SIZE) {
+		pw_log_warn("connection %p: bulk area corrupted, disable", impl);
+		impl->bulk = false;
+		return false;
+	}
+
+	/* payloads are contiguous, skip the end of the area when needed */
+	offs = index & (BULK_AREA_SIZE - 1);
+	skip = offs + size > BULK_AREA_SIZE ? BULK_AREA_SIZE - offs : 0;
+	if (filled + skip + size > BULK_AREA_SIZE)
+		return false;
+
+	index += skip;
+	memcpy(SPA_MEMBER(rb, BULK_HEADER_SIZE + (index & (BULK_AREA_SIZE - 1)), void),
+	       payload, size);
+	spa_ringbuffer_write_update(rb, index + size);
+
+	payload[0] = index;
+	payload[1] = size;
+
+	return true;
+}
+
 void
 pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 				  struct spa_pod_builder *builder)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	uint32_t *p, size = builder->state.offset;
-	struct buffer *buf = &impl->out;
+	struct chunk *c;
 
-	if ((p = connection_ensure_size(conn, buf, 8 + size)) == NULL)
+	if ((c = queue_reserve(conn, 8 + size, 8 + size)) == NULL)
 		return;
 
-	*p++ = impl->dest_id;
-	*p++ = (impl->opcode << 24) | (size & 0xffffff);
+	p = (uint32_t *) (c->data + c->size);
+	p[0] = impl->dest_id;
 
-	buf->buffer_size += 8 + size;
+	if (size >= BULK_THRESHOLD && impl->bulk && write_bulk(impl, &p[2], size)) {
+		p[1] = (impl->opcode << 24) | BULK_PAYLOAD;
+		c->size += 16;
+		p = SPA_MEMBER(impl->bulk_out->ptr,
+				BULK_HEADER_SIZE + (p[2] & (BULK_AREA_SIZE - 1)), uint32_t);
+	} else {
+		p[1] = (impl->opcode << 24) | (size & 0xffffff);
+		c->size += 8 + size;
+		p += 2;
+	}
 
 	if (debug_messages) {
 		printf(">>>>>>>>> out: %d %d %d\n", impl->dest_id, impl->opcode, size);
@@ -444,74 +773,96 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 /** Flush the connection object
  *
  * \param conn the connection object
- * \return true on success
+ * \return 0 when all queued messages were written, -EAGAIN when the
+ *	socket is full and messages remain queued or a negative errno
+ *	on error.
  *
- * Write the queued messages on the connection to the socket
+ * Write the queued messages on the connection to the socket. The chunks
+ * of the queue are written with one sendmsg() call, partially written
+ * chunks are resumed on the next flush.
  *
  * \memberof pw_protocol_native_connection
  */
-bool pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn)
+int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	ssize_t len;
 	struct msghdr msg = { 0 };
-	struct iovec iov[1];
+	struct iovec iov[MAX_IOV];
 	struct cmsghdr *cmsg;
 	char cmsgbuf[CMSG_SPACE(MAX_FDS * sizeof(int))];
-	int *cm;
-	uint32_t i, fds_len;
-	struct buffer *buf;
-
-	buf = &impl->out;
-
-	if (buf->buffer_size == 0)
-		return true;
-
-	fds_len = buf->n_fds * sizeof(int);
-
-	iov[0].iov_base = buf->buffer_data;
-	iov[0].iov_len = buf->buffer_size;
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 1;
-
-	if (buf->n_fds > 0) {
-		msg.msg_control = cmsgbuf;
-		msg.msg_controllen = CMSG_SPACE(fds_len);
-		cmsg = CMSG_FIRSTHDR(&msg);
-		cmsg->cmsg_level = SOL_SOCKET;
-		cmsg->cmsg_type = SCM_RIGHTS;
-		cmsg->cmsg_len = CMSG_LEN(fds_len);
-		cm = (int *) CMSG_DATA(cmsg);
-		for (i = 0; i < buf->n_fds; i++)
-			cm[i] = buf->fds[i] > 0 ? buf->fds[i] : -buf->fds[i];
-		msg.msg_controllen = cmsg->cmsg_len;
-	} else {
-		msg.msg_control = NULL;
-		msg.msg_controllen = 0;
-	}
+	int *cm, res;
+	uint32_t i, n_iov, fds_len;
+	struct queue *q = &impl->out;
+	struct chunk *c, *t;
 
 	while (true) {
-		len = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
-		if (len < 0) {
-			if (errno == EINTR)
+		n_iov = 0;
+		spa_list_for_each(c, &q->chunks, link) {
+			if (c->offset == c->size)
 				continue;
-			else
+			iov[n_iov].iov_base = c->data + c->offset;
+			iov[n_iov].iov_len = c->size - c->offset;
+			if (++n_iov == MAX_IOV)
+				break;
+		}
+		if (n_iov == 0)
+			break;
+
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n_iov;
+
+		if (q->n_fds > 0) {
+			fds_len = q->n_fds * sizeof(int);
+			msg.msg_control = cmsgbuf;
+			msg.msg_controllen = CMSG_SPACE(fds_len);
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(fds_len);
+			cm = (int *) CMSG_DATA(cmsg);
+			for (i = 0; i < q->n_fds; i++)
+				cm[i] = q->fds[i] > 0 ? q->fds[i] : -q->fds[i];
+			msg.msg_controllen = cmsg->cmsg_len;
+		} else {
+			msg.msg_control = NULL;
+			msg.msg_controllen = 0;
+		}
+
+		while (true) {
+			len = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (len < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return -EAGAIN;
 				goto send_error;
+			}
+			break;
+		}
+		pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, len,
+			     q->n_fds);
+
+		/* the fds went out with the first byte */
+		q->n_fds = 0;
+
+		spa_list_for_each_safe(c, t, &q->chunks, link) {
+			size_t avail = c->size - c->offset;
+			if ((size_t) len < avail) {
+				c->offset += len;
+				break;
+			}
+			len -= avail;
+			chunk_free(impl, c);
 		}
-		break;
 	}
-	pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, len,
-		     buf->n_fds);
-
-	buf->buffer_size -= len;
-	buf->n_fds = 0;
-
-	return true;
+	return 0;
 
 	/* ERRORS */
       send_error:
+	res = -errno;
 	pw_log_error("could not sendmsg: %s", strerror(errno));
-	return false;
+	return res;
 }
 
 /** Clear the connection object
@@ -527,8 +878,10 @@ bool pw_protocol_native_connection_clear(struct pw_protocol_native_connection *c
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 
-	clear_buffer(&impl->out);
+	queue_clear(impl);
 	clear_buffer(&impl->in);
+	impl->in.n_fds = 0;
+	bulk_clear(impl);
 	impl->in.update = true;
 
 	return true;
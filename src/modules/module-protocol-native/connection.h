@@ -27,6 +27,9 @@ extern "C" {
 #include <spa/utils/defs.h>
 #include <spa/utils/hook.h>
 
+/** flags in the hello message of the client */
+#define PW_PROTOCOL_NATIVE_FLAG_BULK	(1 << 0)	/**< can receive payloads in memfds */
+
 struct pw_protocol_native_connection_events {
 #define PW_VERSION_PROTOCOL_NATIVE_CONNECTION_EVENTS	0
 	uint32_t version;
@@ -66,6 +69,10 @@ pw_protocol_native_connection_new(struct pw_core *core, int fd);
 void
 pw_protocol_native_connection_destroy(struct pw_protocol_native_connection *conn);
 
+void
+pw_protocol_native_connection_set_bulk(struct pw_protocol_native_connection *conn,
+				       bool enabled, bool recv);
+
 bool
 pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *conn,
 				       uint8_t *opcode,
@@ -89,7 +96,7 @@ void
 pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
                                   struct spa_pod_builder *builder);
 
-bool
+int
 pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn);
 
 bool
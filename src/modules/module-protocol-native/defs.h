@@ -23,3 +23,5 @@ int pw_protocol_native_connect_local_socket(struct pw_protocol_client *client,
 int pw_protocol_native_connect_portal_screencast(struct pw_protocol_client *client,
 					    void (*done_callback) (void *data, int res),
 					    void *data);
+
+void pw_protocol_native_client_set_flags(struct pw_client *client, uint32_t flags);
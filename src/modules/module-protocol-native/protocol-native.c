@@ -26,18 +26,61 @@
 #include "pipewire/protocol.h"
 #include "pipewire/interfaces.h"
 #include "pipewire/resource.h"
+#include "pipewire/private.h"
 #include "extensions/protocol-native.h"
 
 #include "connection.h"
+#include "defs.h"
+
+/* the type maps are compared in blocks of this many types */
+#define TYPES_BLOCK	16
+
+/* add the names of the types in block @block to the FNV-1a hash @hash */
+static uint64_t types_hash_block(struct spa_type_map *map, uint32_t block, uint64_t hash)
+{
+	uint32_t id;
+	const char *s;
+
+	for (id = block * TYPES_BLOCK; id < (block + 1) * TYPES_BLOCK; id++) {
+		for (s = spa_type_map_get_type(map, id); s && *s; s++) {
+			hash ^= (uint8_t) *s;
+			hash *= 0x100000001b3ULL;
+		}
+		/* the terminating zero */
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define TYPES_HASH_INIT		0xcbf29ce484222325ULL
 
 static void core_marshal_hello(void *object)
 {
 	struct pw_proxy *proxy = object;
+	struct pw_remote *remote = proxy->remote;
+	struct spa_type_map *map = remote->core->type.map;
 	struct spa_pod_builder *b;
+	uint32_t i, n_blocks;
+	uint64_t hash = TYPES_HASH_INIT;
+
+	/* don't send our types yet, the daemon tells us in its first
+	 * update_types how many of them it already has at the same ids */
+	remote->n_types = spa_type_map_get_size(map);
+	remote->types_pending = true;
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_HELLO);
 
-	spa_pod_builder_struct(b, "P", NULL);
+	n_blocks = remote->n_types / TYPES_BLOCK;
+	spa_pod_builder_add(b,
+			    "["
+			    " i", PW_PROTOCOL_NATIVE_FLAG_BULK,
+			    " i", n_blocks, NULL);
+
+	for (i = 0; i < n_blocks; i++) {
+		hash = types_hash_block(map, i, hash);
+		spa_pod_builder_add(b, "l", hash, NULL);
+	}
+	spa_pod_builder_add(b, "]", NULL);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -263,6 +306,7 @@ static int core_demarshal_remove_id(void *object, void *data, size_t size)
 static int core_demarshal_update_types_client(void *object, void *data, size_t size)
 {
 	struct pw_proxy *proxy = object;
+	struct pw_remote *remote = proxy->remote;
 	struct spa_pod_parser prs;
 	uint32_t first_id, n_types;
 	const char **types;
@@ -280,6 +324,17 @@ static int core_demarshal_update_types_client(void *object, void *data, size_t s
 		if (spa_pod_parser_get(&prs, "s", &types[i], NULL) < 0)
 			return -EINVAL;
 	}
+
+	if (remote->types_pending) {
+		/* the first update after hello starts after the types that
+		 * the daemon has at the same ids as we do, send the others */
+		remote->types_pending = false;
+		first_id = SPA_MIN(first_id, remote->n_types);
+		for (i = 0; i < first_id; i++)
+			pw_map_insert_at(&remote->types, i, PW_MAP_ID_TO_PTR(i));
+		remote->types_identity = true;
+		remote->n_types = first_id;
+	}
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, update_types, 0, first_id, types, n_types);
 	return 0;
 }
@@ -428,16 +483,73 @@ static int core_demarshal_permissions(void *object, void *data, size_t size)
 	return 0;
 }
 
+static bool types_is_identity(struct pw_map *types)
+{
+	uint32_t i, size = pw_map_get_size(types);
+
+	for (i = 0; i < size; i++) {
+		if (pw_map_lookup(types, i) != PW_MAP_ID_TO_PTR(i))
+			return false;
+	}
+	return true;
+}
+
+/* Map the common types of the client at the same ids and send the rest of
+ * our types. The first id of the update tells the client how many of its
+ * types it still needs to send. */
+static void hello_types(struct pw_resource *resource, uint32_t n_common)
+{
+	struct pw_client *client = pw_resource_get_client(resource);
+	struct spa_type_map *map = resource->core->type.map;
+	uint32_t i, n_types = spa_type_map_get_size(map);
+	const char **types;
+
+	for (i = 0; i < n_common; i++)
+		pw_map_insert_at(&client->types, i, PW_MAP_ID_TO_PTR(i));
+	client->types_identity = types_is_identity(&client->types);
+
+	types = alloca((n_types - n_common) * sizeof(char *));
+	for (i = n_common; i < n_types; i++)
+		types[i - n_common] = spa_type_map_get_type(map, i);
+
+	client->n_types = n_types;
+	pw_core_resource_update_types(resource, n_common, types, n_types - n_common);
+}
+
 static int core_demarshal_hello(void *object, void *data, size_t size)
 {
 	struct pw_resource *resource = object;
+	struct spa_type_map *map = resource->core->type.map;
 	struct spa_pod_parser prs;
-	void *ptr;
+	struct spa_pod *ptr;
+	uint32_t i, flags = 0, n_blocks = 0, n_common = 0;
+	uint64_t hash, our_hash = TYPES_HASH_INIT;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[P]", &ptr, NULL) < 0)
+	if (spa_pod_parser_get(&prs, "[P", &ptr, NULL) < 0)
 		return -EINVAL;
 
+	/* older clients send an empty pod and all their types before hello */
+	if (ptr && SPA_POD_TYPE(ptr) == SPA_POD_TYPE_INT) {
+		flags = SPA_POD_VALUE(struct spa_pod_int, ptr);
+		if (spa_pod_parser_get(&prs, "i", &n_blocks, NULL) < 0)
+			return -EINVAL;
+	}
+
+	for (i = 0; i < n_blocks; i++) {
+		if (spa_pod_parser_get(&prs, "l", &hash, NULL) < 0)
+			return -EINVAL;
+		if ((i + 1) * TYPES_BLOCK > spa_type_map_get_size(map))
+			break;
+		our_hash = types_hash_block(map, i, our_hash);
+		if (our_hash != hash)
+			break;
+		n_common += TYPES_BLOCK;
+	}
+
+	pw_protocol_native_client_set_flags(pw_resource_get_client(resource), flags);
+	hello_types(resource, n_common);
+
 	pw_resource_do(resource, struct pw_core_proxy_methods, hello, 0);
 	return 0;
 }
@@ -108,7 +108,6 @@ static void core_hello(void *object)
 	struct pw_core *this = resource->core;
 
 	pw_log_debug("core %p: hello from source %p", this, resource);
-	resource->client->n_types = 0;
 
 	this->info.change_mask = PW_CORE_CHANGE_MASK_ALL;
 	pw_core_resource_info(resource, &this->info);
@@ -276,6 +275,8 @@ static void core_update_types(void *object, uint32_t first_id, const char **type
 		uint32_t this_id = spa_type_map_get_id(this->type.map, types[i]);
 		if (!pw_map_insert_at(&client->types, first_id, PW_MAP_ID_TO_PTR(this_id)))
 			pw_log_error("can't add type %d->%d for client", first_id, this_id);
+		if (this_id != first_id)
+			client->types_identity = false;
 	}
 }
 
@@ -352,6 +353,62 @@ static const struct pw_global_events global_events = {
 	.bind = global_bind,
 };
 
+static int
+do_set_pool(struct spa_loop *loop,
+	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_core *this = user_data;
+	struct pw_graph_pool *pool = *(struct pw_graph_pool **) data;
+
+	this->rt.pool = pool;
+	if (pool) {
+		/* the counters of the plan are stale when it was not used, a
+		 * plan that is too old is compiled again on the main loop */
+		if (this->rt.plan.valid && this->rt.plan.version == this->rt.graph.version)
+			spa_graph_plan_reset(&this->rt.plan);
+		spa_graph_set_callbacks(&this->rt.graph, &pw_graph_pool_impl, pool);
+	} else
+		spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, NULL);
+	return 0;
+}
+
+static void update_busy_poll(struct pw_core *core)
+{
+	const char *str;
+	uint64_t busy_poll = 0;
+
+	if ((str = pw_properties_get(core->properties, PW_CORE_PROP_BUSY_POLL)) != NULL)
+		busy_poll = strtoull(str, NULL, 10) * SPA_NSEC_PER_USEC;
+
+	pw_data_loop_set_busy_poll(core->data_loop_impl, busy_poll);
+}
+
+/* start the workers for the configured number of data threads and swap
+ * them in on the data loop */
+static void update_data_threads(struct pw_core *core)
+{
+	struct pw_graph_pool *old = core->rt.pool, *pool = NULL;
+	const char *str;
+	uint32_t n_threads = 1;
+
+	if ((str = pw_properties_get(core->properties, PW_CORE_PROP_DATA_THREADS)) != NULL)
+		n_threads = atoi(str);
+
+	if (n_threads > 1) {
+		if ((pool = pw_graph_pool_new(core, n_threads)) == NULL)
+			pw_log_warn("core %p: can't create %d data threads", core, n_threads);
+	}
+	if (pool == NULL && old == NULL)
+		return;
+
+	pw_log_debug("core %p: %d data threads", core, pool ? n_threads : 1);
+
+	pw_loop_invoke(core->data_loop, do_set_pool, SPA_ID_INVALID, &pool, sizeof(pool), true, core);
+
+	if (old)
+		pw_graph_pool_destroy(old);
+}
+
 /** Create a new core object
  *
  * \param main_loop the main loop to use
@@ -389,10 +446,17 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	pw_map_init(&this->globals, 128, 32);
 
 	spa_graph_init(&this->rt.graph);
+	spa_graph_plan_init(&this->rt.plan, &this->rt.graph);
 	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, NULL);
 
 	this->dbus_iface = pw_get_spa_dbus(this->main_loop);
 
+	/* install the logger of the main loop before the data thread runs */
+	if ((this->log_iface = pw_get_spa_log(this->main_loop)) != NULL) {
+		this->old_log = pw_log_get();
+		pw_log_set(this->log_iface);
+	}
+
 	this->support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, this->type.map);
 	this->support[1] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__DataLoop, this->data_loop->loop);
 	this->support[2] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__MainLoop, this->main_loop->loop);
@@ -405,6 +469,9 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 
 	pw_data_loop_start(this->data_loop_impl);
 
+	update_data_threads(this);
+	update_busy_poll(this);
+
 	spa_list_init(&this->protocol_list);
 	spa_list_init(&this->remote_list);
 	spa_list_init(&this->resource_list);
@@ -496,6 +563,10 @@ void pw_core_destroy(struct pw_core *core)
 
 	pw_data_loop_destroy(core->data_loop_impl);
 
+	if (core->rt.pool)
+		pw_graph_pool_destroy(core->rt.pool);
+	spa_graph_plan_clear(&core->rt.plan);
+
 	pw_release_spa_dbus(core->dbus_iface);
 
 	pw_properties_free(core->properties);
@@ -503,6 +574,12 @@ void pw_core_destroy(struct pw_core *core)
 	pw_map_clear(&core->globals);
 
 	pw_log_debug("core %p: free", core);
+
+	if (core->log_iface) {
+		if (pw_log_get() == core->log_iface)
+			pw_log_set(core->old_log);
+		pw_release_spa_log(core->log_iface);
+	}
 	free(core);
 }
 
@@ -558,9 +635,17 @@ int pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict)
 {
 	struct pw_resource *resource;
 	uint32_t i;
+	bool update_threads = false;
 
-	for (i = 0; i < dict->n_items; i++)
+	for (i = 0; i < dict->n_items; i++) {
 		pw_properties_set(core->properties, dict->items[i].key, dict->items[i].value);
+		if (strcmp(dict->items[i].key, PW_CORE_PROP_DATA_THREADS) == 0)
+			update_threads = true;
+		else if (strcmp(dict->items[i].key, PW_CORE_PROP_BUSY_POLL) == 0)
+			update_busy_poll(core);
+	}
+	if (update_threads)
+		update_data_threads(core);
 
 	core->info.change_mask = PW_CORE_CHANGE_MASK_PROPS;
 	core->info.props = &core->properties->dict;
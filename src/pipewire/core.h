@@ -110,6 +110,12 @@ struct pw_core_events {
 #define PW_CORE_PROP_VERSION	"pipewire.core.version"
 /** If the core should listen for connections, boolean default false */
 #define PW_CORE_PROP_DAEMON	"pipewire.daemon"
+/** The number of threads that process the graph, default 1. With more
+ * threads, independent branches of the graph are processed in parallel */
+#define PW_CORE_PROP_DATA_THREADS	"pipewire.core.data-threads"
+/** The time in microseconds the data loop spins before it goes to sleep,
+ * default 0. Trades CPU time for lower wakeup latency */
+#define PW_CORE_PROP_BUSY_POLL	"pipewire.core.busy-poll"
 
 /** Make a new core object for a given main_loop. Ownership of the properties is taken */
 struct pw_core * pw_core_new(struct pw_loop *main_loop, struct pw_properties *props);
@@ -19,25 +19,75 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/resource.h>
 
 #include "pipewire/log.h"
 #include "pipewire/data-loop.h"
 #include "pipewire/private.h"
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* Poll the loop without sleeping for at most the spin budget. The budget
+ * adapts: it is halved, down to 1/16 of the configured time, when spinning
+ * did not find an event and doubled again when it did, so that the loop
+ * only burns CPU while spinning pays off. Returns the number of events. */
+static int do_spin(struct pw_data_loop *this, uint64_t busy_poll)
+{
+	struct pw_data_loop_stats *stats = &this->stats;
+	uint64_t start, now;
+	int res;
+
+	if (stats->budget == 0 || stats->budget > busy_poll)
+		stats->budget = busy_poll;
+
+	start = now = get_time_ns();
+	do {
+		if ((res = pw_loop_iterate(this->loop, 0)) != 0)
+			break;
+		now = get_time_ns();
+	} while (now - start < stats->budget && this->running);
+
+	now = get_time_ns();
+	stats->spins++;
+	stats->spin_time += now - start;
+
+	if (res > 0) {
+		stats->hits++;
+		stats->hit_time += now - start;
+		stats->budget = SPA_MIN(stats->budget * 2, busy_poll);
+	} else {
+		stats->budget = SPA_MAX(stats->budget / 2, busy_poll / 16);
+	}
+	return res;
+}
+
 static void *do_loop(void *user_data)
 {
 	struct pw_data_loop *this = user_data;
+	uint64_t busy_poll;
 	int res;
 
 	pw_log_debug("data-loop %p: enter thread", this);
 	pw_loop_enter(this->loop);
 
 	while (this->running) {
+		busy_poll = __atomic_load_n(&this->busy_poll, __ATOMIC_RELAXED);
+		if (busy_poll > 0 && (res = do_spin(this, busy_poll)) != 0) {
+			if (res < 0)
+				pw_log_warn("data-loop %p: iterate error %d", this, res);
+			continue;
+		}
 		if ((res = pw_loop_iterate(this->loop, -1)) < 0)
 			pw_log_warn("data-loop %p: iterate error %d", this, res);
 	}
-	pw_log_debug("data-loop %p: leave thread", this);
+	pw_log_debug("data-loop %p: leave thread, %"PRIu64" spins, %"PRIu64" hits",
+			this, this->stats.spins, this->stats.hits);
 	pw_loop_leave(this->loop);
 
 	return NULL;
@@ -163,3 +213,33 @@ bool pw_data_loop_in_thread(struct pw_data_loop * loop)
 {
 	return pthread_equal(loop->thread, pthread_self());
 }
+
+/** Configure busy-polling
+ * \param loop the data loop
+ * \param timeout the maximum time in nanoseconds to spin
+ *
+ * Before going to sleep, the loop polls for new events for at most
+ * \a timeout nanoseconds. This avoids the wakeup latency of the
+ * sleep at the cost of CPU time. 0 disables busy-polling.
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_set_busy_poll(struct pw_data_loop *loop, uint64_t timeout)
+{
+	pw_log_debug("data-loop %p: busy-poll %"PRIu64" ns", loop, timeout);
+	__atomic_store_n(&loop->busy_poll, timeout, __ATOMIC_RELAXED);
+}
+
+/** Get the busy-poll statistics
+ * \param loop the data loop
+ * \param stats filled with the statistics
+ *
+ * The statistics are updated by the data loop thread without locking and
+ * are only meant for monitoring.
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_get_stats(struct pw_data_loop *loop, struct pw_data_loop_stats *stats)
+{
+	*stats = loop->stats;
+}
@@ -36,6 +36,15 @@ struct pw_data_loop;
 #include <pipewire/loop.h>
 #include <pipewire/properties.h>
 
+/** Statistics of the busy-poll mode */
+struct pw_data_loop_stats {
+	uint64_t spins;		/**< number of times the loop spun before sleeping */
+	uint64_t hits;		/**< spins that found an event */
+	uint64_t spin_time;	/**< total time spent spinning in nanoseconds */
+	uint64_t hit_time;	/**< time spent spinning in the spins that hit */
+	uint64_t budget;	/**< current time the loop spins in nanoseconds */
+};
+
 /** Loop events, use \ref pw_data_loop_add_listener to add a listener */
 struct pw_data_loop_events {
 #define PW_VERSION_DATA_LOOP_EVENTS		0
@@ -70,6 +79,13 @@ int pw_data_loop_stop(struct pw_data_loop *loop);
 /** Check if the current thread is the processing thread */
 bool pw_data_loop_in_thread(struct pw_data_loop *loop);
 
+/** Spin for at most \a timeout nanoseconds before going to sleep, 0 disables
+ * spinning */
+void pw_data_loop_set_busy_poll(struct pw_data_loop *loop, uint64_t timeout);
+
+/** Get the busy-poll statistics */
+void pw_data_loop_get_stats(struct pw_data_loop *loop, struct pw_data_loop_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
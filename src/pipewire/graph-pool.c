@@ -0,0 +1,666 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <spa/graph/graph-scheduler6.h>
+
+#include "pipewire/log.h"
+#include "pipewire/private.h"
+
+/** \cond */
+
+#define CACHE_LINE	64
+#define MAX_SPIN	64
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax()	__builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax()	__asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax()	__asm__ __volatile__("" ::: "memory")
+#endif
+
+/* work stealing deque of ready nodes. Only the owner pushes and pops at
+ * the bottom, the other threads steal from the top. A node is queued at
+ * most once per round so the size is bounded by the number of nodes. */
+struct queue {
+	int64_t top __attribute__((aligned(CACHE_LINE)));
+	int64_t bottom __attribute__((aligned(CACHE_LINE)));
+	struct spa_graph_plan_node **items;
+	uint32_t mask;
+};
+
+struct worker {
+	struct pw_graph_pool *pool;
+	uint32_t id;
+	pthread_t thread;
+	bool started;
+	struct queue queue;
+	struct spa_graph_plan_node **spare;	/**< queue swapped in with the plan */
+} __attribute__((aligned(CACHE_LINE)));
+
+struct pw_graph_pool {
+	struct pw_core *core;
+	struct spa_graph_plan *plan;	/**< the running plan */
+	struct spa_graph_plan next;	/**< compiled on the main loop */
+	struct spa_source *compile_event;
+	bool compile_pending;
+
+	uint32_t n_workers;		/**< workers, including the driver */
+	struct worker *workers;		/**< the driver is worker 0 */
+	uint32_t size;			/**< size of the queues */
+	uint32_t spare_size;		/**< size of the spare queues */
+
+	bool running;
+	bool sched_set;
+	bool in_push;
+	uint32_t first_push;
+
+	int32_t seq __attribute__((aligned(CACHE_LINE)));	/**< futex, new push phase */
+	int32_t outstanding __attribute__((aligned(CACHE_LINE)));	/**< queued and running nodes */
+	int32_t active __attribute__((aligned(CACHE_LINE)));	/**< workers in the push phase */
+	int32_t n_late __attribute__((aligned(CACHE_LINE)));	/**< outputs from other threads */
+};
+
+static __thread struct worker *current_worker;
+/** \endcond */
+
+static inline void queue_push(struct queue *q, struct spa_graph_plan_node *pn)
+{
+	int64_t b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED);
+
+	q->items[b & q->mask] = pn;
+	__atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELEASE);
+}
+
+static inline struct spa_graph_plan_node *queue_pop(struct queue *q)
+{
+	int64_t b, t;
+	struct spa_graph_plan_node *pn = NULL;
+
+	b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&q->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+
+	if (t <= b) {
+		pn = q->items[b & q->mask];
+		if (t == b) {
+			/* last item, race with the thieves */
+			if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, false,
+							 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+				pn = NULL;
+			__atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+		}
+	} else {
+		__atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return pn;
+}
+
+static inline struct spa_graph_plan_node *queue_steal(struct queue *q)
+{
+	int64_t t, b;
+	struct spa_graph_plan_node *pn;
+
+	t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+
+	if (t >= b)
+		return NULL;
+
+	pn = q->items[t & q->mask];
+	if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+	return pn;
+}
+
+static inline void futex_wait(int32_t *addr, int32_t val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake(int32_t *addr, int32_t n)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static void pool_add_pending(struct pw_graph_pool *pool, struct spa_graph_plan_node *pn)
+{
+	struct spa_graph_plan *plan = pool->plan;
+	uint32_t index;
+
+	if (__atomic_fetch_or(&pn->flags, SPA_GRAPH_PLAN_NODE_PENDING, __ATOMIC_ACQ_REL) &
+	    SPA_GRAPH_PLAN_NODE_PENDING)
+		return;
+
+	index = __atomic_fetch_add(&plan->n_pending, 1, __ATOMIC_ACQ_REL);
+	plan->pending[index] = pn->index;
+}
+
+/* output from a thread that is not a worker during the push phase, the
+ * driver pushes it after the workers are joined */
+static void pool_add_late(struct pw_graph_pool *pool, struct spa_graph_plan_node *pn)
+{
+	__atomic_fetch_or(&pn->flags, SPA_GRAPH_PLAN_NODE_OUTPUT, __ATOMIC_ACQ_REL);
+	__atomic_add_fetch(&pool->n_late, 1, __ATOMIC_ACQ_REL);
+}
+
+/* queue the node when it has all its input. The counter can be ahead
+ * of the io areas, the flag makes sure only one thread queues it. */
+static void pool_queue_ready(struct pw_graph_pool *pool, struct worker *w,
+			     struct spa_graph_plan_node *pn, uint32_t ready)
+{
+	uint32_t required = pn->required[SPA_DIRECTION_INPUT];
+
+	if (required == 0 || ready < required ||
+	    spa_graph_plan_count(pn, SPA_DIRECTION_INPUT, SPA_STATUS_HAVE_BUFFER) < required)
+		return;
+
+	if (__atomic_fetch_or(&pn->flags, SPA_GRAPH_PLAN_NODE_QUEUED, __ATOMIC_ACQ_REL) &
+	    SPA_GRAPH_PLAN_NODE_QUEUED)
+		return;
+
+	__atomic_add_fetch(&pool->outstanding, 1, __ATOMIC_ACQ_REL);
+	queue_push(&w->queue, pn);
+}
+
+/* count the output on the peers and queue the ones that have all their
+ * input */
+static void pool_push_peers(struct pw_graph_pool *pool, struct worker *w,
+			    struct spa_graph_plan_node *pn)
+{
+	uint32_t i;
+
+	for (i = 0; i < pn->n_ports[SPA_DIRECTION_OUTPUT]; i++) {
+		struct spa_graph_port *pport = pn->ports[SPA_DIRECTION_OUTPUT][i]->peer;
+		struct spa_graph_plan_node *peer;
+		uint32_t ready;
+
+		if (pport->flags & SPA_GRAPH_PORT_FLAG_DISABLED)
+			continue;
+
+		peer = &pool->plan->nodes[pn->peers[SPA_DIRECTION_OUTPUT][i]];
+		if (pport->io->status != SPA_STATUS_HAVE_BUFFER)
+			continue;
+
+		ready = __atomic_add_fetch(&peer->ready[SPA_DIRECTION_INPUT], 1, __ATOMIC_ACQ_REL);
+		if (peer->index >= pool->first_push)
+			pool_queue_ready(pool, w, peer, ready);
+	}
+}
+
+static void pool_process(struct pw_graph_pool *pool, struct worker *w,
+			 struct spa_graph_plan_node *pn)
+{
+	pn->node->state = spa_node_process_input(pn->node->implementation);
+	__atomic_store_n(&pn->ready[SPA_DIRECTION_INPUT],
+			 spa_graph_plan_count(pn, SPA_DIRECTION_INPUT, SPA_STATUS_HAVE_BUFFER),
+			 __ATOMIC_RELEASE);
+	__atomic_and_fetch(&pn->flags, ~SPA_GRAPH_PLAN_NODE_QUEUED, __ATOMIC_ACQ_REL);
+
+	pw_log_trace("graph-pool %p: worker %d node %p processed in %d", pool,
+		     w->id, pn->node, pn->node->state);
+
+	if (pn->node->state == SPA_STATUS_HAVE_BUFFER)
+		pool_push_peers(pool, w, pn);
+	else if (pn->node->state == SPA_STATUS_NEED_BUFFER)
+		pool_add_pending(pool, pn);
+
+	__atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_ACQ_REL);
+}
+
+/* run ready nodes until all queued nodes are processed */
+static void pool_work(struct pw_graph_pool *pool, struct worker *w)
+{
+	struct spa_graph_plan_node *pn;
+	uint32_t i, spin = 0;
+
+	current_worker = w;
+
+	while (__atomic_load_n(&pool->outstanding, __ATOMIC_ACQUIRE) > 0) {
+		if ((pn = queue_pop(&w->queue)) == NULL) {
+			for (i = 1; i < pool->n_workers; i++) {
+				struct worker *victim = &pool->workers[(w->id + i) % pool->n_workers];
+				if ((pn = queue_steal(&victim->queue)) != NULL)
+					break;
+			}
+		}
+		if (pn != NULL) {
+			pool_process(pool, w, pn);
+			spin = 0;
+		}
+		else if (++spin < MAX_SPIN)
+			cpu_relax();
+		else
+			sched_yield();
+	}
+	current_worker = NULL;
+}
+
+static void *do_worker(void *data)
+{
+	struct worker *w = data;
+	struct pw_graph_pool *pool = w->pool;
+	int32_t seq = 0;
+
+	pw_log_debug("graph-pool %p: worker %d enter", pool, w->id);
+
+	while (true) {
+		int32_t s = __atomic_load_n(&pool->seq, __ATOMIC_ACQUIRE);
+
+		if (s == seq) {
+			futex_wait(&pool->seq, seq);
+			continue;
+		}
+		seq = s;
+
+		if (!__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE))
+			break;
+
+		__atomic_add_fetch(&pool->active, 1, __ATOMIC_ACQ_REL);
+		pool_work(pool, w);
+		__atomic_sub_fetch(&pool->active, 1, __ATOMIC_ACQ_REL);
+	}
+	pw_log_debug("graph-pool %p: worker %d leave", pool, w->id);
+	return NULL;
+}
+
+/* the workers run with the same priority as the driver, which is
+ * usually made realtime after the pool was created */
+static void pool_update_sched(struct pw_graph_pool *pool)
+{
+	struct sched_param sp;
+	uint32_t i;
+	int policy, res;
+
+	pool->sched_set = true;
+
+	if ((res = pthread_getschedparam(pthread_self(), &policy, &sp)) != 0)
+		return;
+
+	for (i = 1; i < pool->n_workers; i++) {
+		if ((res = pthread_setschedparam(pool->workers[i].thread, policy, &sp)) != 0)
+			pw_log_warn("graph-pool %p: can't set worker %d priority: %s",
+				    pool, i, strerror(res));
+	}
+}
+
+/* allocate queues for n_nodes in the spare queues of the workers, they
+ * are swapped in with the plan */
+static int pool_alloc_spare(struct pw_graph_pool *pool, uint32_t n_nodes)
+{
+	uint32_t i, size;
+
+	if (n_nodes <= pool->size)
+		return 0;
+
+	for (size = 64; size < n_nodes; size <<= 1);
+
+	for (i = 0; i < pool->n_workers; i++) {
+		struct worker *w = &pool->workers[i];
+
+		free(w->spare);
+		if ((w->spare = malloc(size * sizeof(struct spa_graph_plan_node *))) == NULL)
+			return -ENOMEM;
+	}
+	pool->spare_size = size;
+	return 0;
+}
+
+/* use the spare queues, no worker is in the push phase so they can't
+ * touch the queues */
+static void pool_use_spare(struct pw_graph_pool *pool)
+{
+	uint32_t i;
+
+	if (pool->spare_size <= pool->size)
+		return;
+
+	for (i = 0; i < pool->n_workers; i++) {
+		struct worker *w = &pool->workers[i];
+		struct queue *q = &w->queue;
+		struct spa_graph_plan_node **items = q->items;
+
+		q->items = w->spare;
+		q->mask = pool->spare_size - 1;
+		q->top = q->bottom = 0;
+		w->spare = items;
+	}
+	pool->size = pool->spare_size;
+	pool->spare_size = 0;
+}
+
+static void pool_free_spare(struct pw_graph_pool *pool)
+{
+	uint32_t i;
+
+	for (i = 0; i < pool->n_workers; i++) {
+		free(pool->workers[i].spare);
+		pool->workers[i].spare = NULL;
+	}
+	pool->spare_size = 0;
+}
+
+static int
+do_check_plan(struct spa_loop *loop,
+	      bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct spa_graph_plan *plan = ((struct pw_graph_pool *) user_data)->plan;
+
+	return !plan->valid || plan->version != plan->graph->version;
+}
+
+static int
+do_swap_plan(struct spa_loop *loop,
+	     bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_graph_pool *pool = user_data;
+
+	/* when the graph changed again, the next cycle asks for a new plan */
+	if (spa_graph_plan_swap(pool->plan, &pool->next) < 0)
+		return 0;
+
+	pool_use_spare(pool);
+	return 0;
+}
+
+/* compile the plan on the main loop and swap it in on the data loop */
+static void compile_plan(void *data, uint64_t count)
+{
+	struct pw_graph_pool *pool = data;
+	struct pw_loop *data_loop = pool->core->data_loop;
+	int res;
+
+	__atomic_store_n(&pool->compile_pending, false, __ATOMIC_RELEASE);
+
+	/* the graph is changed from invokes on the data loop, the ones that
+	 * are queued are done after this so the graph does not change while
+	 * it is compiled */
+	if (pw_loop_invoke(data_loop, do_check_plan, SPA_ID_INVALID, NULL, 0, true, pool) <= 0)
+		return;
+
+	if ((res = spa_graph_plan_compile(&pool->next)) < 0 ||
+	    (res = pool_alloc_spare(pool, pool->next.n_nodes)) < 0) {
+		pw_log_error("graph-pool %p: can't compile plan: %s", pool, spa_strerror(res));
+		return;
+	}
+	pw_log_debug("graph-pool %p: compiled plan of %d nodes", pool, pool->next.n_nodes);
+
+	pw_loop_invoke(data_loop, do_swap_plan, SPA_ID_INVALID, NULL, 0, true, pool);
+
+	/* the spare queues are the old ones now */
+	pool_free_spare(pool);
+}
+
+/* process the nodes that have all their input on all workers */
+static void pool_push_phase(struct pw_graph_pool *pool, uint32_t first_push)
+{
+	struct spa_graph_plan *plan = pool->plan;
+	struct worker *driver = &pool->workers[0];
+	uint32_t i, n_ready = 0;
+
+	if (plan->n_nodes > pool->size) {
+		spa_graph_plan_push(plan, first_push);
+		return;
+	}
+
+	/* queue the marked nodes that already have their input, the workers
+	 * only count the peers they push to */
+	pool->first_push = first_push;
+	while (first_push < plan->n_nodes &&
+	       (i = spa_graph_plan_take_next(plan, SPA_DIRECTION_INPUT, first_push)) !=
+	       SPA_GRAPH_PLAN_NONE) {
+		struct spa_graph_plan_node *pn = &plan->nodes[i];
+
+		if (spa_graph_plan_ready(pn, SPA_DIRECTION_INPUT, SPA_STATUS_HAVE_BUFFER)) {
+			pn->flags |= SPA_GRAPH_PLAN_NODE_QUEUED;
+			queue_push(&driver->queue, pn);
+			n_ready++;
+		}
+		first_push = i + 1;
+	}
+	if (n_ready == 0)
+		return;
+
+	__atomic_store_n(&pool->in_push, true, __ATOMIC_RELEASE);
+	__atomic_store_n(&pool->outstanding, n_ready, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&pool->seq, 1, __ATOMIC_ACQ_REL);
+	futex_wake(&pool->seq, INT32_MAX);
+
+	pool_work(pool, driver);
+
+	/* join the workers */
+	while (__atomic_load_n(&pool->active, __ATOMIC_ACQUIRE) > 0)
+		sched_yield();
+	__atomic_store_n(&pool->in_push, false, __ATOMIC_RELEASE);
+}
+
+/* count the output that other threads delivered during the push phase on
+ * the peers, returns the first node to push to or the number of nodes
+ * when there was none. The workers are not running. */
+static uint32_t pool_take_late(struct pw_graph_pool *pool)
+{
+	struct spa_graph_plan *plan = pool->plan;
+	uint32_t i, first_push = plan->n_nodes;
+
+	if (__atomic_exchange_n(&pool->n_late, 0, __ATOMIC_ACQ_REL) == 0)
+		return first_push;
+
+	for (i = 0; i < plan->n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &plan->nodes[i];
+
+		if (!(__atomic_load_n(&pn->flags, __ATOMIC_ACQUIRE) & SPA_GRAPH_PLAN_NODE_OUTPUT))
+			continue;
+
+		__atomic_and_fetch(&pn->flags, ~SPA_GRAPH_PLAN_NODE_OUTPUT, __ATOMIC_ACQ_REL);
+		spa_graph_plan_push_peers(plan, pn);
+		first_push = SPA_MIN(first_push, pn->index + 1);
+	}
+	return first_push;
+}
+
+/* the parallel version of spa_graph_plan_push(), repeated for the output
+ * that arrived from other threads */
+static void pool_push(struct pw_graph_pool *pool, uint32_t first_push)
+{
+	do {
+		pool_push_phase(pool, first_push);
+		first_push = pool_take_late(pool);
+	} while (first_push < pool->plan->n_nodes);
+}
+
+static int pool_run(struct pw_graph_pool *pool, struct spa_graph_node *node,
+		    enum spa_direction direction)
+{
+	struct spa_graph_plan *plan = pool->plan;
+	uint32_t round = 0, first_push;
+	int res;
+
+	if (plan->running) {
+		struct spa_graph_plan_node *pn;
+
+		if (!__atomic_load_n(&pool->in_push, __ATOMIC_ACQUIRE))
+			return spa_graph_plan_queue(plan, node, direction);
+
+		/* called from a node on one of the workers or from another
+		 * thread during the push phase */
+		if ((pn = spa_graph_plan_find_node(plan, node)) == NULL)
+			return -EINVAL;
+		if (direction == SPA_DIRECTION_INPUT)
+			pool_add_pending(pool, pn);
+		else if (current_worker != NULL)
+			pool_push_peers(pool, current_worker, pn);
+		else
+			pool_add_late(pool, pn);
+		return 0;
+	}
+
+	if (!pool->sched_set)
+		pool_update_sched(pool);
+
+	if ((res = spa_graph_plan_begin(plan, node, direction, &first_push)) < 0) {
+		if (res != -EAGAIN)
+			return res;
+
+		/* the graph changed, run the cycle with the default scheduler
+		 * until the new plan is swapped in */
+		if (!__atomic_exchange_n(&pool->compile_pending, true, __ATOMIC_ACQ_REL))
+			pw_loop_signal_event(pool->core->main_loop, pool->compile_event);
+
+		if (direction == SPA_DIRECTION_INPUT)
+			return spa_graph_impl_need_input(NULL, node);
+		else
+			return spa_graph_impl_have_output(NULL, node);
+	}
+
+	do {
+		first_push = spa_graph_plan_pull(plan, first_push);
+		pool_push(pool, first_push);
+	} while (spa_graph_plan_next_round(plan, round++, &first_push));
+
+	return 0;
+}
+
+static int pool_need_input(void *data, struct spa_graph_node *node)
+{
+	return pool_run(data, node, SPA_DIRECTION_INPUT);
+}
+
+static int pool_have_output(void *data, struct spa_graph_node *node)
+{
+	return pool_run(data, node, SPA_DIRECTION_OUTPUT);
+}
+
+const struct spa_graph_callbacks pw_graph_pool_impl = {
+	SPA_VERSION_GRAPH_CALLBACKS,
+	.need_input = pool_need_input,
+	.have_output = pool_have_output,
+};
+
+/** Create a pool of threads to run the plan of the core
+ * \param core the core with the plan to run
+ * \param n_threads the number of threads, including the thread that
+ *	runs the cycles
+ * \return a new pool or NULL on error
+ *
+ * The callbacks in \ref pw_graph_pool_impl should be set on the graph of
+ * the plan. The nodes that have all their input are then processed in
+ * parallel, while the thread that starts the cycle waits for the
+ * workers at the end of each round.
+ *
+ * When the graph changed, the plan is compiled again on the main loop
+ * and the cycles use the default scheduler until it is swapped in.
+ */
+struct pw_graph_pool *pw_graph_pool_new(struct pw_core *core, uint32_t n_threads)
+{
+	struct spa_graph_plan *plan = &core->rt.plan;
+	struct pw_graph_pool *pool;
+	uint32_t i;
+	int res;
+
+	if (n_threads < 2)
+		return NULL;
+
+	pool = calloc(1, sizeof(struct pw_graph_pool));
+	if (pool == NULL)
+		return NULL;
+
+	pool->core = core;
+	pool->plan = plan;
+	spa_graph_plan_init(&pool->next, plan->graph);
+	pool->n_workers = n_threads;
+	pool->running = true;
+	if (posix_memalign((void **) &pool->workers, CACHE_LINE,
+			   n_threads * sizeof(struct worker)) != 0)
+		goto no_mem;
+
+	memset(pool->workers, 0, n_threads * sizeof(struct worker));
+	for (i = 0; i < n_threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].id = i;
+	}
+	if (pool_alloc_spare(pool, SPA_MAX(plan->max_nodes, 1u)) < 0)
+		goto no_mem;
+	pool_use_spare(pool);
+	pool_free_spare(pool);
+
+	pool->compile_event = pw_loop_add_event(core->main_loop, compile_plan, pool);
+	if (pool->compile_event == NULL)
+		goto no_mem;
+
+	for (i = 1; i < n_threads; i++) {
+		if ((res = pthread_create(&pool->workers[i].thread, NULL,
+					  do_worker, &pool->workers[i])) != 0) {
+			pw_log_error("graph-pool %p: can't create thread: %s", pool, strerror(res));
+			pw_graph_pool_destroy(pool);
+			return NULL;
+		}
+		pool->workers[i].started = true;
+	}
+	pw_log_debug("graph-pool %p: new %d threads", pool, n_threads);
+
+	return pool;
+
+      no_mem:
+	pw_graph_pool_destroy(pool);
+	return NULL;
+}
+
+/** Stop the workers and free the pool
+ * \param pool the pool to destroy
+ *
+ * The pool should not be running a cycle.
+ */
+void pw_graph_pool_destroy(struct pw_graph_pool *pool)
+{
+	uint32_t i;
+
+	pw_log_debug("graph-pool %p: destroy", pool);
+
+	__atomic_store_n(&pool->running, false, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&pool->seq, 1, __ATOMIC_ACQ_REL);
+	futex_wake(&pool->seq, INT32_MAX);
+
+	if (pool->workers) {
+		for (i = 1; i < pool->n_workers; i++) {
+			if (pool->workers[i].started)
+				pthread_join(pool->workers[i].thread, NULL);
+		}
+		for (i = 0; i < pool->n_workers; i++) {
+			free(pool->workers[i].queue.items);
+			free(pool->workers[i].spare);
+		}
+		free(pool->workers);
+	}
+	if (pool->compile_event)
+		pw_loop_destroy_source(pool->core->main_loop, pool->compile_event);
+	spa_graph_plan_clear(&pool->next);
+	free(pool);
+}
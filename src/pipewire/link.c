@@ -38,6 +38,9 @@
 
 #define MAX_BUFFERS     16
 
+#define CACHE_LINE	PW_BUFFER_CACHE_LINE
+#define MAX_ALIGN	4096
+
 /** \cond */
 struct impl {
 	struct pw_link this;
@@ -313,6 +316,12 @@ static struct spa_pod *find_param(struct spa_pod **params, uint32_t n_params, ui
  *
  * The shared memory block should not contain any types or structure,
  * just the actual metadata contents.
+ *
+ * The metadata and the chunks start on their own cache line so that
+ * they don't share a cache line with the data. The data blocks and
+ * the buffers are aligned to \a data_align, which is at least a cache
+ * line. The clients find the metadata and chunks with the same
+ * pw_buffer_chunk_offset() helper.
  */
 static int alloc_buffers(struct pw_link *this,
 			 uint32_t n_buffers,
@@ -321,24 +330,30 @@ static int alloc_buffers(struct pw_link *this,
 			 uint32_t n_datas,
 			 size_t *data_sizes,
 			 ssize_t *data_strides,
+			 uint32_t data_align,
 			 struct allocation *allocation)
 {
 	int res;
 	struct spa_buffer **buffers, *bp;
 	uint32_t i;
-	size_t skel_size, data_size, meta_size;
-	struct spa_chunk *cdp;
-	void *ddp;
+	size_t skel_size, data_size, chunk_offset, *data_offsets;
 	uint32_t n_metas;
 	struct spa_meta *metas;
 	struct pw_memblock *m;
 	struct pw_type *t = &this->core->type;
 
-	n_metas = data_size = meta_size = 0;
+	n_metas = data_size = 0;
 
 	skel_size = sizeof(struct spa_buffer);
 
 	metas = alloca(sizeof(struct spa_meta) * n_params);
+	data_offsets = alloca(sizeof(size_t) * n_datas);
+
+	/* the alignment must be a power of two and the mapping is only
+	 * page aligned */
+	data_align = SPA_CLAMP(data_align, CACHE_LINE, MAX_ALIGN);
+	if ((data_align & (data_align - 1)) != 0)
+		data_align = CACHE_LINE;
 
 	/* collect metadata */
 	for (i = 0; i < n_params; i++) {
@@ -354,19 +369,24 @@ static int alloc_buffers(struct pw_link *this,
 
 			metas[n_metas].type = type;
 			metas[n_metas].size = size;
-			meta_size += metas[n_metas].size;
 			n_metas++;
 			skel_size += sizeof(struct spa_meta);
 		}
 	}
-	data_size += meta_size;
+	/* the metas and chunks are laid out like the clients expect them */
+	chunk_offset = pw_buffer_chunk_offset(metas, n_metas);
+	data_size = pw_buffer_header_size(metas, n_metas, n_datas);
 
 	/* data */
 	for (i = 0; i < n_datas; i++) {
-		data_size += sizeof(struct spa_chunk);
+		if (data_sizes[i] > 0)
+			data_size = SPA_ROUND_UP_N(data_size, data_align);
+		data_offsets[i] = data_size;
 		data_size += data_sizes[i];
 		skel_size += sizeof(struct spa_data);
 	}
+	/* make the next buffer start aligned as well */
+	data_size = SPA_ROUND_UP_N(data_size, data_align);
 
 	buffers = calloc(n_buffers, skel_size + sizeof(struct spa_buffer *));
 	/* pointer to buffer structures */
@@ -380,6 +400,7 @@ static int alloc_buffers(struct pw_link *this,
 	for (i = 0; i < n_buffers; i++) {
 		int j;
 		struct spa_buffer *b;
+		struct spa_chunk *cdp;
 		void *p;
 
 		buffers[i] = b = SPA_MEMBER(bp, skel_size * i, struct spa_buffer);
@@ -390,19 +411,18 @@ static int alloc_buffers(struct pw_link *this,
 		b->n_metas = n_metas;
 		b->metas = SPA_MEMBER(b, sizeof(struct spa_buffer), struct spa_meta);
 		for (j = 0; j < n_metas; j++) {
-			struct spa_meta *m = &b->metas[j];
+			struct spa_meta *meta = &b->metas[j];
 
-			m->type = metas[j].type;
-			m->size = metas[j].size;
-			m->data = p;
-			p += m->size;
+			meta->type = metas[j].type;
+			meta->size = metas[j].size;
+			meta->data = p;
+			p += pw_buffer_meta_size(meta->size);
 		}
 		/* pointer to data structure */
 		b->n_datas = n_datas;
 		b->datas = SPA_MEMBER(b->metas, n_metas * sizeof(struct spa_meta), struct spa_data);
 
-		cdp = p;
-		ddp = SPA_MEMBER(cdp, sizeof(struct spa_chunk) * n_datas, void);
+		cdp = SPA_MEMBER(m->ptr, data_size * i + chunk_offset, struct spa_chunk);
 
 		for (j = 0; j < n_datas; j++) {
 			struct spa_data *d = &b->datas[j];
@@ -412,13 +432,12 @@ static int alloc_buffers(struct pw_link *this,
 				d->type = t->data.MemFd;
 				d->flags = 0;
 				d->fd = m->fd;
-				d->mapoffset = SPA_PTRDIFF(ddp, m->ptr);
+				d->mapoffset = data_size * i + data_offsets[j];
 				d->maxsize = data_sizes[j];
 				d->data = SPA_MEMBER(m->ptr, d->mapoffset, void);
 				d->chunk->offset = 0;
 				d->chunk->size = 0;
 				d->chunk->stride = data_strides[j];
-				ddp += data_sizes[j];
 			} else {
 				/* needs to be allocated by a node */
 				d->type = SPA_ID_INVALID;
@@ -581,7 +600,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		uint8_t buffer[4096];
 		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
 		uint32_t i, offset, n_params;
-		uint32_t max_buffers;
+		uint32_t max_buffers, align;
 		size_t minsize = 1024, stride = 0;
 		size_t data_sizes[1];
 		ssize_t data_strides[1];
@@ -601,24 +620,27 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 
 		max_buffers = MAX_BUFFERS;
 		minsize = stride = 0;
+		align = CACHE_LINE;
 		param = find_param(params, n_params, t->param_buffers.Buffers);
 		if (param) {
 			uint32_t qmax_buffers = max_buffers,
-			    qminsize = minsize, qstride = stride;
+			    qminsize = minsize, qstride = stride, qalign = align;
 
 			spa_pod_object_parse(param,
 				":", t->param_buffers.size, "i", &qminsize,
 				":", t->param_buffers.stride, "i", &qstride,
-				":", t->param_buffers.buffers, "i", &qmax_buffers, NULL);
+				":", t->param_buffers.buffers, "i", &qmax_buffers,
+				":", t->param_buffers.align, "?i", &qalign, NULL);
 
 			max_buffers =
 			    qmax_buffers == 0 ? max_buffers : SPA_MIN(qmax_buffers,
 							      max_buffers);
 			minsize = SPA_MAX(minsize, qminsize);
 			stride = SPA_MAX(stride, qstride);
+			align = SPA_MAX(align, qalign);
 
-			pw_log_debug("%d %d %d -> %zd %zd %d", qminsize, qstride, qmax_buffers,
-				     minsize, stride, max_buffers);
+			pw_log_debug("%d %d %d %d -> %zd %zd %d %d", qminsize, qstride, qmax_buffers,
+				     qalign, minsize, stride, max_buffers, align);
 		} else {
 			pw_log_warn("no buffers param");
 			minsize = 1024;
@@ -639,6 +661,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 					 params,
 					 1,
 					 data_sizes, data_strides,
+					 align,
 					 &allocation)) < 0) {
 			asprintf(&error, "error alloc buffers: %d", res);
 			goto error;
@@ -725,6 +748,7 @@ do_activate_link(struct spa_loop *loop,
         struct pw_link *this = user_data;
 	SPA_FLAG_UNSET(this->rt.out_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
 	SPA_FLAG_UNSET(this->rt.in_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
+	spa_graph_node_changed(this->rt.out_port.node);
 	return 0;
 }
 
@@ -960,6 +984,7 @@ do_deactivate_link(struct spa_loop *loop,
 	pw_log_trace("link %p: disable %p and %p", this, &this->rt.out_port, &this->rt.in_port);
 	SPA_FLAG_SET(this->rt.out_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
 	SPA_FLAG_SET(this->rt.in_port.flags, SPA_GRAPH_PORT_FLAG_DISABLED);
+	spa_graph_node_changed(this->rt.out_port.node);
 	return 0;
 }
 
@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/type-map.h>
@@ -51,6 +52,9 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 	void *iface;
 	const struct spa_support *support;
 	uint32_t n_support;
+	struct spa_dict_item items[1];
+	struct spa_dict info = SPA_DICT_INIT(items, 0);
+	const char *str;
 
 	support = pw_get_support(&n_support);
 	if (support == NULL)
@@ -72,9 +76,15 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 
 	this = &impl->this;
 
+	/* the loop.backend property selects epoll or io_uring */
+	if ((str = getenv("PIPEWIRE_LOOP_BACKEND")) == NULL && properties)
+		str = pw_properties_get(properties, "loop.backend");
+	if (str)
+		items[info.n_items++] = SPA_DICT_ITEM_INIT("loop.backend", str);
+
 	if ((res = spa_handle_factory_init(factory,
 					   impl->handle,
-					   NULL,
+					   &info,
 					   support,
 					   n_support)) < 0) {
 		fprintf(stderr, "can't make factory instance: %d\n", res);
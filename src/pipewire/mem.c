@@ -31,6 +31,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <sys/syscall.h>
 
 #include <spa/utils/list.h>
@@ -86,6 +87,79 @@ struct memblock {
 
 static struct spa_list _memblocks = SPA_LIST_INIT(&_memblocks);
 
+/* the mapped memblocks, sorted on their address so that we can find the
+ * memblock of a pointer with a binary search */
+static struct {
+	pthread_rwlock_t lock;
+	struct memblock **blocks;
+	uint32_t n_blocks;
+	uint32_t max_blocks;
+} _index = { PTHREAD_RWLOCK_INITIALIZER, };
+
+/* find the position of the last block that starts at or before ptr,
+ * -1 when ptr is before all blocks. Must be called with the lock. */
+static int index_search(const void *ptr)
+{
+	int lo = 0, hi = (int) _index.n_blocks - 1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if ((const void *) _index.blocks[mid]->mem.ptr <= ptr)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return hi;
+}
+
+static int index_add(struct memblock *m)
+{
+	int pos, res = 0;
+
+	if (m->mem.ptr == NULL || m->mem.size == 0)
+		return 0;
+
+	pthread_rwlock_wrlock(&_index.lock);
+	if (_index.n_blocks == _index.max_blocks) {
+		uint32_t max_blocks = _index.max_blocks ? _index.max_blocks * 2 : 64;
+		struct memblock **blocks;
+
+		blocks = realloc(_index.blocks, max_blocks * sizeof(struct memblock *));
+		if (blocks == NULL) {
+			res = -ENOMEM;
+			goto done;
+		}
+		_index.blocks = blocks;
+		_index.max_blocks = max_blocks;
+	}
+	pos = index_search(m->mem.ptr) + 1;
+	memmove(&_index.blocks[pos + 1], &_index.blocks[pos],
+		(_index.n_blocks - pos) * sizeof(struct memblock *));
+	_index.blocks[pos] = m;
+	_index.n_blocks++;
+      done:
+	pthread_rwlock_unlock(&_index.lock);
+	return res;
+}
+
+static void index_remove(struct memblock *m)
+{
+	int pos;
+
+	if (m->mem.ptr == NULL || m->mem.size == 0)
+		return;
+
+	pthread_rwlock_wrlock(&_index.lock);
+	pos = index_search(m->mem.ptr);
+	/* blocks of size 0 are not indexed so the address is unique */
+	if (pos >= 0 && _index.blocks[pos] == m) {
+		_index.n_blocks--;
+		memmove(&_index.blocks[pos], &_index.blocks[pos + 1],
+			(_index.n_blocks - pos) * sizeof(struct memblock *));
+	}
+	pthread_rwlock_unlock(&_index.lock);
+}
+
 #define USE_MEMFD
 
 /** Map a memblock
@@ -154,6 +228,7 @@ int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_membl
 	struct memblock tmp, *p;
 	struct pw_memblock *m;
 	bool use_fd;
+	int res;
 
 	if (mem == NULL)
 		return -EINVAL;
@@ -214,6 +289,10 @@ int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_membl
 	p = calloc(1, sizeof(struct memblock));
 	*p = tmp;
 	spa_list_append(&_memblocks, &p->link);
+	if ((res = index_add(p)) < 0) {
+		pw_memblock_free(&p->mem);
+		return res;
+	}
 	*mem = &p->mem;
 	pw_log_debug("mem %p: alloc", *mem);
 
@@ -241,7 +320,22 @@ pw_memblock_import(enum pw_memblock_flags flags,
 
 	pw_log_debug("mem %p: import", *mem);
 
-	return pw_memblock_map(*mem);
+	if ((res = pw_memblock_map(*mem)) < 0) {
+		/* nothing is mapped when the map failed */
+		(*mem)->ptr = NULL;
+		goto error;
+	}
+	if ((res = index_add((struct memblock *) *mem)) < 0)
+		goto error;
+
+	return 0;
+
+      error:
+	/* the fd remains owned by the caller on failure */
+	(*mem)->fd = -1;
+	pw_memblock_free(*mem);
+	*mem = NULL;
+	return res;
 }
 
 /** Free a memblock
@@ -256,6 +350,7 @@ void pw_memblock_free(struct pw_memblock *mem)
 		return;
 
 	pw_log_debug("mem %p: free", mem);
+	index_remove(m);
 	if (mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) {
 		if (mem->ptr)
 			munmap(mem->ptr, mem->size);
@@ -268,13 +363,26 @@ void pw_memblock_free(struct pw_memblock *mem)
 	free(mem);
 }
 
+/** Find the memblock that contains a pointer
+ * \param ptr a pointer to mapped memory
+ * \return the memblock of \a ptr or NULL when not found
+ * \memberof pw_memblock
+ *
+ * This can be called from any thread.
+ */
 struct pw_memblock * pw_memblock_find(const void *ptr)
 {
-	struct memblock *m;
-
-	spa_list_for_each(m, &_memblocks, link) {
-		if (ptr >= m->mem.ptr && ptr < m->mem.ptr + m->mem.size)
-			return &m->mem;
+	struct pw_memblock *res = NULL;
+	int pos;
+
+	pthread_rwlock_rdlock(&_index.lock);
+	pos = index_search(ptr);
+	if (pos >= 0) {
+		struct pw_memblock *m = &_index.blocks[pos]->mem;
+		if (ptr < m->ptr + m->size)
+			res = m;
 	}
-	return NULL;
+	pthread_rwlock_unlock(&_index.lock);
+
+	return res;
 }
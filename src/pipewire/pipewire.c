@@ -108,7 +108,8 @@ static const struct spa_handle_factory *get_factory(struct support_info *info, c
 static struct interface *
 load_interface(struct support_info *info,
 	       const char *factory_name,
-	       const char *type)
+	       const char *type,
+	       const struct spa_dict *props)
 {
         int res;
         struct spa_handle *handle;
@@ -124,7 +125,7 @@ load_interface(struct support_info *info,
 
         handle = calloc(1, factory->size);
         if ((res = spa_handle_factory_init(factory,
-                                           handle, NULL, info->support, info->n_support)) < 0) {
+                                           handle, props, info->support, info->n_support)) < 0) {
                 fprintf(stderr, "can't make factory instance: %d\n", res);
                 goto init_failed;
         }
@@ -212,7 +213,7 @@ void *pw_get_spa_dbus(struct pw_loop *loop)
 		str = PLUGINDIR;
 
 	if (open_support(str, "support/libspa-dbus", &dbus_support_info)) {
-		iface = load_interface(&dbus_support_info, "dbus", SPA_TYPE__DBus);
+		iface = load_interface(&dbus_support_info, "dbus", SPA_TYPE__DBus, NULL);
 		if (iface != NULL)
 			return iface->iface;
 	}
@@ -228,11 +229,11 @@ static struct interface *find_interface(void *iface)
 	return NULL;
 }
 
-int pw_release_spa_dbus(void *dbus)
+static int release_interface(void *ptr)
 {
 	struct interface *iface;
 
-	if ((iface = find_interface(dbus)) == NULL)
+	if ((iface = find_interface(ptr)) == NULL)
 		return -ENOENT;
 
 	spa_list_remove(&iface->link);
@@ -242,6 +243,47 @@ int pw_release_spa_dbus(void *dbus)
 	return 0;
 }
 
+int pw_release_spa_dbus(void *dbus)
+{
+	return release_interface(dbus);
+}
+
+/** Get a logger for a main loop
+ * \param loop the main loop
+ * \return a new spa_log or NULL when the default logger should be used
+ *
+ * The logger formats the trace messages of the realtime threads in \a loop.
+ * It is only made when the environment variable
+ * \a PIPEWIRE_LOG_BINARY_TRACE is set, the logger then stores the raw
+ * arguments of trace messages when it is `1`.
+ */
+void *pw_get_spa_log(struct pw_loop *loop)
+{
+	struct support_info log_support_info;
+	struct spa_dict_item items[1];
+	struct interface *iface;
+	const char *str;
+
+	if ((str = getenv("PIPEWIRE_LOG_BINARY_TRACE")) == NULL ||
+	    support_info.n_support == 0)
+		return NULL;
+
+	log_support_info = support_info;
+	log_support_info.support[log_support_info.n_support++] =
+			SPA_SUPPORT_INIT(SPA_TYPE_LOOP__MainLoop, loop->loop);
+
+	items[0] = SPA_DICT_ITEM_INIT("log.binary-trace", str);
+
+	iface = load_interface(&log_support_info, "logger", SPA_TYPE__Log,
+			       &SPA_DICT_INIT(items, 1));
+	return iface ? iface->iface : NULL;
+}
+
+int pw_release_spa_log(void *log)
+{
+	return release_interface(log);
+}
+
 /** Initialize PipeWire
  *
  * \param argc pointer to argc
@@ -272,11 +314,11 @@ void pw_init(int *argc, char **argv[])
 	spa_list_init(&global_registry.interfaces);
 
 	if (open_support(str, "support/libspa-support", info)) {
-		iface = load_interface(info, "mapper", SPA_TYPE__TypeMap);
+		iface = load_interface(info, "mapper", SPA_TYPE__TypeMap, NULL);
 		if (iface != NULL)
 			info->support[info->n_support++] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, iface->iface);
 
-		iface = load_interface(info, "logger", SPA_TYPE__Log);
+		iface = load_interface(info, "logger", SPA_TYPE__Log, NULL);
 		if (iface != NULL) {
 			info->support[info->n_support++] = SPA_SUPPORT_INIT(SPA_TYPE__Log, iface->iface);
 			pw_log_set(iface->iface);
@@ -94,6 +94,10 @@ extern "C" {
  * - &lt;category&gt;:  Specifies a string category to enable. Many categories
  *		  can be separated by commas. Current categories are:
  *   + `connection`: to log connection messages
+ *
+ * When 'PIPEWIRE_LOG_BINARY_TRACE' is set to `1`, the trace messages of the
+ * realtime threads of a \ref pw_core are stored with their raw arguments and
+ * only formatted later in the main loop of the core.
  */
 
 /** \class pw_pipewire
@@ -136,6 +140,9 @@ pw_get_support_interface(const char *type);
 void *pw_get_spa_dbus(struct pw_loop *loop);
 int pw_release_spa_dbus(void *dbus);
 
+void *pw_get_spa_log(struct pw_loop *loop);
+int pw_release_spa_log(void *log);
+
 const struct spa_handle_factory *
 pw_get_support_factory(const char *factory_name);
 
@@ -31,12 +31,42 @@ extern "C" {
 #include "pipewire/mem.h"
 #include "pipewire/pipewire.h"
 #include "pipewire/introspect.h"
+#include "pipewire/data-loop.h"
 
 #ifndef spa_debug
 #define spa_debug pw_log_trace
 #endif
 
 #include <spa/graph/graph.h>
+#include <spa/graph/graph-scheduler7.h>
+
+/** \cond */
+/* Layout of the metadata and chunks at the start of a shared buffer. The
+ * metas are padded to 8 bytes and the chunks start on their own cache line,
+ * all users of the memory must agree on this. */
+#define PW_BUFFER_CACHE_LINE	64
+
+static inline size_t pw_buffer_meta_size(uint32_t size)
+{
+	return SPA_ROUND_UP_N(size, 8);
+}
+
+static inline size_t pw_buffer_chunk_offset(const struct spa_meta *metas, uint32_t n_metas)
+{
+	size_t size = 0;
+	uint32_t i;
+	for (i = 0; i < n_metas; i++)
+		size += pw_buffer_meta_size(metas[i].size);
+	return SPA_ROUND_UP_N(size, PW_BUFFER_CACHE_LINE);
+}
+
+static inline size_t pw_buffer_header_size(const struct spa_meta *metas, uint32_t n_metas,
+					   uint32_t n_datas)
+{
+	return pw_buffer_chunk_offset(metas, n_metas) +
+		SPA_ROUND_UP_N(sizeof(struct spa_chunk) * n_datas, PW_BUFFER_CACHE_LINE);
+}
+/** \endcond */
 
 struct pw_command;
 
@@ -107,6 +137,7 @@ struct pw_client {
 	struct pw_map objects;		/**< list of resource objects */
 	uint32_t n_types;		/**< number of client types */
 	struct pw_map types;		/**< map of client types */
+	bool types_identity;		/**< client types use the same ids */
 
 	struct spa_list resource_list;	/**< The list of resources of this client */
 
@@ -184,6 +215,8 @@ struct pw_core {
         struct pw_data_loop *data_loop_impl;
 
 	void *dbus_iface;
+	struct spa_log *log_iface;	/**< logger of the main loop, when enabled */
+	struct spa_log *old_log;	/**< global logger before the core was made */
 
 	struct spa_support support[16];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
@@ -194,6 +227,8 @@ struct pw_core {
 
 	struct {
 		struct spa_graph graph;
+		struct spa_graph_plan plan;
+		struct pw_graph_pool *pool;	/**< workers for the plan or NULL */
 	} rt;
 };
 
@@ -209,6 +244,9 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+
+	uint64_t busy_poll;		/**< max time to spin before sleeping */
+	struct pw_data_loop_stats stats;
 };
 
 #define pw_main_loop_events_emit(o,m,v,...) spa_hook_list_call(&o->listener_list, struct pw_main_loop_events, m, v, ##__VA_ARGS__)
@@ -479,6 +517,8 @@ struct pw_remote {
 
 	uint32_t n_types;			/**< number of client types */
 	struct pw_map types;			/**< client types */
+	bool types_identity;			/**< remote types use the same ids */
+	bool types_pending;			/**< waiting for the types after hello */
 
 	struct spa_list proxy_list;		/**< list of \ref pw_proxy objects */
 	struct spa_list stream_list;		/**< list of \ref pw_stream objects */
@@ -680,6 +720,16 @@ pw_control_new(struct pw_core *core,
 
 void pw_control_destroy(struct pw_control *control);
 
+/** A pool of threads that runs the independent branches of a graph plan */
+struct pw_graph_pool;
+
+/** graph callbacks that run the plan on the pool */
+extern const struct spa_graph_callbacks pw_graph_pool_impl;
+
+struct pw_graph_pool *pw_graph_pool_new(struct pw_core *core, uint32_t n_threads);
+
+void pw_graph_pool_destroy(struct pw_graph_pool *pool);
+
 /** \endcond */
 
 #ifdef __cplusplus
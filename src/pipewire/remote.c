@@ -197,6 +197,8 @@ core_event_update_types(void *data, uint32_t first_id, const char **types, uint3
 		uint32_t this_id = spa_type_map_get_id(this->core->type.map, types[i]);
 		if (!pw_map_insert_at(&this->types, first_id, PW_MAP_ID_TO_PTR(this_id)))
 			pw_log_error("can't add type for client");
+		if (this_id != first_id)
+			this->types_identity = false;
 	}
 }
 
@@ -450,6 +452,8 @@ int pw_remote_disconnect(struct pw_remote *remote)
 	pw_map_clear(&remote->objects);
 	pw_map_clear(&remote->types);
 	remote->n_types = 0;
+	remote->types_identity = false;
+	remote->types_pending = false;
 
 	if (remote->info) {
 		pw_core_info_free (remote->info);
@@ -544,11 +548,13 @@ on_rtsocket_condition(void *user_data, int fd, enum spa_io mask)
 			pw_log_warn("proxy %p: %ld messages", proxy, cmd);
 
 
-		while (pw_client_node_transport_next_message(data->trans, &message) == 1) {
-			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
-			pw_client_node_transport_parse_message(data->trans, msg);
-			handle_rtnode_message(proxy, msg);
-		}
+		do {
+			while (pw_client_node_transport_next_message(data->trans, &message) == 1) {
+				struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
+				pw_client_node_transport_parse_message(data->trans, msg);
+				handle_rtnode_message(proxy, msg);
+			}
+		} while (pw_client_node_transport_idle(data->trans));
 	}
 }
 
@@ -838,22 +844,32 @@ static void client_node_event(void *object, const struct spa_event *event)
 }
 
 
+/* wake up the server, unless it was already woken up for earlier messages */
+static void do_flush(struct node_data *d)
+{
+	uint64_t cmd = 1;
+
+	if (!pw_client_node_transport_signal(d->trans))
+		return;
+
+	if (write(d->rtwritefd, &cmd, 8) != 8)
+		pw_log_warn("remote-node %p: write failed %m", d);
+}
+
 static void node_need_input(void *data)
 {
 	struct node_data *d = data;
-        uint64_t cmd = 1;
 	pw_client_node_transport_add_message(d->trans,
 				&PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_NEED_INPUT));
-        write(d->rtwritefd, &cmd, 8);
+	do_flush(d);
 }
 
 static void node_have_output(void *data)
 {
 	struct node_data *d = data;
-        uint64_t cmd = 1;
         pw_client_node_transport_add_message(d->trans,
                                &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
-        write(d->rtwritefd, &cmd, 8);
+	do_flush(d);
 }
 
 static void client_node_command(void *object, uint32_t seq, const struct spa_command *command)
@@ -1081,8 +1097,9 @@ client_node_port_use_buffers(void *object,
 			struct spa_meta *m = &b->metas[j];
 			memcpy(m, &buffers[i].buffer->metas[j], sizeof(struct spa_meta));
 			m->data = SPA_MEMBER(bid->ptr, offset, void);
-			offset += m->size;
+			offset += pw_buffer_meta_size(m->size);
 		}
+		offset = bid->map.start + pw_buffer_chunk_offset(b->metas, b->n_metas);
 
 		for (j = 0; j < b->n_datas; j++) {
 			struct spa_data *d = &b->datas[j];
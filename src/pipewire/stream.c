@@ -70,6 +70,13 @@ struct queue {
 	uint64_t outcount;
 };
 
+struct peer {
+	struct pw_memblock *mem;		/**< memory of the peer area */
+	struct pw_client_node_peer_area *area;	/**< area shared with the peer */
+	int writefd;				/**< fd to wake up the peer */
+	uint32_t port_id;			/**< port id of the peer */
+};
+
 struct stream {
 	struct pw_stream this;
 
@@ -99,6 +106,7 @@ struct stream {
 	struct spa_hook proxy_listener;
 
 	struct pw_client_node_transport *trans;
+	struct peer peer;
 
 	struct spa_source *timeout_source;
 
@@ -398,6 +406,8 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 	this->name = strdup(name);
 	impl->type_client_node = spa_type_map_get_id(remote->core->type.map, PW_TYPE_INTERFACE__ClientNode);
 	impl->rtwritefd = -1;
+	impl->peer.writefd = -1;
+	impl->peer.port_id = SPA_ID_INVALID;
 
 	str = pw_properties_get(props, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
@@ -597,37 +607,87 @@ static void add_port_update(struct pw_stream *stream, uint32_t change_mask)
 					 &impl->port_info);
 }
 
+/* wake up the server, unless it was already woken up for earlier messages */
+static inline void do_flush(struct stream *impl)
+{
+	uint64_t cmd = 1;
+
+	if (!pw_client_node_transport_signal(impl->trans))
+		return;
+
+	if (write(impl->rtwritefd, &cmd, 8) != 8)
+		pw_log_warn("stream %p: write failed %m", impl);
+}
+
 static inline void send_need_input(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint64_t cmd = 1;
 
 	pw_log_trace("send");
 	pw_client_node_transport_add_message(impl->trans,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_NEED_INPUT));
-	write(impl->rtwritefd, &cmd, 8);
+	do_flush(impl);
+}
+
+/* place the output buffer on the input of the peer and wake it up, the peer
+ * does not have to wait for the server to schedule it */
+static inline void trigger_peer(struct stream *impl)
+{
+	struct spa_io_buffers *io, *pio;
+	struct buffer *b;
+	uint64_t cmd = 1;
+
+	if (impl->peer.writefd == -1)
+		return;
+
+	io = &impl->trans->outputs[impl->port_id];
+	pio = &impl->peer.area->io;
+
+	if (io->status != SPA_STATUS_HAVE_BUFFER)
+		return;
+
+	/* the peer did not consume the previous buffer yet. The server does not
+	 * deliver the buffers of a direct link either, so drop this one and
+	 * recycle it instead of overwriting the buffer of the peer */
+	if (__atomic_load_n(&pio->status, __ATOMIC_ACQUIRE) == SPA_STATUS_HAVE_BUFFER) {
+		pw_log_trace("stream %p: peer busy, recycle %d", impl, io->buffer_id);
+		if ((b = get_buffer(&impl->this, io->buffer_id)) != NULL)
+			push_queue(impl, &impl->dequeue, b);
+		io->buffer_id = SPA_ID_INVALID;
+		io->status = SPA_STATUS_NEED_BUFFER;
+		return;
+	}
+
+	pio->buffer_id = io->buffer_id;
+	__atomic_store_n(&pio->status, SPA_STATUS_HAVE_BUFFER, __ATOMIC_RELEASE);
+
+	if (!pw_client_node_peer_trigger(impl->peer.area))
+		return;
+
+	if (write(impl->peer.writefd, &cmd, 8) != 8)
+		pw_log_warn("stream %p: write failed %m", impl);
 }
 
 static inline void send_have_output(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint64_t cmd = 1;
+
+	trigger_peer(impl);
 
 	pw_log_trace("send");
 	pw_client_node_transport_add_message(impl->trans,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
-	write(impl->rtwritefd, &cmd, 8);
+	do_flush(impl);
 }
 
 static inline void send_reuse_buffer(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint64_t cmd = 1;
 
 	pw_log_trace("send");
 	pw_client_node_transport_add_message(impl->trans, (struct pw_client_node_message*)
 			       &PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER_INIT(impl->port_id, id));
-	write(impl->rtwritefd, &cmd, 8);
+	do_flush(impl);
 }
 
 static void add_async_complete(struct pw_stream *stream, uint32_t seq, int res)
@@ -684,19 +744,27 @@ static inline void reuse_buffer(struct pw_stream *stream, uint32_t id)
 	}
 }
 
+/* the io of an input port that a peer triggers directly is in the peer area */
+static inline struct spa_io_buffers *get_input_io(struct stream *impl, uint32_t port_id)
+{
+	if (impl->peer.area && port_id == impl->port_id)
+		return &impl->peer.area->io;
+	return &impl->trans->inputs[port_id];
+}
+
 static int process_input(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
 	int i;
 
 	for (i = 0; i < impl->trans->area->n_input_ports; i++) {
-		struct spa_io_buffers *input = &impl->trans->inputs[i];
+		struct spa_io_buffers *input = get_input_io(impl, i);
 		struct buffer *b;
 		uint32_t buffer_id;
 		int status;
 
+		status = __atomic_load_n(&input->status, __ATOMIC_ACQUIRE);
 		buffer_id = input->buffer_id;
-		status = input->status;
 
 		pw_log_trace("stream %p: process input %d %d", stream, status,
 			     buffer_id);
@@ -713,8 +781,13 @@ static int process_input(struct pw_stream *stream)
 	      done:
 		/* pop buffer to recycle if we can */
 		b = pop_queue(impl, &impl->queue);
+		if (b && impl->peer.port_id != SPA_ID_INVALID) {
+			/* the server does not see our io when a peer triggers us */
+			send_reuse_buffer(stream, b->id);
+			b = NULL;
+		}
 		input->buffer_id = b ? b->id : SPA_ID_INVALID;
-		input->status = SPA_STATUS_NEED_BUFFER;
+		__atomic_store_n(&input->status, SPA_STATUS_NEED_BUFFER, __ATOMIC_RELEASE);
 
 		pw_log_trace("stream %p: reuse %d", stream, input->buffer_id);
 	}
@@ -820,11 +893,19 @@ on_rtsocket_condition(void *data, int fd, enum spa_io mask)
 		if (read(fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
 			pw_log_warn("stream %p: read failed %m", impl);
 
-		while (pw_client_node_transport_next_message(impl->trans, &message) == 1) {
-			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
-			pw_client_node_transport_parse_message(impl->trans, msg);
-			handle_rtnode_message(stream, msg);
-		}
+		do {
+			while (pw_client_node_transport_next_message(impl->trans, &message) == 1) {
+				struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
+				pw_client_node_transport_parse_message(impl->trans, msg);
+				handle_rtnode_message(stream, msg);
+			}
+			if (impl->direction == SPA_DIRECTION_INPUT && impl->peer.area &&
+			    pw_client_node_peer_take_trigger(impl->peer.area) > 0 &&
+			    process_input(stream) == SPA_STATUS_NEED_BUFFER)
+				send_need_input(stream);
+		} while (pw_client_node_transport_idle(impl->trans) ||
+			 (impl->direction == SPA_DIRECTION_INPUT && impl->peer.area &&
+			  pw_client_node_peer_idle(impl->peer.area)));
 	}
 }
 
@@ -890,7 +971,7 @@ static void client_node_command(void *data, uint32_t seq, const struct spa_comma
 
 			if (impl->direction == SPA_DIRECTION_INPUT) {
 				for (i = 0; i < impl->trans->area->max_input_ports; i++)
-					impl->trans->inputs[i].status = SPA_STATUS_NEED_BUFFER;
+					get_input_io(impl, i)->status = SPA_STATUS_NEED_BUFFER;
 				send_need_input(stream);
 			}
 			else {
@@ -1079,8 +1160,9 @@ client_node_port_use_buffers(void *data,
 			struct spa_meta *m = &b->metas[j];
 			memcpy(m, &buffers[i].buffer->metas[j], sizeof(struct spa_meta));
 			m->data = SPA_MEMBER(bid->ptr, offset, void);
-			offset += m->size;
+			offset += pw_buffer_meta_size(m->size);
 		}
+		offset = bid->map.start + pw_buffer_chunk_offset(b->metas, b->n_metas);
 
 		for (j = 0; j < b->n_datas; j++) {
 			struct spa_data *d = &b->datas[j];
@@ -1205,6 +1287,86 @@ static void client_node_port_set_io(void *data,
 	add_async_complete(stream, seq, res);
 }
 
+static int
+do_set_peer(struct spa_loop *loop,
+	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct stream *impl = user_data;
+	impl->peer = *(const struct peer *) data;
+	return 0;
+}
+
+static void set_peer(struct stream *impl, struct peer *peer)
+{
+	struct pw_stream *stream = &impl->this;
+	struct peer old = impl->peer;
+
+	pw_loop_invoke(stream->remote->core->data_loop,
+		       do_set_peer, 1, peer, sizeof(struct peer), true, impl);
+
+	if (old.mem)
+		pw_memblock_free(old.mem);
+	if (old.writefd != -1)
+		close(old.writefd);
+}
+
+static void client_node_port_set_peer(void *data,
+				      enum spa_direction direction,
+				      uint32_t port_id,
+				      uint32_t peer_port_id,
+				      int writefd,
+				      int memfd,
+				      uint32_t offset,
+				      uint32_t size)
+{
+	struct stream *impl = data;
+	struct peer peer = { NULL, NULL, -1, SPA_ID_INVALID };
+	int res;
+
+	/* only the producer wakes up its peer */
+	if (direction == SPA_DIRECTION_OUTPUT) {
+		peer.writefd = writefd;
+		writefd = -1;
+	}
+	if (memfd == -1)
+		goto done;
+
+	if (direction != impl->direction || port_id != impl->port_id ||
+	    peer_port_id == SPA_ID_INVALID ||
+	    (direction == SPA_DIRECTION_OUTPUT && peer.writefd == -1) ||
+	    size < sizeof(struct pw_client_node_peer_area)) {
+		pw_log_warn("stream %p: invalid peer for port %d:%d", impl, direction, port_id);
+		goto error;
+	}
+	if ((res = pw_memblock_import(PW_MEMBLOCK_FLAG_MAP_READWRITE |
+				      PW_MEMBLOCK_FLAG_WITH_FD,
+				      memfd, offset, size, &peer.mem)) < 0) {
+		pw_log_warn("stream %p: failed to map peer area: %s", impl, spa_strerror(res));
+		goto error;
+	}
+	peer.area = peer.mem->ptr;
+	peer.port_id = peer_port_id;
+
+      done:
+	if (peer.area == NULL && peer.writefd != -1) {
+		close(peer.writefd);
+		peer.writefd = -1;
+	}
+	if (writefd != -1)
+		close(writefd);
+
+	pw_log_debug("stream %p: port %d:%d peer %d", impl, direction, port_id, peer.port_id);
+
+	set_peer(impl, &peer);
+	return;
+
+      error:
+	if (memfd != -1)
+		close(memfd);
+	memfd = -1;
+	goto done;
+}
+
 static const struct pw_client_node_proxy_events client_node_events = {
 	PW_VERSION_CLIENT_NODE_PROXY_EVENTS,
 	.add_mem = client_node_add_mem,
@@ -1218,6 +1380,7 @@ static const struct pw_client_node_proxy_events client_node_events = {
 	.port_use_buffers = client_node_port_use_buffers,
 	.port_command = client_node_port_command,
 	.port_set_io = client_node_port_set_io,
+	.port_set_peer = client_node_port_set_peer,
 };
 
 static void on_node_proxy_destroy(void *data)
@@ -1239,6 +1402,11 @@ static void on_node_proxy_destroy(void *data)
 		free(impl->format);
 		impl->format = NULL;
 	}
+	if (impl->peer.mem || impl->peer.writefd != -1 ||
+	    impl->peer.port_id != SPA_ID_INVALID) {
+		struct peer peer = { NULL, NULL, -1, SPA_ID_INVALID };
+		set_peer(impl, &peer);
+	}
 	if (impl->trans) {
 		pw_client_node_transport_destroy(impl->trans);
 		impl->trans = NULL;
@@ -1421,7 +1589,7 @@ int pw_stream_queue_buffer(struct pw_stream *stream, struct pw_buffer *buffer)
 			send_have_output(stream);
 	}
 	else {
-		if (impl->client_reuse)
+		if (impl->client_reuse || impl->peer.port_id != SPA_ID_INVALID)
 			if ((b = pop_queue(impl, &impl->queue)))
 				send_reuse_buffer(stream, b->id);
 	}
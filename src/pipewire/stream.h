@@ -251,6 +251,10 @@ struct pw_remote *pw_stream_get_remote(struct pw_stream *stream);
 #define PW_STREAM_PROP_LATENCY_MIN	"pipewire.latency.min"
 /** The maximum latency of the stream, int default MAXINT */
 #define PW_STREAM_PROP_LATENCY_MAX	"pipewire.latency.max"
+/** Trigger a directly linked peer stream without going through the server,
+ * boolean default false. Both streams need it and get the wakeup fd of
+ * their peer */
+#define PW_STREAM_PROP_CLIENT_DIRECT	"pipewire.client.direct"
 
 const struct pw_properties *pw_stream_get_properties(struct pw_stream *stream);
 